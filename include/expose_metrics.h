@@ -6,58 +6,113 @@
  */
 
 #include "metrics.h"
+#include "scheduler.h"
+#include "seqlock.h"
 #include <errno.h>
 #include <prom.h>
 #include <promhttp.h>
-#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <unistd.h> // Para sleep
+#include <unistd.h>
 
-extern MemoryStats memory_stats;
-extern CpuStats cpu_stats;
-extern DiskStats disk_stats;
-extern NetStats net_stats;
+/**
+ * @def HTTP_DEFAULT_PORT
+ * @brief Port on which the metrics are exposed unless config.json sets another one.
+ */
+#define HTTP_DEFAULT_PORT 8000
+
+/**
+ * @brief Serving configuration of the HTTP server, read from the "http" object of config.json.
+ */
+extern promhttp_daemon_config_t http_config;
+
+/**
+ * @brief Compression level of /metrics responses, 0 to disable, read from the "http" object of config.json.
+ */
+extern unsigned int http_compression_level;
+
+/**
+ * @brief Size, in bytes, below which /metrics responses are sent uncompressed, read from the "http" object of
+ * config.json.
+ */
+extern unsigned int http_compression_min_size;
+
+/**
+ * @brief Returns a consistent copy of the last CPU stats published by the collector, without blocking it.
+ */
+CpuStats read_cpu_stats();
 
-/** Mutex para sincronización de hilos */
-extern pthread_mutex_t lock;
+/**
+ * @brief Devuelve una copia consistente de las últimas estadísticas de memoria publicadas por el colector.
+ */
+MemoryStats read_memory_stats();
+
+/**
+ * @brief Returns a consistent copy of the last disk stats published by the collector, without blocking it.
+ */
+DiskStats read_disk_stats();
+
+/**
+ * @brief Returns a consistent copy of the last network stats published by the collector, without blocking it.
+ */
+NetStats read_net_stats();
 
 /**
  * @brief Updates the CPU usage, context switches and running processes metrics
+ * @param context Context of the current collection cycle.
  */
-void update_cpu_gauge();
+void update_cpu_gauge(const CollectionContext* context);
 
 /**
  * @brief Actualiza la métrica de uso de memoria.
+ * @param context Contexto del ciclo de recolección actual.
  */
-void update_memory_gauge();
+void update_memory_gauge(const CollectionContext* context);
 
 /**
  * @brief Updates the disk read and write operations per second metric
+ * @param context Context of the current collection cycle.
  */
-void update_disk_gauge();
+void update_disk_gauge(const CollectionContext* context);
 
 /**
  * @brief Updates the network received and sent bytes per second metric
+ * @param context Context of the current collection cycle.
+ */
+void update_net_gauge(const CollectionContext* context);
+
+/**
+ * @brief Updates the self-metrics of the scheduler: missed deadlines and lateness
+ * @param tick Outcome of the last wait on the scheduler.
+ */
+void update_scheduler_metrics(const SchedulerTick* tick);
+
+/**
+ * @brief Renders the metrics once for every /metrics request until the next call, instead of once per request.
+ *
+ * Called by the main loop after every cycle in which collectors ran.
  */
-void update_net_gauge();
+void publish_metrics();
 
 /**
- * @brief Función del hilo para exponer las métricas vía HTTP en el puerto 8000.
- * @param arg Argumento no utilizado.
- * @return NULL
+ * @brief Starts the HTTP server exposing the metrics as set by http_config.
+ *
+ * The server polls and serves the connections from its own threads until destroy_metrics stops it, so the caller does
+ * not need a thread of its own to keep it running. Must be called after init_metrics.
+ *
+ * @return 0 on success, -1 if the server could not be started.
  */
-void* expose_metrics(void* arg);
+int expose_metrics();
 
 /**
- * @brief Inicializar mutex y métricas.
+ * @brief Inicializar métricas.
  */
 void init_metrics();
 
 /**
- * @brief Destructor de mutex
+ * @brief Detiene el servidor HTTP y libera el estado de los colectores.
  */
-void destroy_mutex();
+void destroy_metrics();
 
 #endif // EXPOSE_METRICS_H
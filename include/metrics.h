@@ -5,10 +5,12 @@
  * @brief Funciones para obtener el uso de CPU y memoria desde el sistema de archivos /proc.
  */
 
+#include "procfs.h"
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 /**
@@ -23,6 +25,48 @@
  */
 #define SHORT_BUFFER_SIZE 32
 
+/** Metric sample of the exporter, bound to a device or interface so that it is updated without a label lookup */
+struct prom_metric_sample;
+
+/**
+ * @def PROC_MEMINFO_PATH
+ * @brief Path of the memory statistics file.
+ */
+#define PROC_MEMINFO_PATH "/proc/meminfo"
+
+/**
+ * @def PROC_STAT_PATH
+ * @brief Path of the kernel/system statistics file.
+ */
+#define PROC_STAT_PATH "/proc/stat"
+
+/**
+ * @def PROC_DISKSTATS_PATH
+ * @brief Path of the disk I/O statistics file.
+ */
+#define PROC_DISKSTATS_PATH "/proc/diskstats"
+
+/**
+ * @def PROC_NET_DEV_PATH
+ * @brief Path of the network device statistics file.
+ */
+#define PROC_NET_DEV_PATH "/proc/net/dev"
+
+/**
+ * @def NANOSECONDS_PER_SECOND
+ * @brief Number of nanoseconds in a second.
+ */
+#define NANOSECONDS_PER_SECOND 1000000000ULL
+
+/**
+ * @struct CollectionContext
+ * @brief State shared by every collector during one collection cycle.
+ */
+typedef struct
+{
+    unsigned long long now_ns; /**< CLOCK_MONOTONIC time of the cycle, in nanoseconds. */
+} CollectionContext;
+
 /**
  * @struct MemoryStats
  * @brief Structure to hold memory statistics.
@@ -63,6 +107,235 @@ typedef struct
     unsigned long long ctxt; /**< Number of context switches. */
 } CpuStats;
 
+/**
+ * @def CPU_MODE_COUNT
+ * @brief Number of CPU time modes accounted per core.
+ */
+#define CPU_MODE_COUNT 8
+
+/**
+ * @enum CpuMode
+ * @brief CPU time modes, in the column order of /proc/stat.
+ */
+typedef enum
+{
+    CPU_MODE_USER,    /**< Time in user mode. */
+    CPU_MODE_NICE,    /**< Time in user mode with low priority. */
+    CPU_MODE_SYSTEM,  /**< Time in kernel mode. */
+    CPU_MODE_IDLE,    /**< Idle time. */
+    CPU_MODE_IOWAIT,  /**< Idle time waiting for I/O. */
+    CPU_MODE_IRQ,     /**< Time servicing hardware interrupts. */
+    CPU_MODE_SOFTIRQ, /**< Time servicing software interrupts. */
+    CPU_MODE_STEAL    /**< Time stolen by other guests of the hypervisor. */
+} CpuMode;
+
+/**
+ * @brief Label values of the CPU modes, indexed by CpuMode.
+ */
+extern const char* const cpu_mode_names[CPU_MODE_COUNT];
+
+/**
+ * @struct CpuTimes
+ * @brief One reading of the CPU time counters of /proc/stat, stored as a struct of arrays.
+ *
+ * ticks[mode] is a contiguous array indexed by slot: slot 0 holds the aggregate "cpu" line and slot n + 1 holds the
+ * "cpuN" line, so every kernel over a mode walks a single packed array.
+ */
+typedef struct
+{
+    unsigned long long* ticks[CPU_MODE_COUNT]; /**< Clock ticks per mode and slot. */
+} CpuTimes;
+
+/**
+ * @struct CpuSnapshot
+ * @brief Double-buffered CPU time readings and the results derived from the last two of them.
+ */
+typedef struct
+{
+    CpuTimes buffers[2];              /**< Previous and current readings. */
+    int current;                      /**< Index in buffers of the most recent reading. */
+    size_t slots;                     /**< Number of slots in use: 1 + highest CPU number + 1. */
+    size_t capacity;                  /**< Number of slots allocated in every array. */
+    bool* online;                     /**< Whether the slot appeared in the most recent reading. */
+    unsigned long long* total_delta;  /**< Ticks elapsed per slot between the last two readings. */
+    unsigned long long* busy_delta;   /**< Non-idle ticks elapsed per slot between the last two readings. */
+    double* usage;                    /**< Usage percentage per slot over the last interval. */
+} CpuSnapshot;
+
+/**
+ * @def DISK_FIELD_COUNT
+ * @brief Maximum number of statistics per device in /proc/diskstats, after the major, minor and name columns.
+ */
+#define DISK_FIELD_COUNT 17
+
+/**
+ * @enum DiskField
+ * @brief Per-device statistics of /proc/diskstats, in column order.
+ *
+ * Kernels before 4.18 only report the first 11 fields and kernels before 5.5 the first 15.
+ */
+typedef enum
+{
+    DISK_FIELD_READS_COMPLETED,     /**< Reads completed successfully. */
+    DISK_FIELD_READS_MERGED,        /**< Adjacent reads merged. */
+    DISK_FIELD_SECTORS_READ,        /**< Sectors read. */
+    DISK_FIELD_TIME_READING,        /**< Milliseconds spent reading. */
+    DISK_FIELD_WRITES_COMPLETED,    /**< Writes completed successfully. */
+    DISK_FIELD_WRITES_MERGED,       /**< Adjacent writes merged. */
+    DISK_FIELD_SECTORS_WRITTEN,     /**< Sectors written. */
+    DISK_FIELD_TIME_WRITING,        /**< Milliseconds spent writing. */
+    DISK_FIELD_IO_IN_PROGRESS,      /**< I/Os currently in flight. */
+    DISK_FIELD_TIME_IO,             /**< Milliseconds spent doing I/Os. */
+    DISK_FIELD_WEIGHTED_TIME_IO,    /**< Weighted milliseconds spent doing I/Os. */
+    DISK_FIELD_DISCARDS_COMPLETED,  /**< Discards completed successfully. */
+    DISK_FIELD_DISCARDS_MERGED,     /**< Adjacent discards merged. */
+    DISK_FIELD_SECTORS_DISCARDED,   /**< Sectors discarded. */
+    DISK_FIELD_TIME_DISCARDING,     /**< Milliseconds spent discarding. */
+    DISK_FIELD_FLUSHES_COMPLETED,   /**< Flush requests completed successfully. */
+    DISK_FIELD_TIME_FLUSHING        /**< Milliseconds spent flushing. */
+} DiskField;
+
+/**
+ * @def DISK_FILTER_MAX_PATTERNS
+ * @brief Maximum number of include or exclude patterns of the disk filter.
+ */
+#define DISK_FILTER_MAX_PATTERNS 16
+
+/**
+ * @struct DiskFilter
+ * @brief Selects the block devices reported by the disk collector.
+ *
+ * Patterns match device name prefixes, e.g. "loop" matches loop0 and loop12. A device is reported when it is a whole
+ * disk (or partitions are enabled), matches an include pattern (or there are none) and matches no exclude pattern.
+ */
+typedef struct
+{
+    bool partitions;                                          /**< Whether partitions are reported. */
+    size_t include_count;                                     /**< Number of include patterns. */
+    size_t exclude_count;                                     /**< Number of exclude patterns. */
+    char include[DISK_FILTER_MAX_PATTERNS][SHORT_BUFFER_SIZE]; /**< Prefixes of the devices to report. */
+    char exclude[DISK_FILTER_MAX_PATTERNS][SHORT_BUFFER_SIZE]; /**< Prefixes of the devices to skip. */
+} DiskFilter;
+
+extern DiskFilter disk_filter;
+
+/**
+ * @def DISK_SAMPLE_COUNT
+ * @brief Number of metric samples exported per device: reads and writes per second, then one per DiskField.
+ */
+#define DISK_SAMPLE_COUNT (DISK_FIELD_COUNT + 2)
+
+/**
+ * @struct DiskDevice
+ * @brief State of one block device of /proc/diskstats.
+ */
+typedef struct
+{
+    unsigned int major;                                   /**< Major device number. */
+    unsigned int minor;                                   /**< Minor device number. */
+    char name[SHORT_BUFFER_SIZE];                         /**< Device name, e.g. "nvme0n1". */
+    bool partition;                                       /**< Whether the device is a partition. */
+    bool accepted;                                        /**< Whether the device passes the disk filter. */
+    bool seen;                                            /**< Whether the device appeared in the last reading. */
+    size_t field_count;                                   /**< Number of fields reported by the kernel, 0 until read. */
+    unsigned long long fields[DISK_FIELD_COUNT];          /**< Last reading, indexed by DiskField. */
+    unsigned long long exported[DISK_FIELD_COUNT];        /**< Fields last exported to counters by the exporter. */
+    unsigned long long prev_reads_completed;              /**< Reads completed in the previous reading. */
+    unsigned long long prev_writes_completed;             /**< Writes completed in the previous reading. */
+    double rps;                                           /**< Read operations per second over the last interval. */
+    double wps;                                           /**< Write operations per second over the last interval. */
+    struct prom_metric_sample* samples[DISK_SAMPLE_COUNT]; /**< Samples bound by the exporter, NULL until bound. */
+} DiskDevice;
+
+/**
+ * @struct DiskTable
+ * @brief Per-device disk state, indexed by (major, minor).
+ *
+ * Devices are stored densely in the order they were first seen. The index is an open-addressing hash table with
+ * linear probing holding slot + 1 for every device, 0 marks an empty bucket.
+ */
+typedef struct
+{
+    DiskDevice* devices; /**< Device states. */
+    size_t count;        /**< Number of devices in use. */
+    size_t capacity;     /**< Number of devices allocated. */
+    unsigned int* index; /**< Hash index from (major, minor) to slot + 1. */
+    size_t index_size;   /**< Number of buckets of the index, a power of two. */
+    unsigned long long prev_ns; /**< Cycle time of the previous reading, in nanoseconds, 0 before the first one. */
+} DiskTable;
+
+/**
+ * @def NET_FIELD_COUNT
+ * @brief Number of statistics per interface in /proc/net/dev, receive and transmit.
+ */
+#define NET_FIELD_COUNT 16
+
+/**
+ * @enum NetField
+ * @brief Per-interface statistics of /proc/net/dev, in column order.
+ */
+typedef enum
+{
+    NET_FIELD_RX_BYTES,       /**< Bytes received. */
+    NET_FIELD_RX_PACKETS,     /**< Packets received. */
+    NET_FIELD_RX_ERRS,        /**< Receive errors. */
+    NET_FIELD_RX_DROP,        /**< Received packets dropped. */
+    NET_FIELD_RX_FIFO,        /**< Receive FIFO buffer errors. */
+    NET_FIELD_RX_FRAME,       /**< Receive framing errors. */
+    NET_FIELD_RX_COMPRESSED,  /**< Compressed packets received. */
+    NET_FIELD_RX_MULTICAST,   /**< Multicast frames received. */
+    NET_FIELD_TX_BYTES,       /**< Bytes transmitted. */
+    NET_FIELD_TX_PACKETS,     /**< Packets transmitted. */
+    NET_FIELD_TX_ERRS,        /**< Transmit errors. */
+    NET_FIELD_TX_DROP,        /**< Transmitted packets dropped. */
+    NET_FIELD_TX_FIFO,        /**< Transmit FIFO buffer errors. */
+    NET_FIELD_TX_COLLS,       /**< Collisions detected. */
+    NET_FIELD_TX_CARRIER,     /**< Carrier losses. */
+    NET_FIELD_TX_COMPRESSED   /**< Compressed packets transmitted. */
+} NetField;
+
+/**
+ * @def NET_SAMPLE_COUNT
+ * @brief Number of metric samples exported per interface: received and sent bytes per second, then one per NetField.
+ */
+#define NET_SAMPLE_COUNT (NET_FIELD_COUNT + 2)
+
+/**
+ * @struct NetInterface
+ * @brief State of one network interface of /proc/net/dev.
+ */
+typedef struct
+{
+    char name[SHORT_BUFFER_SIZE];                 /**< Interface name, e.g. "eth0". */
+    unsigned int hash;                            /**< Hash of the name. */
+    bool seen;                                    /**< Whether the interface appeared in the last reading. */
+    bool has_reading;                             /**< Whether the interface has a previous reading. */
+    unsigned long long fields[NET_FIELD_COUNT];   /**< Last reading, indexed by NetField. */
+    unsigned long long exported[NET_FIELD_COUNT]; /**< Fields last exported to counters by the exporter. */
+    unsigned long long prev_rx_bytes;             /**< Bytes received in the previous reading. */
+    unsigned long long prev_tx_bytes;             /**< Bytes transmitted in the previous reading. */
+    double rx_bytesps;                            /**< Received bytes per second over the last interval. */
+    double tx_bytesps;                            /**< Transmitted bytes per second over the last interval. */
+    struct prom_metric_sample* samples[NET_SAMPLE_COUNT]; /**< Samples bound by the exporter, NULL until bound. */
+} NetInterface;
+
+/**
+ * @struct NetTable
+ * @brief Per-interface network state, indexed by interface name.
+ *
+ * Interfaces are stored densely, in the order of the last reading as long as no interface was removed. The index is
+ * an open-addressing hash table with linear probing holding slot + 1 for every interface, 0 marks an empty bucket.
+ */
+typedef struct
+{
+    NetInterface* interfaces; /**< Interface states. */
+    size_t count;             /**< Number of interfaces in use. */
+    size_t capacity;          /**< Number of interfaces allocated. */
+    unsigned int* index;      /**< Hash index from name to slot + 1. */
+    size_t index_size;        /**< Number of buckets of the index, a power of two. */
+    unsigned long long prev_ns; /**< Cycle time of the previous reading, in nanoseconds, 0 before the first one. */
+} NetTable;
+
 /**
  * @struct MetricsState
  * @brief Structure to hold the state of the metrics.
@@ -77,6 +350,36 @@ typedef struct
 
 extern MetricsState metrics_state;
 
+/**
+ * @brief Opens the /proc files used by the enabled collectors.
+ *
+ * The files stay open for the lifetime of the program and are re-read in place on every collection cycle. Must be
+ * called after the configuration has been loaded.
+ */
+void open_proc_files();
+
+/**
+ * @brief Reads ahead, as one batch, the /proc files of the collectors about to run.
+ *
+ * Only has an effect when procfs is built with io_uring support, the collectors then find their file already read.
+ *
+ * @param due Collectors that run in this cycle.
+ */
+void prefetch_proc_files(const MetricsState* due);
+
+/**
+ * @brief Closes the /proc files opened by open_proc_files.
+ */
+void close_proc_files();
+
+/**
+ * @brief Starts a collection cycle by taking the monotonic clock snapshot shared by all collectors.
+ *
+ * @param context Context of the cycle.
+ * @return 0 on success, -1 on error.
+ */
+int collection_context_begin(CollectionContext* context);
+
 /**
  * @brief Obtiene el porcentaje de uso de memoria desde /proc/meminfo.
  *
@@ -87,35 +390,101 @@ extern MetricsState metrics_state;
  */
 MemoryStats get_memory_usage();
 
+/**
+ * @brief Initializes an empty CPU snapshot.
+ *
+ * @param snapshot Target snapshot.
+ */
+void cpu_snapshot_init(CpuSnapshot* snapshot);
+
+/**
+ * @brief Releases the arrays of a CPU snapshot.
+ *
+ * @param snapshot Target snapshot.
+ */
+void cpu_snapshot_destroy(CpuSnapshot* snapshot);
+
 /**
  * @brief Calculates the CPU usage percentage, reads the procs_running and ctxt from /proc/stat
  *
- * Reads the CPU usage values from /proc/stat and calculates the CPU usage percentage, also reads the
- * number of running processes and context switches from /proc/stat
+ * Reads the aggregate and per-core CPU time values from /proc/stat into the spare buffer of the snapshot, computes
+ * the per-core and per-mode deltas against the previous reading and swaps the buffers. Also reads the number of
+ * running processes and context switches from /proc/stat
  *
+ * @param snapshot Snapshot holding the previous reading, updated with the new one.
  * @return A CpuStats struct with the CPU usage percentage, the number of running processes and context switches,
  * -1.0 in case of error
  */
-CpuStats get_cpu_stats();
+CpuStats get_cpu_stats(CpuSnapshot* snapshot);
+
+/**
+ * @brief Initializes an empty disk table.
+ *
+ * @param table Target table.
+ */
+void disk_table_init(DiskTable* table);
+
+/**
+ * @brief Releases the devices and the index of a disk table.
+ *
+ * @param table Target table.
+ */
+void disk_table_destroy(DiskTable* table);
+
+/**
+ * @brief Drops the state of the devices that did not appear in the last reading.
+ *
+ * @param table Target table.
+ */
+void disk_table_prune(DiskTable* table);
 
 /**
  * @brief Calculates the number of read and write operations per second
  *
- * Reads the number of read and write operations from /proc/diskstats and the time
- * from proc/uptime to calculate the number of read and write operations per second
+ * Parses every row of /proc/diskstats into the device table and uses the time of the cycle to calculate the
+ * number of read and write operations per second of every device that passes the disk filter. Devices missing from
+ * the reading are left in the table with seen cleared until disk_table_prune is called.
+ *
+ * @param table Table holding the per-device state, updated with the new reading.
+ * @param context Context of the current collection cycle.
+ * @return A DiskStats struct with the read and write operations per second summed over the reported devices, -1.0 in
+ * case of error
+ */
+DiskStats get_disk_stats(DiskTable* table, const CollectionContext* context);
+
+/**
+ * @brief Initializes an empty network table.
+ *
+ * @param table Target table.
+ */
+void net_table_init(NetTable* table);
+
+/**
+ * @brief Releases the interfaces and the index of a network table.
+ *
+ * @param table Target table.
+ */
+void net_table_destroy(NetTable* table);
+
+/**
+ * @brief Drops the state of the interfaces that did not appear in the last reading.
  *
- * @return A DiskStats struct with the number of read and write operations per second, -1.0 in case of error
+ * @param table Target table.
  */
-DiskStats get_disk_stats();
+void net_table_prune(NetTable* table);
 
 /**
- * @brief Calculates the number of kilobytes sent and received per second
+ * @brief Calculates the number of bytes sent and received per second
  *
- * Reads the number of bytes sent and received from /proc/net/dev and the time
- * from proc/uptime to calculate the number of kilobytes sent and received per second
+ * Parses every interface row of /proc/net/dev into the interface table and uses the time of the cycle to calculate
+ * the number of bytes sent and received per second of every interface. Interfaces missing from the reading are left
+ * in the table with seen cleared until net_table_prune is called.
  *
- * @return A NetStats struct with the number of kilobytes sent and received per second, -1.0 in case of error
+ * @param table Table holding the per-interface state, updated with the new reading.
+ * @param context Context of the current collection cycle.
+ * @return A NetStats struct with the bytes sent and received per second summed over every interface except the
+ * loopback, -1.0 in case of error
  */
-NetStats get_net_stats();
+NetStats get_net_stats(NetTable* table, const CollectionContext* context);
 
 #endif // METRICS_H
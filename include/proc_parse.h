@@ -0,0 +1,95 @@
+#ifndef PROC_PARSE_H
+#define PROC_PARSE_H
+/**
+ * @file proc_parse.h
+ * @brief Allocation-free tokenizer and number parsers for the text formats of /proc.
+ *
+ * Every function works on a cursor into a ProcView: it reads from *cursor up to end and, on success, advances *cursor
+ * past what it consumed. Nothing is copied or allocated, and no function depends on the locale.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @struct ProcToken
+ * @brief A run of non-blank characters inside a view.
+ */
+typedef struct
+{
+    const char* start; /**< First character of the token. */
+    size_t len;        /**< Length of the token. */
+} ProcToken;
+
+/**
+ * @def PARSE_KEY
+ * @brief Matches a string literal key at the start of a line, see parse_key.
+ */
+#define PARSE_KEY(line, end, key, rest) parse_key((line), (end), (key), sizeof(key) - 1, (rest))
+
+/**
+ * @brief Checks whether the line starts with the given key.
+ *
+ * @param line Start of the line.
+ * @param end One past the last byte of the view.
+ * @param key Key to match, e.g. "MemTotal:".
+ * @param key_len Length of key.
+ * @param rest Set to the first character after the key on success.
+ * @return true if the line starts with the key.
+ */
+bool parse_key(const char* line, const char* end, const char* key, size_t key_len, const char** rest);
+
+/**
+ * @brief Skips spaces and tabs.
+ *
+ * @param p Current position.
+ * @param end One past the last byte of the view.
+ * @return First position that is not a space or a tab.
+ */
+const char* parse_skip_blanks(const char* p, const char* end);
+
+/**
+ * @brief Parses an unsigned decimal integer, skipping leading blanks.
+ *
+ * @param cursor Current position, advanced past the number on success.
+ * @param end One past the last byte of the view.
+ * @param out Parsed value.
+ * @return true if at least one digit was found and the number fits in 64 bits; *cursor is left untouched otherwise.
+ */
+bool parse_u64(const char** cursor, const char* end, unsigned long long* out);
+
+/**
+ * @brief Parses up to count consecutive unsigned integers separated by blanks.
+ *
+ * @param cursor Current position, advanced past the last parsed number.
+ * @param end One past the last byte of the view.
+ * @param out Array receiving the values.
+ * @param count Number of values to parse.
+ * @return Number of values actually parsed.
+ */
+size_t parse_u64_list(const char** cursor, const char* end, unsigned long long* out, size_t count);
+
+/**
+ * @brief Reads the next blank-delimited token, skipping leading blanks.
+ *
+ * @param cursor Current position, advanced past the token on success.
+ * @param end One past the last byte of the view.
+ * @param token Filled with the token.
+ * @return true if a non-empty token was found before the end of the line.
+ */
+bool parse_token(const char** cursor, const char* end, ProcToken* token);
+
+/**
+ * @brief Reads a token terminated by the given delimiter, skipping leading blanks.
+ *
+ * Needed where fields are not blank separated, e.g. "eth0:1234" in /proc/net/dev.
+ *
+ * @param cursor Current position, advanced past the delimiter on success.
+ * @param end One past the last byte of the view.
+ * @param delim Delimiter ending the token; it is not part of it.
+ * @param token Filled with the token.
+ * @return true if the delimiter was found before the end of the line.
+ */
+bool parse_token_until(const char** cursor, const char* end, char delim, ProcToken* token);
+
+#endif // PROC_PARSE_H
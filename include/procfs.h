@@ -0,0 +1,127 @@
+#ifndef PROCFS_H
+#define PROCFS_H
+/**
+ * @file procfs.h
+ * @brief Persistent handles to /proc files that are re-read in place every collection cycle.
+ *
+ * Each file is opened once and re-read with pread(fd, buf, n, 0) into a buffer owned by the handle, so a
+ * collection cycle costs a single syscall per file and no allocation once the buffer has grown to fit.
+ *
+ * When built with PROCFS_IO_URING, the files of a whole cycle can be read ahead of the collectors with
+ * procfs_prefetch, as one io_uring batch of fixed-buffer reads. Without it, or when io_uring is unavailable at run
+ * time, procfs_prefetch does nothing and every procfs_read falls back to its own pread.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+/**
+ * @def PROCFS_INITIAL_BUFFER_SIZE
+ * @brief Initial size of the buffer of a ProcFile, grown on demand.
+ */
+#define PROCFS_INITIAL_BUFFER_SIZE 4096
+
+/**
+ * @def PROCFS_READ_SLACK
+ * @brief Free space that must remain after a read for it to be considered complete.
+ *
+ * seq_file based /proc files stop a read early when the next record does not fit in the user buffer, so a read that
+ * comes close to filling the buffer may be truncated. Records are far smaller than this slack.
+ */
+#define PROCFS_READ_SLACK 512
+
+/**
+ * @struct ProcView
+ * @brief Read-only, NUL-terminated view of the contents of a ProcFile.
+ *
+ * The view points into the buffer of the handle and is valid until the next read of the same handle.
+ */
+typedef struct
+{
+    const char* data; /**< Start of the file contents. */
+    const char* end;  /**< One past the last byte of the file contents. */
+} ProcView;
+
+/**
+ * @struct ProcFile
+ * @brief Persistent handle to a /proc file.
+ */
+typedef struct
+{
+    const char* path; /**< Path of the file, reused to reopen it. */
+    int fd;           /**< Open file descriptor, -1 while closed. */
+    char* buf;        /**< Buffer holding the last read. */
+    size_t capacity;  /**< Allocated size of buf. */
+    size_t len;       /**< Number of bytes of the last read. */
+    bool prefetched;  /**< Whether buf holds a prefetched read not yet returned by procfs_read. */
+    int buf_index;    /**< Index of buf among the io_uring registered buffers, -1 if not registered. */
+} ProcFile;
+
+/**
+ * @def PROC_FILE_INIT
+ * @brief Static initializer for a closed ProcFile bound to the given path.
+ */
+#define PROC_FILE_INIT(file_path) {(file_path), -1, NULL, 0, 0, false, -1}
+
+/**
+ * @def PROCFS_BATCH_MAX
+ * @brief Maximum number of files read in one prefetch batch.
+ */
+#define PROCFS_BATCH_MAX 8
+
+/**
+ * @brief Opens the file of the handle and allocates its buffer.
+ *
+ * @param file Handle initialized with PROC_FILE_INIT.
+ * @return 0 on success, -1 on error.
+ */
+int procfs_open(ProcFile* file);
+
+/**
+ * @brief Re-reads the whole file from offset 0 into the buffer of the handle.
+ *
+ * The buffer grows until the file fits. The file is reopened if it was closed, or if the read fails with ESTALE or
+ * ENOENT (e.g. the underlying entry was recreated). If the file was prefetched, the prefetched contents are returned
+ * instead.
+ *
+ * @param file Target handle.
+ * @param view Filled with a view of the contents on success.
+ * @return 0 on success, -1 on error.
+ */
+int procfs_read(ProcFile* file, ProcView* view);
+
+/**
+ * @brief Reads ahead the given files as a single batch.
+ *
+ * A file whose batched read succeeds is returned by its next procfs_read without any syscall. Files that are closed,
+ * that do not fit in their buffer or whose read fails are left to the synchronous path of procfs_read, which also
+ * reports the errors.
+ *
+ * @param files Handles to read, at most PROCFS_BATCH_MAX are batched.
+ * @param count Number of handles.
+ */
+void procfs_prefetch(ProcFile* const* files, size_t count);
+
+/**
+ * @brief Releases the io_uring instance used by procfs_prefetch, if any.
+ */
+void procfs_prefetch_shutdown();
+
+/**
+ * @brief Closes the file and releases the buffer of the handle.
+ *
+ * @param file Target handle.
+ */
+void procfs_close(ProcFile* file);
+
+/**
+ * @brief Returns the start of the line following the given one.
+ *
+ * @param line Start of the current line.
+ * @param end One past the last byte of the view.
+ * @return Start of the next line, or NULL if the current line is the last one.
+ */
+const char* procfs_next_line(const char* line, const char* end);
+
+#endif // PROCFS_H
@@ -0,0 +1,80 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+/**
+ * @file scheduler.h
+ * @brief timerfd based scheduler that wakes the collection loop at absolute, drift-free deadlines.
+ *
+ * Deadlines are multiples of the interval from the start of the scheduler on CLOCK_MONOTONIC, so the time spent
+ * collecting never shifts the next deadline. A deadline that has already passed when the loop gets back to waiting
+ * is counted as missed instead of being run late.
+ */
+
+#include <stdbool.h>
+
+/**
+ * @def SCHEDULER_MIN_INTERVAL_NS
+ * @brief Shortest accepted interval, in nanoseconds (10 ms). Sampling intervals are rounded to multiples of it, so the
+ * common tick of the collectors never drops below it either.
+ */
+#define SCHEDULER_MIN_INTERVAL_NS 10000000ULL
+
+/**
+ * @struct Scheduler
+ * @brief Periodic timer of the collection loop.
+ */
+typedef struct
+{
+    int fd;                            /**< timerfd armed with the period of the scheduler. */
+    unsigned long long interval_ns;    /**< Period, in nanoseconds. */
+    unsigned long long deadline_ns;    /**< Most recent deadline reached, on CLOCK_MONOTONIC, in nanoseconds. */
+} Scheduler;
+
+/**
+ * @struct SchedulerTick
+ * @brief Outcome of one wait on the scheduler.
+ */
+typedef struct
+{
+    unsigned long long deadline_ns; /**< Deadline that woke the loop, on CLOCK_MONOTONIC, in nanoseconds. */
+    unsigned long long missed;      /**< Deadlines that passed without the loop waiting for them. */
+    double lateness;                /**< Seconds between the deadline and the wake up. */
+} SchedulerTick;
+
+/**
+ * @brief Parses a duration from the configuration.
+ *
+ * Accepts a non-negative decimal number followed by one of the units "ns", "us", "ms", "s" or "m", e.g. "250ms" or
+ * "1.5s". A number without unit is taken as seconds.
+ *
+ * @param text Duration to parse.
+ * @param duration_ns Filled with the duration in nanoseconds on success.
+ * @return 0 on success, -1 if the text is not a valid duration.
+ */
+int scheduler_parse_duration(const char* text, unsigned long long* duration_ns);
+
+/**
+ * @brief Creates the timer and arms it so that the first deadline is now.
+ *
+ * @param scheduler Target scheduler.
+ * @param interval_ns Period, in nanoseconds, at least SCHEDULER_MIN_INTERVAL_NS.
+ * @return 0 on success, -1 on error.
+ */
+int scheduler_init(Scheduler* scheduler, unsigned long long interval_ns);
+
+/**
+ * @brief Blocks until the next deadline.
+ *
+ * @param scheduler Target scheduler.
+ * @param tick Filled with the deadline reached, the deadlines missed since the previous one and the lateness.
+ * @return 0 when a deadline was reached, 1 when the wait was interrupted by a signal, -1 on error.
+ */
+int scheduler_wait(Scheduler* scheduler, SchedulerTick* tick);
+
+/**
+ * @brief Closes the timer of the scheduler.
+ *
+ * @param scheduler Target scheduler.
+ */
+void scheduler_destroy(Scheduler* scheduler);
+
+#endif // SCHEDULER_H
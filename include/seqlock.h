@@ -0,0 +1,118 @@
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+/**
+ * @file seqlock.h
+ * @brief Sequence lock to publish small structs from a single writer to any number of readers.
+ *
+ * The writer never blocks: it makes the sequence odd, stores the value and makes the sequence even again. Readers
+ * copy the value and retry if the sequence was odd or changed meanwhile, so they never observe a torn value and never
+ * delay the writer. The value is copied word by word with relaxed atomic accesses, which keeps the concurrent copy
+ * free of data races.
+ */
+
+#include <stddef.h>
+
+/**
+ * @def SEQLOCK_WORD
+ * @brief Unit in which published values are copied; their size and alignment must be multiples of it, which holds
+ * for structs made of doubles and long integers.
+ */
+#define SEQLOCK_WORD sizeof(unsigned long)
+
+/**
+ * @def SEQLOCKED
+ * @brief Declares a struct holding a value of the given type and the sequence lock guarding it.
+ */
+#define SEQLOCKED(type)                                                                                                \
+    struct                                                                                                             \
+    {                                                                                                                  \
+        SeqLock seqlock;                                                                                               \
+        type value;                                                                                                    \
+        _Static_assert(sizeof(type) % SEQLOCK_WORD == 0 && _Alignof(type) % SEQLOCK_WORD == 0,                         \
+                       "seqlocked values must be made of whole words");                                               \
+    }
+
+/**
+ * @struct SeqLock
+ * @brief Sequence counter, odd while a write is in progress.
+ */
+typedef struct
+{
+    unsigned int sequence; /**< Incremented before and after every write. */
+} SeqLock;
+
+/**
+ * @def SEQLOCK_INIT
+ * @brief Static initializer of a SeqLock.
+ */
+#define SEQLOCK_INIT {0}
+
+/**
+ * @brief Copies a value word by word with relaxed atomic accesses.
+ *
+ * @param dst Destination, aligned to SEQLOCK_WORD.
+ * @param src Source, aligned to SEQLOCK_WORD.
+ * @param size Size of the value, a multiple of SEQLOCK_WORD.
+ */
+static inline void seqlock_copy(void* dst, const void* src, size_t size)
+{
+    unsigned long* d = (unsigned long*)dst;
+    const unsigned long* s = (const unsigned long*)src;
+    for (size_t i = 0; i < size / SEQLOCK_WORD; i++)
+    {
+        __atomic_store_n(&d[i], __atomic_load_n(&s[i], __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * @brief Publishes a new value. Must only be called from the single writer.
+ *
+ * @param lock Sequence lock of the value.
+ * @param slot Published value.
+ * @param value New value.
+ * @param size Size of the value, a multiple of SEQLOCK_WORD.
+ */
+static inline void seqlock_write(SeqLock* lock, void* slot, const void* value, size_t size)
+{
+    unsigned int sequence = __atomic_load_n(&lock->sequence, __ATOMIC_RELAXED);
+    __atomic_store_n(&lock->sequence, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE); // The odd sequence is visible before any word of the value
+    seqlock_copy(slot, value, size);
+    __atomic_store_n(&lock->sequence, sequence + 2, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Reads a consistent copy of the published value, retrying while a write overlaps the copy.
+ *
+ * @param lock Sequence lock of the value.
+ * @param slot Published value.
+ * @param value Filled with the copy.
+ * @param size Size of the value, a multiple of SEQLOCK_WORD.
+ */
+static inline void seqlock_read(const SeqLock* lock, const void* slot, void* value, size_t size)
+{
+    unsigned int before, after;
+    do
+    {
+        before = __atomic_load_n(&lock->sequence, __ATOMIC_ACQUIRE);
+        seqlock_copy(value, slot, size);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE); // The copy completes before the sequence is checked again
+        after = __atomic_load_n(&lock->sequence, __ATOMIC_RELAXED);
+    } while ((before & 1) != 0 || before != after);
+}
+
+/**
+ * @def SEQLOCK_PUBLISH
+ * @brief Publishes a new value into a SEQLOCKED struct.
+ */
+#define SEQLOCK_PUBLISH(published, new_value)                                                                          \
+    seqlock_write(&(published)->seqlock, &(published)->value, &(new_value), sizeof((published)->value))
+
+/**
+ * @def SEQLOCK_LOAD
+ * @brief Reads a consistent copy of the value of a SEQLOCKED struct.
+ */
+#define SEQLOCK_LOAD(published, out)                                                                                   \
+    seqlock_read(&(published)->seqlock, &(published)->value, &(out), sizeof((published)->value))
+
+#endif // SEQLOCK_H
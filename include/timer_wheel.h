@@ -0,0 +1,90 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+/**
+ * @file timer_wheel.h
+ * @brief Hierarchical timer wheel that decides which periodic tasks are due on every scheduler tick.
+ *
+ * Time is counted in ticks of the scheduler. Level 0 has one slot per tick for the next TIMER_WHEEL_SLOTS ticks, and
+ * every following level has slots TIMER_WHEEL_SLOTS times wider. When the lower level wraps around, the entries of the
+ * next slot of the level above are cascaded down. Adding an entry and expiring it are O(1), whatever the number of
+ * entries, and advancing skips the ticks whose slots are empty.
+ */
+
+#include <stddef.h>
+
+/**
+ * @def TIMER_WHEEL_BITS
+ * @brief Number of bits of the tick count resolved by each level.
+ */
+#define TIMER_WHEEL_BITS 6
+
+/**
+ * @def TIMER_WHEEL_SLOTS
+ * @brief Number of slots of each level.
+ */
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_BITS)
+
+/**
+ * @def TIMER_WHEEL_LEVELS
+ * @brief Number of levels. Periods up to TIMER_WHEEL_SLOTS^TIMER_WHEEL_LEVELS ticks are scheduled exactly, longer ones
+ * are cascaded again when they reach the top level.
+ */
+#define TIMER_WHEEL_LEVELS 4
+
+/**
+ * @struct TimerWheelEntry
+ * @brief Periodic task scheduled on a timer wheel.
+ */
+typedef struct TimerWheelEntry
+{
+    struct TimerWheelEntry* next;     /**< Next entry of the same slot. */
+    struct TimerWheelEntry* due_next; /**< Next entry of the due list returned by timer_wheel_advance. */
+    unsigned long long expires;       /**< Tick of the next run. */
+    unsigned long long period;        /**< Ticks between runs, at least 1. */
+    void* data;                       /**< Task owning the entry. */
+} TimerWheelEntry;
+
+/**
+ * @struct TimerWheel
+ * @brief Hierarchical timer wheel.
+ */
+typedef struct
+{
+    TimerWheelEntry* slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS]; /**< Entries of every slot, as singly linked lists. */
+    unsigned long long current;                                    /**< Current tick. */
+} TimerWheel;
+
+/**
+ * @brief Initializes an empty timer wheel at tick 0.
+ *
+ * @param wheel Target wheel.
+ */
+void timer_wheel_init(TimerWheel* wheel);
+
+/**
+ * @brief Schedules a periodic entry.
+ *
+ * @param wheel Target wheel.
+ * @param entry Entry to schedule, owned by the caller and valid while it is scheduled.
+ * @param period Ticks between runs, at least 1.
+ * @param delay Ticks until the first run, at least 1.
+ * @param data Task owning the entry.
+ */
+void timer_wheel_add(TimerWheel* wheel, TimerWheelEntry* entry, unsigned long long period, unsigned long long delay,
+                     void* data);
+
+/**
+ * @brief Advances the wheel and collects the entries that are due.
+ *
+ * Every due entry is returned once, even if several of its periods elapsed during the advance, and is rescheduled to
+ * its first period boundary after the new current tick. Only the ticks that find entries in their slots are visited,
+ * so advancing over a long stall costs at most TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOTS slot checks per visited tick
+ * rather than one step per elapsed tick.
+ *
+ * @param wheel Target wheel.
+ * @param ticks Number of ticks elapsed, at least 1.
+ * @return Due entries linked through due_next, or NULL if none is due.
+ */
+TimerWheelEntry* timer_wheel_advance(TimerWheel* wheel, unsigned long long ticks);
+
+#endif // TIMER_WHEEL_H
@@ -17,6 +17,9 @@ limitations under the License.
 #ifndef PROM_COLLECTOR_H
 #define PROM_COLLECTOR_H
 
+#include <stdbool.h>
+#include <stdint.h>
+
 #include "prom_map.h"
 #include "prom_metric.h"
 
@@ -97,4 +100,24 @@ int prom_collector_add_metric(prom_collector_t *self, prom_metric_t *metric);
  */
 int prom_collector_set_collect_fn(prom_collector_t *self, prom_collect_fn *fn);
 
+/**
+ * @brief Marks the metrics of a collector as volatile: they change too often to tell whether the exposition changed,
+ *        e.g. the self-metrics of an exporter counting its own requests, and are left out of the generation. Two
+ *        renderings at the same generation may then differ in these metrics only.
+ * @param self The target prom_collector_t*
+ * @param is_volatile Whether the metrics of the collector are volatile
+ * @return A non-zero integer value upon failure.
+ */
+int prom_collector_set_volatile(prom_collector_t *self, bool is_volatile);
+
+/**
+ * @brief Returns the generation of the metrics of a collector, see prom_collector_registry_generation. It is not
+ *        collected first. For a collector with its own prom_collect_fn, it grows with every collection. It is always 0
+ *        for a volatile collector.
+ * @param self The target prom_collector_t*
+ * @param generation Set to the generation
+ * @return A non-zero integer value upon failure.
+ */
+int prom_collector_generation(prom_collector_t *self, uint64_t *generation);
+
 #endif  // PROM_COLLECTOR_H
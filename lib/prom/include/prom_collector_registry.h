@@ -22,6 +22,9 @@ limitations under the License.
 #ifndef PROM_REGISTRY_H
 #define PROM_REGISTRY_H
 
+#include <stddef.h>
+#include <stdint.h>
+
 #include "prom_collector.h"
 #include "prom_metric.h"
 
@@ -106,6 +109,130 @@ int prom_collector_registry_register_collector(prom_collector_registry_t *self,
  */
 const char *prom_collector_registry_bridge(prom_collector_registry_t *self);
 
+/**
+ * @brief A scrape rendered into a buffer lent by the scrape buffer pool of a prom_collector_registry_t
+ */
+typedef struct prom_collector_registry_scrape prom_collector_registry_scrape_t;
+
+/**
+ * @brief Renders the metrics of the registry in the default metric exposition format into a buffer of its scrape
+ * buffer pool.
+ *
+ * Pooled buffers keep the capacity reached by previous scrapes, so a steady-state scrape neither grows nor copies its
+ * buffer. When every buffer of the pool is lent, a one-off buffer is used instead. The scrape MUST be released with
+ * prom_collector_registry_scrape_release once its string is no longer needed, e.g. from the free callback of the HTTP
+ * response that sends it.
+ *
+ * @param self The target prom_collector_registry_t*
+ * @return The rendered scrape, NULL upon failure
+ */
+prom_collector_registry_scrape_t *prom_collector_registry_scrape(prom_collector_registry_t *self);
+
+/**
+ * @brief Renders only the metrics of the registry whose name is one of names or starts with one of prefixes, like
+ * prom_collector_registry_scrape.
+ *
+ * The registry keeps its metrics sorted by name in an index updated as metrics and collectors are registered, so the
+ * matching metrics are found by binary search and no other metric is visited: the cost grows with the output, not
+ * with the size of the registry. The metrics are rendered sorted by name, each once even if several names or prefixes
+ * match it. Only the collectors of matching metrics are collected. Passing no name and no prefix renders every metric.
+ *
+ * @param self The target prom_collector_registry_t*
+ * @param names Exact metric names, may be NULL if name_count is 0
+ * @param name_count Number of names
+ * @param prefixes Metric name prefixes, may be NULL if prefix_count is 0
+ * @param prefix_count Number of prefixes
+ * @return The rendered scrape, NULL upon failure
+ */
+prom_collector_registry_scrape_t *prom_collector_registry_scrape_matching(prom_collector_registry_t *self,
+                                                                          const char **names, size_t name_count,
+                                                                          const char **prefixes, size_t prefix_count);
+
+/**
+ * @brief Returns the string of a scrape. It remains valid until the scrape is released.
+ * @param scrape The target prom_collector_registry_scrape_t*
+ * @return The string in the default metric exposition format
+ */
+const char *prom_collector_registry_scrape_str(prom_collector_registry_scrape_t *scrape);
+
+/**
+ * @brief Returns the length of the string of a scrape
+ * @param scrape The target prom_collector_registry_scrape_t*
+ * @return The length of the string, terminating null excluded
+ */
+size_t prom_collector_registry_scrape_len(prom_collector_registry_scrape_t *scrape);
+
+/**
+ * @brief Gives the buffer of a scrape back to the pool of its registry. The scrape MUST NOT be used afterwards.
+ * @param scrape The target prom_collector_registry_scrape_t*
+ */
+void prom_collector_registry_scrape_release(prom_collector_registry_scrape_t *scrape);
+
+/**
+ * @brief A rendering of the metrics of a prom_collector_registry_t that is produced piece by piece as it is read
+ */
+typedef struct prom_collector_registry_stream prom_collector_registry_stream_t;
+
+/**
+ * @brief Starts a streamed rendering of the metrics of the registry in the default metric exposition format.
+ *
+ * Nothing is rendered until the stream is read. Each read renders only the metrics it needs, one at a time, so the
+ * memory held by a stream is bounded by the largest metric rather than by the whole exposition. The stream MUST be
+ * destroyed with prom_collector_registry_stream_destroy.
+ *
+ * @param self The target prom_collector_registry_t*
+ * @return The stream, NULL upon failure
+ */
+prom_collector_registry_stream_t *prom_collector_registry_stream_new(prom_collector_registry_t *self);
+
+/**
+ * @brief Copies the next bytes of the exposition into buf, rendering metrics as they are needed
+ * @param self The target prom_collector_registry_stream_t*
+ * @param buf The destination buffer. It is not null terminated.
+ * @param size The size of buf
+ * @param len Set to the number of bytes copied, 0 once the whole exposition has been read
+ * @return A non-zero integer value upon failure
+ */
+int prom_collector_registry_stream_read(prom_collector_registry_stream_t *self, char *buf, size_t size, size_t *len);
+
+/**
+ * @brief Destroys a stream, whether it has been read to the end or not
+ * @param self The target prom_collector_registry_stream_t*
+ */
+void prom_collector_registry_stream_destroy(prom_collector_registry_stream_t *self);
+
+/**
+ * @brief Returns the generation of the registry, which grows whenever the exposition of its metrics may have changed:
+ * a sample changing value or being added or removed, or a metric being added.
+ *
+ * Reading the generation does not render anything, so it can tell cheaply whether a previous rendering is still
+ * current: a rendering started after reading generation g is current for as long as the generation is still g. The
+ * metrics of collectors with their own prom_collect_fn, such as the process collector, are updated while the registry
+ * is rendered, so every rendering that collects them makes the generation grow. The metrics of volatile collectors are
+ * left out, see prom_collector_set_volatile.
+ *
+ * @param self The target prom_collector_registry_t*
+ * @param generation Set to the generation
+ * @return A non-zero integer value upon failure
+ */
+int prom_collector_registry_generation(prom_collector_registry_t *self, uint64_t *generation);
+
+/**
+ * @brief Returns the generation of the metrics that prom_collector_registry_scrape_matching renders for the same names
+ * and prefixes, see prom_collector_registry_generation. Only the matching metrics are visited.
+ *
+ * @param self The target prom_collector_registry_t*
+ * @param names Exact metric names, may be NULL if name_count is 0
+ * @param name_count Number of names
+ * @param prefixes Metric name prefixes, may be NULL if prefix_count is 0
+ * @param prefix_count Number of prefixes
+ * @param generation Set to the generation
+ * @return A non-zero integer value upon failure
+ */
+int prom_collector_registry_generation_matching(prom_collector_registry_t *self, const char **names,
+                                               size_t name_count, const char **prefixes, size_t prefix_count,
+                                               uint64_t *generation);
+
 /**
  *@brief Validates that the given metric name complies with the specification:
  *
@@ -152,4 +152,22 @@ int prom_gauge_sub(prom_gauge_t *self, double r_value, const char **label_values
  */
 int prom_gauge_set(prom_gauge_t *self, double r_value, const char **label_values);
 
+/**
+ * @brief Resolves a label combination of the prom_gauge_t* once and returns its sample as a bound handle.
+ *
+ * Updating the handle with prom_metric_sample_set, prom_metric_sample_add or prom_metric_sample_sub is a single atomic
+ * operation: no lock is taken, no l_value is formatted and nothing is allocated. The handle stays valid until the
+ * sample is removed with prom_metric_remove_sample or the gauge is destroyed.
+ * @param self The target prom_gauge_t*
+ * @param label_values The label values of the sample. The number of labels must match the value passed to
+ *                     label_key_count in the gauge's constructor. If no label values are necessary, pass NULL.
+ * @return The bound prom_metric_sample_t*, or NULL upon failure.
+ *
+ * *Example*
+ *
+ *     prom_metric_sample_t *bar_bang = prom_gauge_with_labels(foo_gauge, (const char**) { "bar", "bang" });
+ *     prom_metric_sample_set(bar_bang, 22);
+ */
+prom_metric_sample_t *prom_gauge_with_labels(prom_gauge_t *self, const char **label_values);
+
 #endif  // PROM_GAUGE_H
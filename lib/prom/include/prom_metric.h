@@ -48,6 +48,19 @@ typedef struct prom_metric prom_metric_t;
  */
 prom_metric_sample_t *prom_metric_sample_from_labels(prom_metric_t *self, const char **label_values);
 
+/**
+ * @brief Removes the sample with the given label values from the metric. The order of label_values is significant.
+ *
+ * Use it for label values that will not be reported again, e.g. a device that went away. Any cached pointer to the
+ * removed sample becomes invalid.
+ *
+ * @param self The target prom_metric_t*
+ * @param label_values The label values of the sample to remove. The number of labels must match the value passed to
+ *                     label_key_count in the metric's constructor.
+ * @return A non-zero integer value upon failure. Removing a sample that does not exist is not a failure.
+ */
+int prom_metric_remove_sample(prom_metric_t *self, const char **label_values);
+
 /**
  * @brief Returns a prom_metric_sample_histogram_t*. The order of label_values is significant.
  *
@@ -31,8 +31,11 @@ typedef struct prom_metric_sample_histogram prom_metric_sample_histogram_t;
 /**
  * @brief Observe the double for the given prom_metric_sample_histogram_observe_t
  * @param self The target prom_metric_sample_histogram_t*
- * @param value The value to observe.
+ * @param value The value to observe. NaN is only counted in the +Inf bucket.
  * @return Non-zero integer value upon failure
+ *
+ * Observing is lock-free and never allocates: it increments the counter of the bucket the value falls in and adds the
+ * value to the sum.
  */
 int prom_metric_sample_histogram_observe(prom_metric_sample_histogram_t *self, double value);
 
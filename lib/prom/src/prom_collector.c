@@ -24,10 +24,14 @@
 
 // Private
 #include "prom_assert.h"
+#include "prom_collector_i.h"
+#include "prom_collector_registry_i.h"
 #include "prom_collector_t.h"
+#include "prom_linked_list_t.h"
 #include "prom_log.h"
 #include "prom_map_i.h"
 #include "prom_metric_i.h"
+#include "prom_metric_t.h"
 #include "prom_process_fds_i.h"
 #include "prom_process_fds_t.h"
 #include "prom_process_limits_i.h"
@@ -60,6 +64,9 @@ prom_collector_t *prom_collector_new(const char *name) {
   }
   self->proc_limits_file_path = NULL;
   self->proc_stat_file_path = NULL;
+  self->registry = NULL;
+  atomic_init(&self->collections, 1);
+  self->is_volatile = false;
   return self;
 }
 
@@ -106,6 +113,22 @@ int prom_collector_set_collect_fn(prom_collector_t *self, prom_collect_fn *fn) {
   return 0;
 }
 
+int prom_collector_set_volatile(prom_collector_t *self, bool is_volatile) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+  self->is_volatile = is_volatile;
+  return 0;
+}
+
+prom_map_t *prom_collector_collect(prom_collector_t *self) {
+  prom_map_t *metrics = self->collect_fn(self);
+  // Bumped after the metrics were updated, like a metric generation
+  if (self->collect_fn != &prom_collector_default_collect) {
+    atomic_fetch_add_explicit(&self->collections, 1, memory_order_release);
+  }
+  return metrics;
+}
+
 int prom_collector_add_metric(prom_collector_t *self, prom_metric_t *metric) {
   PROM_ASSERT(self != NULL);
   if (self == NULL) return 1;
@@ -113,7 +136,39 @@ int prom_collector_add_metric(prom_collector_t *self, prom_metric_t *metric) {
     PROM_LOG("metric already found in collector");
     return 1;
   }
-  return prom_map_set(self->metrics, metric->name, metric);
+  int r = prom_map_set(self->metrics, metric->name, metric);
+  if (r) return r;
+  // Metrics added after the collector was registered are indexed as they come
+  if (self->registry != NULL) return prom_collector_registry_index_metric(self->registry, self, metric);
+  return 0;
+}
+
+int prom_collector_generation(prom_collector_t *self, uint64_t *generation) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+
+  if (self->is_volatile) {
+    *generation = 0;
+    return 0;
+  }
+
+  // A prom_collect_fn updates or builds its metrics while the registry is rendered, so whether they changed is only
+  // known after rendering: every collection counts as a change
+  if (self->collect_fn != &prom_collector_default_collect) {
+    *generation = atomic_load_explicit(&self->collections, memory_order_acquire);
+    return 0;
+  }
+
+  // Every metric generation starts at 1 and only grows, so their sum grows with any of them and with every new metric
+  uint64_t sum = 0;
+  for (prom_linked_list_node_t *current_node = self->metrics->keys->head; current_node != NULL;
+       current_node = current_node->next) {
+    prom_metric_t *metric = (prom_metric_t *)prom_map_get(self->metrics, (const char *)current_node->item);
+    if (metric == NULL) return 1;
+    sum += atomic_load_explicit(&metric->generation, memory_order_acquire);
+  }
+  *generation = sum;
+  return 0;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
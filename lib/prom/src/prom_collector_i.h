@@ -0,0 +1,36 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PROM_COLLECTOR_I_H
+#define PROM_COLLECTOR_I_H
+
+// Public
+#include "prom_collector.h"
+#include "prom_map.h"
+
+/**
+ * @brief API PRIVATE The prom_collect_fn of a collector that was not given its own: returns the metrics added to it
+ * as they are
+ */
+prom_map_t *prom_collector_default_collect(prom_collector_t *self);
+
+/**
+ * @brief API PRIVATE Collects the metrics of a collector for rendering. A collector with its own prom_collect_fn counts
+ * the collection in its generation, as its metrics may have been updated by it.
+ */
+prom_map_t *prom_collector_collect(prom_collector_t *self);
+
+#endif  // PROM_COLLECTOR_I_H
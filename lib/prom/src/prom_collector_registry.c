@@ -16,7 +16,10 @@
 
 #include <pthread.h>
 #include <regex.h>
+#include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 // Public
 #include "prom_alloc.h"
@@ -25,19 +28,39 @@
 
 // Private
 #include "prom_assert.h"
+#include "prom_collector_i.h"
+#include "prom_collector_registry_i.h"
 #include "prom_collector_registry_t.h"
 #include "prom_collector_t.h"
 #include "prom_errors.h"
+#include "prom_linked_list_t.h"
 #include "prom_log.h"
 #include "prom_map_i.h"
 #include "prom_metric_formatter_i.h"
 #include "prom_metric_i.h"
+#include "prom_metric_index_i.h"
 #include "prom_metric_t.h"
 #include "prom_process_limits_i.h"
 #include "prom_string_builder_i.h"
 
 prom_collector_registry_t *PROM_COLLECTOR_REGISTRY_DEFAULT;
 
+/**
+ * @brief Adds the metrics of a collector being registered to the metric index and makes the collector index the
+ * metrics added to it later. The caller must hold the write lock once the registry is shared.
+ */
+static int prom_collector_registry_index_collector(prom_collector_registry_t *self, prom_collector_t *collector) {
+  for (prom_linked_list_node_t *current_node = collector->metrics->keys->head; current_node != NULL;
+       current_node = current_node->next) {
+    prom_metric_t *metric = (prom_metric_t *)prom_map_get(collector->metrics, (const char *)current_node->item);
+    if (metric == NULL) return 1;
+    int r = prom_metric_index_add(self->metric_index, collector, metric);
+    if (r) return r;
+  }
+  collector->registry = self;
+  return 0;
+}
+
 prom_collector_registry_t *prom_collector_registry_new(const char *name) {
   int r = 0;
 
@@ -48,10 +71,26 @@ prom_collector_registry_t *prom_collector_registry_new(const char *name) {
   self->name = prom_strdup(name);
   self->collectors = prom_map_new();
   prom_map_set_free_value_fn(self->collectors, &prom_collector_free_generic);
-  prom_map_set(self->collectors, "default", prom_collector_new("default"));
+  self->metric_index = prom_metric_index_new();
+  prom_collector_t *default_collector = prom_collector_new("default");
+  prom_map_set(self->collectors, "default", default_collector);
+  prom_collector_registry_index_collector(self, default_collector);
 
-  self->metric_formatter = prom_metric_formatter_new();
   self->string_builder = prom_string_builder_new();
+
+  // The formatters of the scrape pool are created by the first scrapes that use them
+  for (size_t i = 0; i < PROM_COLLECTOR_REGISTRY_SCRAPE_POOL_SIZE; i++) {
+    self->scrape_pool[i].registry = self;
+    self->scrape_pool[i].formatter = NULL;
+    self->scrape_pool[i].in_use = false;
+  }
+  self->scrape_pool_lock = (pthread_mutex_t *)prom_malloc(sizeof(pthread_mutex_t));
+  r = pthread_mutex_init(self->scrape_pool_lock, NULL);
+  if (r) {
+    PROM_LOG(PROM_PTHREAD_MUTEX_INIT_ERROR);
+    return NULL;
+  }
+
   self->lock = (pthread_rwlock_t *)prom_malloc(sizeof(pthread_rwlock_t));
   r = pthread_rwlock_init(self->lock, NULL);
   if (r) {
@@ -66,8 +105,11 @@ int prom_collector_registry_enable_process_metrics(prom_collector_registry_t *se
   if (self == NULL) return 1;
   prom_collector_t *process_collector = prom_collector_process_new(NULL, NULL);
   if (process_collector) {
+    // A process collector enabled before is destroyed by prom_map_set, its metrics must leave the index first
+    prom_collector_t *previous = (prom_collector_t *)prom_map_get(self->collectors, "process");
+    if (previous != NULL) prom_metric_index_remove_collector(self->metric_index, previous);
     prom_map_set(self->collectors, "process", process_collector);
-    return 0;
+    return prom_collector_registry_index_collector(self, process_collector);
   }
   return 1;
 }
@@ -82,8 +124,11 @@ int prom_collector_registry_enable_custom_process_metrics(prom_collector_registr
   }
   prom_collector_t *process_collector = prom_collector_process_new(process_limits_path, process_stats_path);
   if (process_collector) {
+    // A process collector enabled before is destroyed by prom_map_set, its metrics must leave the index first
+    prom_collector_t *previous = (prom_collector_t *)prom_map_get(self->collectors, "process");
+    if (previous != NULL) prom_metric_index_remove_collector(self->metric_index, previous);
     prom_map_set(self->collectors, "process", process_collector);
-    return 0;
+    return prom_collector_registry_index_collector(self, process_collector);
   }
   return 1;
 }
@@ -108,8 +153,20 @@ int prom_collector_registry_destroy(prom_collector_registry_t *self) {
   self->collectors = NULL;
   if (r) ret = r;
 
-  r = prom_metric_formatter_destroy(self->metric_formatter);
-  self->metric_formatter = NULL;
+  r = prom_metric_index_destroy(self->metric_index);
+  self->metric_index = NULL;
+  if (r) ret = r;
+
+  for (size_t i = 0; i < PROM_COLLECTOR_REGISTRY_SCRAPE_POOL_SIZE; i++) {
+    if (self->scrape_pool[i].formatter == NULL) continue;
+    r = prom_metric_formatter_destroy(self->scrape_pool[i].formatter);
+    self->scrape_pool[i].formatter = NULL;
+    if (r) ret = r;
+  }
+
+  r = pthread_mutex_destroy(self->scrape_pool_lock);
+  prom_free(self->scrape_pool_lock);
+  self->scrape_pool_lock = NULL;
   if (r) ret = r;
 
   r = prom_string_builder_destroy(self->string_builder);
@@ -173,6 +230,7 @@ int prom_collector_registry_register_collector(prom_collector_registry_t *self,
     }
   }
   r = prom_map_set(self->collectors, collector->name, collector);
+  if (!r) r = prom_collector_registry_index_collector(self, collector);
   if (r) {
     int rr = pthread_rwlock_unlock(self->lock);
     if (rr) {
@@ -190,6 +248,25 @@ int prom_collector_registry_register_collector(prom_collector_registry_t *self,
   return 0;
 }
 
+int prom_collector_registry_index_metric(prom_collector_registry_t *self, prom_collector_t *collector,
+                                         prom_metric_t *metric) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+
+  int r = pthread_rwlock_wrlock(self->lock);
+  if (r) {
+    PROM_LOG(PROM_PTHREAD_RWLOCK_LOCK_ERROR);
+    return r;
+  }
+  r = prom_metric_index_add(self->metric_index, collector, metric);
+  int unlock_r = pthread_rwlock_unlock(self->lock);
+  if (unlock_r) {
+    PROM_LOG(PROM_PTHREAD_RWLOCK_UNLOCK_ERROR);
+    return unlock_r;
+  }
+  return r;
+}
+
 int prom_collector_registry_validate_metric_name(prom_collector_registry_t *self, const char *metric_name) {
   regex_t r;
   int ret = 0;
@@ -210,8 +287,374 @@ int prom_collector_registry_validate_metric_name(prom_collector_registry_t *self
   return 0;
 }
 
+/**
+ * @brief Lends an empty scrape buffer of the pool of the registry, or a one-off one when every buffer is lent
+ */
+static prom_collector_registry_scrape_t *prom_collector_registry_scrape_acquire(prom_collector_registry_t *self) {
+  int r = 0;
+  prom_collector_registry_scrape_t *scrape = NULL;
+
+  // Each scrape renders into its own buffer, so concurrent scrapes neither share a buffer nor wait for each other
+  r = pthread_mutex_lock(self->scrape_pool_lock);
+  if (r) {
+    PROM_LOG(PROM_PTHREAD_MUTEX_LOCK_ERROR);
+    return NULL;
+  }
+  for (size_t i = 0; i < PROM_COLLECTOR_REGISTRY_SCRAPE_POOL_SIZE; i++) {
+    if (!self->scrape_pool[i].in_use) {
+      scrape = &self->scrape_pool[i];
+      scrape->in_use = true;
+      break;
+    }
+  }
+  r = pthread_mutex_unlock(self->scrape_pool_lock);
+  if (r) {
+    PROM_LOG(PROM_PTHREAD_MUTEX_UNLOCK_ERROR);
+    return NULL;
+  }
+
+  if (scrape == NULL) {
+    // Every buffer of the pool is lent, this one is destroyed on release
+    scrape = (prom_collector_registry_scrape_t *)prom_malloc(sizeof(prom_collector_registry_scrape_t));
+    if (scrape == NULL) return NULL;
+    scrape->registry = NULL;
+    scrape->formatter = NULL;
+    scrape->in_use = true;
+  }
+  if (scrape->formatter == NULL) {
+    scrape->formatter = prom_metric_formatter_new();
+    if (scrape->formatter == NULL) {
+      prom_collector_registry_scrape_release(scrape);
+      return NULL;
+    }
+  }
+
+  // Resetting keeps the capacity reached by the previous scrapes
+  r = prom_metric_formatter_reset(scrape->formatter);
+  if (r) {
+    prom_collector_registry_scrape_release(scrape);
+    return NULL;
+  }
+  return scrape;
+}
+
+prom_collector_registry_scrape_t *prom_collector_registry_scrape(prom_collector_registry_t *self) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return NULL;
+
+  prom_collector_registry_scrape_t *scrape = prom_collector_registry_scrape_acquire(self);
+  if (scrape == NULL) return NULL;
+  int r = prom_metric_formatter_load_metrics(scrape->formatter, self->collectors);
+  if (r) PROM_LOG("failed to load metrics");
+  return scrape;
+}
+
+/**
+ * @brief A range of entries of the metric index
+ */
+typedef struct prom_collector_registry_range {
+  size_t begin;
+  size_t end;
+} prom_collector_registry_range_t;
+
+static int prom_collector_registry_range_compare(const void *a, const void *b) {
+  size_t begin_a = ((const prom_collector_registry_range_t *)a)->begin;
+  size_t begin_b = ((const prom_collector_registry_range_t *)b)->begin;
+  return begin_a < begin_b ? -1 : begin_a > begin_b;
+}
+
+/**
+ * @brief Sets ranges to the ranges of the metric index matching each name and each prefix, sorted by begin. Only the
+ * matching ranges are visited afterwards, whatever the number of metrics of the registry. The caller must hold the
+ * read lock.
+ */
+static void prom_collector_registry_match(prom_collector_registry_t *self, const char **names, size_t name_count,
+                                          const char **prefixes, size_t prefix_count,
+                                          prom_collector_registry_range_t *ranges) {
+  for (size_t i = 0; i < name_count + prefix_count; i++) {
+    bool prefix = i >= name_count;
+    const char *key = prefix ? prefixes[i - name_count] : names[i];
+    prom_metric_index_range(self->metric_index, key, prefix, &ranges[i].begin, &ranges[i].end);
+  }
+  qsort(ranges, name_count + prefix_count, sizeof(prom_collector_registry_range_t),
+        &prom_collector_registry_range_compare);
+}
+
+/**
+ * @brief Renders the entries of the metric index in the given ranges, sorted by begin. Overlapping ranges are merged,
+ * so a metric matched by several names or prefixes is rendered once. Each collector is collected before its first
+ * metric is rendered. The caller must hold the read lock.
+ */
+static int prom_collector_registry_load_ranges(prom_collector_registry_t *self, prom_metric_formatter_t *formatter,
+                                               prom_collector_registry_range_t *ranges, size_t range_count) {
+  int r = 0;
+  prom_collector_t **collected = NULL;
+  size_t collected_count = 0;
+  size_t next = 0;
+  for (size_t i = 0; !r && i < range_count; i++) {
+    size_t entry = ranges[i].begin > next ? ranges[i].begin : next;
+    for (; !r && entry < ranges[i].end; entry++) {
+      prom_metric_index_entry_t *current = &self->metric_index->entries[entry];
+
+      // A prom_collect_fn updates its metrics when called, collectors are few so a linear search is enough
+      bool found = false;
+      for (size_t c = 0; c < collected_count && !found; c++) found = collected[c] == current->collector;
+      if (!found) {
+        prom_collector_t **grown =
+            (prom_collector_t **)prom_realloc(collected, (collected_count + 1) * sizeof(prom_collector_t *));
+        if (grown == NULL) {
+          r = 1;
+          break;
+        }
+        collected = grown;
+        collected[collected_count++] = current->collector;
+        if (prom_collector_collect(current->collector) == NULL) {
+          r = 1;
+          break;
+        }
+      }
+      r = prom_metric_formatter_load_metric(formatter, current->metric);
+    }
+    if (ranges[i].end > next) next = ranges[i].end;
+  }
+  prom_free(collected);
+  return r;
+}
+
+prom_collector_registry_scrape_t *prom_collector_registry_scrape_matching(prom_collector_registry_t *self,
+                                                                          const char **names, size_t name_count,
+                                                                          const char **prefixes, size_t prefix_count) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return NULL;
+  if (name_count + prefix_count == 0) return prom_collector_registry_scrape(self);
+
+  prom_collector_registry_range_t *ranges = (prom_collector_registry_range_t *)prom_malloc(
+      (name_count + prefix_count) * sizeof(prom_collector_registry_range_t));
+  if (ranges == NULL) return NULL;
+  prom_collector_registry_scrape_t *scrape = prom_collector_registry_scrape_acquire(self);
+  if (scrape == NULL) {
+    prom_free(ranges);
+    return NULL;
+  }
+
+  int r = pthread_rwlock_rdlock(self->lock);
+  if (r) {
+    PROM_LOG(PROM_PTHREAD_RWLOCK_LOCK_ERROR);
+    prom_free(ranges);
+    prom_collector_registry_scrape_release(scrape);
+    return NULL;
+  }
+
+  prom_collector_registry_match(self, names, name_count, prefixes, prefix_count, ranges);
+  r = prom_collector_registry_load_ranges(self, scrape->formatter, ranges, name_count + prefix_count);
+  if (r) PROM_LOG("failed to load metrics");
+
+  r = pthread_rwlock_unlock(self->lock);
+  if (r) PROM_LOG(PROM_PTHREAD_RWLOCK_UNLOCK_ERROR);
+  prom_free(ranges);
+  return scrape;
+}
+
+int prom_collector_registry_generation_matching(prom_collector_registry_t *self, const char **names,
+                                               size_t name_count, const char **prefixes, size_t prefix_count,
+                                               uint64_t *generation) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+  if (name_count + prefix_count == 0) return prom_collector_registry_generation(self, generation);
+
+  prom_collector_registry_range_t *ranges = (prom_collector_registry_range_t *)prom_malloc(
+      (name_count + prefix_count) * sizeof(prom_collector_registry_range_t));
+  if (ranges == NULL) return 1;
+  int r = pthread_rwlock_rdlock(self->lock);
+  if (r) {
+    PROM_LOG(PROM_PTHREAD_RWLOCK_LOCK_ERROR);
+    prom_free(ranges);
+    return r;
+  }
+
+  prom_collector_registry_match(self, names, name_count, prefixes, prefix_count, ranges);
+  uint64_t sum = 0;
+  size_t next = 0;
+  for (size_t i = 0; i < name_count + prefix_count; i++) {
+    for (size_t entry = ranges[i].begin > next ? ranges[i].begin : next; entry < ranges[i].end; entry++) {
+      prom_metric_index_entry_t *current = &self->metric_index->entries[entry];
+      // Counted like in prom_collector_generation. The collections of a collector are added once per matched metric,
+      // the sum grows with them all the same
+      if (current->collector->is_volatile) continue;
+      if (current->collector->collect_fn != &prom_collector_default_collect) {
+        sum += atomic_load_explicit(&current->collector->collections, memory_order_acquire);
+      } else {
+        sum += atomic_load_explicit(&current->metric->generation, memory_order_acquire);
+      }
+    }
+    if (ranges[i].end > next) next = ranges[i].end;
+  }
+
+  r = pthread_rwlock_unlock(self->lock);
+  prom_free(ranges);
+  if (r) {
+    PROM_LOG(PROM_PTHREAD_RWLOCK_UNLOCK_ERROR);
+    return r;
+  }
+  *generation = sum;
+  return 0;
+}
+
+const char *prom_collector_registry_scrape_str(prom_collector_registry_scrape_t *scrape) {
+  PROM_ASSERT(scrape != NULL);
+  return prom_metric_formatter_str(scrape->formatter);
+}
+
+size_t prom_collector_registry_scrape_len(prom_collector_registry_scrape_t *scrape) {
+  PROM_ASSERT(scrape != NULL);
+  return prom_metric_formatter_len(scrape->formatter);
+}
+
+void prom_collector_registry_scrape_release(prom_collector_registry_scrape_t *scrape) {
+  if (scrape == NULL) return;
+
+  if (scrape->registry == NULL) {
+    if (scrape->formatter != NULL) prom_metric_formatter_destroy(scrape->formatter);
+    prom_free(scrape);
+    return;
+  }
+
+  prom_collector_registry_t *self = scrape->registry;
+  int r = pthread_mutex_lock(self->scrape_pool_lock);
+  if (r) {
+    PROM_LOG(PROM_PTHREAD_MUTEX_LOCK_ERROR);
+    return;
+  }
+  scrape->in_use = false;
+  r = pthread_mutex_unlock(self->scrape_pool_lock);
+  if (r) PROM_LOG(PROM_PTHREAD_MUTEX_UNLOCK_ERROR);
+}
+
+prom_collector_registry_stream_t *prom_collector_registry_stream_new(prom_collector_registry_t *self) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return NULL;
+
+  prom_collector_registry_stream_t *stream =
+      (prom_collector_registry_stream_t *)prom_malloc(sizeof(prom_collector_registry_stream_t));
+  if (stream == NULL) return NULL;
+  stream->registry = self;
+  stream->scrape = prom_collector_registry_scrape_acquire(self);
+  if (stream->scrape == NULL) {
+    prom_free(stream);
+    return NULL;
+  }
+  stream->offset = 0;
+  stream->collector_node = self->collectors->keys->head;
+  stream->metrics = NULL;
+  stream->metric_node = NULL;
+  return stream;
+}
+
+/**
+ * @brief Moves the stream to its next metric, collecting the next collectors as needed
+ * @param metric Set to the next metric, NULL once every collector has been rendered
+ */
+static int prom_collector_registry_stream_next(prom_collector_registry_stream_t *self, prom_metric_t **metric) {
+  while (self->metric_node == NULL) {
+    if (self->collector_node == NULL) {
+      *metric = NULL;
+      return 0;
+    }
+    const char *collector_name = (const char *)self->collector_node->item;
+    self->collector_node = self->collector_node->next;
+    prom_collector_t *collector = (prom_collector_t *)prom_map_get(self->registry->collectors, collector_name);
+    if (collector == NULL) return 1;
+    self->metrics = prom_collector_collect(collector);
+    if (self->metrics == NULL) return 1;
+    self->metric_node = self->metrics->keys->head;
+  }
+
+  const char *metric_name = (const char *)self->metric_node->item;
+  self->metric_node = self->metric_node->next;
+  *metric = (prom_metric_t *)prom_map_get(self->metrics, metric_name);
+  return *metric == NULL;
+}
+
+int prom_collector_registry_stream_read(prom_collector_registry_stream_t *self, char *buf, size_t size, size_t *len) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+
+  int r = 0;
+  prom_metric_formatter_t *formatter = self->scrape->formatter;
+  *len = 0;
+  while (*len < size) {
+    size_t available = prom_metric_formatter_len(formatter) - self->offset;
+    if (available > 0) {
+      size_t n = available < size - *len ? available : size - *len;
+      memcpy(buf + *len, prom_metric_formatter_str(formatter) + self->offset, n);
+      self->offset += n;
+      *len += n;
+      continue;
+    }
+
+    // The buffer has been read, it is reused for the next metric
+    prom_metric_t *metric = NULL;
+    r = prom_collector_registry_stream_next(self, &metric);
+    if (r) {
+      PROM_LOG("failed to load metrics");
+      return r;
+    }
+    if (metric == NULL) break;
+    r = prom_metric_formatter_reset(formatter);
+    if (r) return r;
+    self->offset = 0;
+    r = prom_metric_formatter_load_metric(formatter, metric);
+    if (r) {
+      PROM_LOG("failed to load metrics");
+      return r;
+    }
+  }
+  return 0;
+}
+
+void prom_collector_registry_stream_destroy(prom_collector_registry_stream_t *self) {
+  if (self == NULL) return;
+  prom_collector_registry_scrape_release(self->scrape);
+  self->scrape = NULL;
+  prom_free(self);
+}
+
+int prom_collector_registry_generation(prom_collector_registry_t *self, uint64_t *generation) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+
+  int r = pthread_rwlock_rdlock(self->lock);
+  if (r) {
+    PROM_LOG(PROM_PTHREAD_RWLOCK_LOCK_ERROR);
+    return r;
+  }
+
+  uint64_t sum = 0;
+  for (prom_linked_list_node_t *current_node = self->collectors->keys->head; !r && current_node != NULL;
+       current_node = current_node->next) {
+    prom_collector_t *collector = (prom_collector_t *)prom_map_get(self->collectors, (const char *)current_node->item);
+    uint64_t collector_generation = 0;
+    r = collector == NULL ? 1 : prom_collector_generation(collector, &collector_generation);
+    sum += collector_generation;
+  }
+
+  int unlock_r = pthread_rwlock_unlock(self->lock);
+  if (unlock_r) {
+    PROM_LOG(PROM_PTHREAD_RWLOCK_UNLOCK_ERROR);
+    return unlock_r;
+  }
+  if (r) return r;
+  *generation = sum;
+  return 0;
+}
+
 const char *prom_collector_registry_bridge(prom_collector_registry_t *self) {
-  prom_metric_formatter_clear(self->metric_formatter);
-  prom_metric_formatter_load_metrics(self->metric_formatter, self->collectors);
-  return (const char *)prom_metric_formatter_dump(self->metric_formatter);
+  prom_collector_registry_scrape_t *scrape = prom_collector_registry_scrape(self);
+  if (scrape == NULL) return NULL;
+  // Copied rather than dumped, dumping would drop the capacity of the pooled buffer
+  size_t len = prom_metric_formatter_len(scrape->formatter);
+  char *out = (char *)prom_malloc(len + 1);
+  if (out != NULL) memcpy(out, prom_metric_formatter_str(scrape->formatter), len + 1);
+  prom_collector_registry_scrape_release(scrape);
+  return out;
 }
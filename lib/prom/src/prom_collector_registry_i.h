@@ -23,4 +23,10 @@ int prom_collector_registry_enable_custom_process_metrics(prom_collector_registr
                                                           const char *process_limits_path,
                                                           const char *process_stats_path);
 
+/**
+ * @brief API PRIVATE Adds a metric added to a registered collector to the metric index of the registry
+ */
+int prom_collector_registry_index_metric(prom_collector_registry_t *self, prom_collector_t *collector,
+                                         prom_metric_t *metric);
+
 #endif  // PROM_COLLECTOR_REGISTRY_I_INCLUDED
@@ -24,17 +24,42 @@
 #include "prom_collector_registry.h"
 
 // Private
+#include "prom_linked_list_t.h"
 #include "prom_map_t.h"
 #include "prom_metric_formatter_t.h"
+#include "prom_metric_index_t.h"
 #include "prom_string_builder_t.h"
 
+/**
+ * @brief API PRIVATE Number of scrape buffers a registry keeps, i.e. of concurrent scrapes served without allocating
+ */
+#define PROM_COLLECTOR_REGISTRY_SCRAPE_POOL_SIZE 4
+
+struct prom_collector_registry_scrape {
+  prom_collector_registry_t *registry; /**< registry owning the buffer, NULL for a one-off buffer */
+  prom_metric_formatter_t *formatter;  /**< formatter whose buffer holds the rendered scrape */
+  bool in_use;                         /**< whether the buffer is lent to a scrape */
+};
+
+struct prom_collector_registry_stream {
+  prom_collector_registry_t *registry;      /**< registry being rendered */
+  prom_collector_registry_scrape_t *scrape; /**< buffer holding the metric being read */
+  size_t offset;                            /**< bytes of the buffer already read */
+  prom_linked_list_node_t *collector_node;  /**< next collector to collect */
+  prom_map_t *metrics;                      /**< metrics of the collector being rendered */
+  prom_linked_list_node_t *metric_node;     /**< next metric of that collector to render */
+};
+
 struct prom_collector_registry {
   const char *name;
-  bool disable_process_metrics;              /**< Disables the collection of process metrics */
-  prom_map_t *collectors;                    /**< Map of collectors keyed by name */
-  prom_string_builder_t *string_builder;     /**< Enables string building */
-  prom_metric_formatter_t *metric_formatter; /**< metric formatter for metric exposition on bridge call */
-  pthread_rwlock_t *lock;                    /**< mutex for safety against concurrent registration */
+  bool disable_process_metrics;          /**< Disables the collection of process metrics */
+  prom_map_t *collectors;                /**< Map of collectors keyed by name */
+  prom_metric_index_t *metric_index;     /**< metrics of the collectors sorted by name */
+  prom_string_builder_t *string_builder; /**< Enables string building */
+  /** Buffers lent to scrapes, they keep their capacity from one scrape to the next */
+  prom_collector_registry_scrape_t scrape_pool[PROM_COLLECTOR_REGISTRY_SCRAPE_POOL_SIZE];
+  pthread_mutex_t *scrape_pool_lock; /**< guards the in_use flags of the scrape buffers */
+  pthread_rwlock_t *lock;            /**< mutex for safety against concurrent registration */
 };
 
 #endif  // PROM_REGISTRY_T_H
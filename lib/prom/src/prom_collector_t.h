@@ -17,7 +17,12 @@
 #ifndef PROM_COLLECTOR_T_H
 #define PROM_COLLECTOR_T_H
 
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
 #include "prom_collector.h"
+#include "prom_collector_registry.h"
 #include "prom_map_t.h"
 #include "prom_string_builder_t.h"
 
@@ -28,6 +33,9 @@ struct prom_collector {
   prom_string_builder_t *string_builder;
   const char *proc_limits_file_path;
   const char *proc_stat_file_path;
+  prom_collector_registry_t *registry; /**< registry indexing the metrics of the collector, NULL until registered */
+  _Atomic uint64_t collections; /**< starts at 1, bumped after every collection by a collect_fn of its own */
+  bool is_volatile;             /**< whether the metrics are left out of the generation */
 };
 
 #endif  // PROM_COLLECTOR_T_H
@@ -64,3 +64,13 @@ int prom_counter_add(prom_counter_t *self, double r_value, const char **label_va
   if (sample == NULL) return 1;
   return prom_metric_sample_add(sample, r_value);
 }
+
+prom_metric_sample_t *prom_counter_with_labels(prom_counter_t *self, const char **label_values) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return NULL;
+  if (self->type != PROM_COUNTER) {
+    PROM_LOG(PROM_METRIC_INCORRECT_TYPE);
+    return NULL;
+  }
+  return prom_metric_sample_from_labels(self, label_values);
+}
@@ -0,0 +1,349 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Shortest round-trip double to string conversion based on the Grisu2 algorithm of Florian Loitsch, "Printing
+ * Floating-Point Numbers Quickly and Accurately with Integers" (PLDI 2010). Grisu2 always produces a string that parses
+ * back to the same double and, for the vast majority of values, the shortest one.
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+// Private
+#include "prom_dtoa_i.h"
+
+#define PROM_DTOA_SIGNIFICAND_SIZE 52
+#define PROM_DTOA_EXPONENT_BIAS (0x3FF + PROM_DTOA_SIGNIFICAND_SIZE)
+#define PROM_DTOA_MIN_EXPONENT (-PROM_DTOA_EXPONENT_BIAS)
+#define PROM_DTOA_EXPONENT_MASK UINT64_C(0x7FF0000000000000)
+#define PROM_DTOA_SIGNIFICAND_MASK UINT64_C(0x000FFFFFFFFFFFFF)
+#define PROM_DTOA_HIDDEN_BIT UINT64_C(0x0010000000000000)
+
+// Integral values below 2^53 are exact and take the integer fast path
+#define PROM_DTOA_MAX_EXACT_INTEGER 9007199254740992.0
+
+/**
+ * @brief A floating point number f * 2^e with a 64 bits significand
+ */
+typedef struct prom_dtoa_fp {
+  uint64_t f;
+  int e;
+} prom_dtoa_fp_t;
+
+// Normalized 10^k for k = -348, -340, ..., 340
+static const uint64_t prom_dtoa_cached_powers_f[] = {
+    UINT64_C(0xfa8fd5a0081c0288), UINT64_C(0xbaaee17fa23ebf76), UINT64_C(0x8b16fb203055ac76),
+    UINT64_C(0xcf42894a5dce35ea), UINT64_C(0x9a6bb0aa55653b2d), UINT64_C(0xe61acf033d1a45df),
+    UINT64_C(0xab70fe17c79ac6ca), UINT64_C(0xff77b1fcbebcdc4f), UINT64_C(0xbe5691ef416bd60c),
+    UINT64_C(0x8dd01fad907ffc3c), UINT64_C(0xd3515c2831559a83), UINT64_C(0x9d71ac8fada6c9b5),
+    UINT64_C(0xea9c227723ee8bcb), UINT64_C(0xaecc49914078536d), UINT64_C(0x823c12795db6ce57),
+    UINT64_C(0xc21094364dfb5637), UINT64_C(0x9096ea6f3848984f), UINT64_C(0xd77485cb25823ac7),
+    UINT64_C(0xa086cfcd97bf97f4), UINT64_C(0xef340a98172aace5), UINT64_C(0xb23867fb2a35b28e),
+    UINT64_C(0x84c8d4dfd2c63f3b), UINT64_C(0xc5dd44271ad3cdba), UINT64_C(0x936b9fcebb25c996),
+    UINT64_C(0xdbac6c247d62a584), UINT64_C(0xa3ab66580d5fdaf6), UINT64_C(0xf3e2f893dec3f126),
+    UINT64_C(0xb5b5ada8aaff80b8), UINT64_C(0x87625f056c7c4a8b), UINT64_C(0xc9bcff6034c13053),
+    UINT64_C(0x964e858c91ba2655), UINT64_C(0xdff9772470297ebd), UINT64_C(0xa6dfbd9fb8e5b88f),
+    UINT64_C(0xf8a95fcf88747d94), UINT64_C(0xb94470938fa89bcf), UINT64_C(0x8a08f0f8bf0f156b),
+    UINT64_C(0xcdb02555653131b6), UINT64_C(0x993fe2c6d07b7fac), UINT64_C(0xe45c10c42a2b3b06),
+    UINT64_C(0xaa242499697392d3), UINT64_C(0xfd87b5f28300ca0e), UINT64_C(0xbce5086492111aeb),
+    UINT64_C(0x8cbccc096f5088cc), UINT64_C(0xd1b71758e219652c), UINT64_C(0x9c40000000000000),
+    UINT64_C(0xe8d4a51000000000), UINT64_C(0xad78ebc5ac620000), UINT64_C(0x813f3978f8940984),
+    UINT64_C(0xc097ce7bc90715b3), UINT64_C(0x8f7e32ce7bea5c70), UINT64_C(0xd5d238a4abe98068),
+    UINT64_C(0x9f4f2726179a2245), UINT64_C(0xed63a231d4c4fb27), UINT64_C(0xb0de65388cc8ada8),
+    UINT64_C(0x83c7088e1aab65db), UINT64_C(0xc45d1df942711d9a), UINT64_C(0x924d692ca61be758),
+    UINT64_C(0xda01ee641a708dea), UINT64_C(0xa26da3999aef774a), UINT64_C(0xf209787bb47d6b85),
+    UINT64_C(0xb454e4a179dd1877), UINT64_C(0x865b86925b9bc5c2), UINT64_C(0xc83553c5c8965d3d),
+    UINT64_C(0x952ab45cfa97a0b3), UINT64_C(0xde469fbd99a05fe3), UINT64_C(0xa59bc234db398c25),
+    UINT64_C(0xf6c69a72a3989f5c), UINT64_C(0xb7dcbf5354e9bece), UINT64_C(0x88fcf317f22241e2),
+    UINT64_C(0xcc20ce9bd35c78a5), UINT64_C(0x98165af37b2153df), UINT64_C(0xe2a0b5dc971f303a),
+    UINT64_C(0xa8d9d1535ce3b396), UINT64_C(0xfb9b7cd9a4a7443c), UINT64_C(0xbb764c4ca7a44410),
+    UINT64_C(0x8bab8eefb6409c1a), UINT64_C(0xd01fef10a657842c), UINT64_C(0x9b10a4e5e9913129),
+    UINT64_C(0xe7109bfba19c0c9d), UINT64_C(0xac2820d9623bf429), UINT64_C(0x80444b5e7aa7cf85),
+    UINT64_C(0xbf21e44003acdd2d), UINT64_C(0x8e679c2f5e44ff8f), UINT64_C(0xd433179d9c8cb841),
+    UINT64_C(0x9e19db92b4e31ba9), UINT64_C(0xeb96bf6ebadf77d9), UINT64_C(0xaf87023b9bf0ee6b),
+};
+
+static const int16_t prom_dtoa_cached_powers_e[] = {
+    -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980, -954, -927,
+    -901, -874, -847, -821, -794, -768, -741, -715, -688, -661, -635, -608,
+    -582, -555, -529, -502, -475, -449, -422, -396, -369, -343, -316, -289,
+    -263, -236, -210, -183, -157, -130, -103, -77, -50, -24, 3, 30,
+    56, 83, 109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+    375, 402, 428, 455, 481, 508, 534, 561, 588, 614, 641, 667,
+    694, 720, 747, 774, 800, 827, 853, 880, 907, 933, 960, 986,
+    1013, 1039, 1066,
+};
+
+static const uint64_t prom_dtoa_pow10[] = {1ULL,
+                                           10ULL,
+                                           100ULL,
+                                           1000ULL,
+                                           10000ULL,
+                                           100000ULL,
+                                           1000000ULL,
+                                           10000000ULL,
+                                           100000000ULL,
+                                           1000000000ULL,
+                                           10000000000ULL,
+                                           100000000000ULL,
+                                           1000000000000ULL,
+                                           10000000000000ULL,
+                                           100000000000000ULL,
+                                           1000000000000000ULL,
+                                           10000000000000000ULL,
+                                           100000000000000000ULL,
+                                           1000000000000000000ULL,
+                                           10000000000000000000ULL};
+
+static prom_dtoa_fp_t prom_dtoa_fp_from_double(double value) {
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  int biased_e = (int)((bits & PROM_DTOA_EXPONENT_MASK) >> PROM_DTOA_SIGNIFICAND_SIZE);
+  uint64_t significand = bits & PROM_DTOA_SIGNIFICAND_MASK;
+  prom_dtoa_fp_t fp;
+  if (biased_e != 0) {
+    fp.f = significand + PROM_DTOA_HIDDEN_BIT;
+    fp.e = biased_e - PROM_DTOA_EXPONENT_BIAS;
+  } else {
+    // Subnormal
+    fp.f = significand;
+    fp.e = PROM_DTOA_MIN_EXPONENT + 1;
+  }
+  return fp;
+}
+
+static prom_dtoa_fp_t prom_dtoa_fp_mul(prom_dtoa_fp_t x, prom_dtoa_fp_t y) {
+  const uint64_t mask = 0xFFFFFFFFu;
+  uint64_t a = x.f >> 32, b = x.f & mask, c = y.f >> 32, d = y.f & mask;
+  uint64_t ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+  uint64_t tmp = (bd >> 32) + (ad & mask) + (bc & mask);
+  tmp += 1U << 31;  // Round to nearest
+  prom_dtoa_fp_t fp = {ac + (ad >> 32) + (bc >> 32) + (tmp >> 32), x.e + y.e + 64};
+  return fp;
+}
+
+static prom_dtoa_fp_t prom_dtoa_fp_normalize(prom_dtoa_fp_t x) {
+  int shift = __builtin_clzll(x.f);
+  prom_dtoa_fp_t fp = {x.f << shift, x.e - shift};
+  return fp;
+}
+
+/**
+ * @brief Computes the boundaries m- and m+ of the interval of reals that round to the value, with the same exponent
+ */
+static void prom_dtoa_normalized_boundaries(prom_dtoa_fp_t v, prom_dtoa_fp_t *minus, prom_dtoa_fp_t *plus) {
+  prom_dtoa_fp_t pl = {(v.f << 1) + 1, v.e - 1};
+  pl = prom_dtoa_fp_normalize(pl);
+  prom_dtoa_fp_t mi;
+  if (v.f == PROM_DTOA_HIDDEN_BIT) {
+    // The lower neighbour is closer when the significand is a power of two
+    mi.f = (v.f << 2) - 1;
+    mi.e = v.e - 2;
+  } else {
+    mi.f = (v.f << 1) - 1;
+    mi.e = v.e - 1;
+  }
+  mi.f <<= mi.e - pl.e;
+  mi.e = pl.e;
+  *plus = pl;
+  *minus = mi;
+}
+
+/**
+ * @brief Returns the cached power c = 10^-k such that the exponent of e + c falls in [-60, -32]
+ */
+static prom_dtoa_fp_t prom_dtoa_cached_power(int e, int *k) {
+  double dk = (-61 - e) * 0.30102999566398114 + 347;  // log10(2)
+  int ik = (int)dk;
+  if (dk - ik > 0.0) ik++;
+  unsigned index = (unsigned)((ik >> 3) + 1);
+  *k = -(-348 + (int)(index << 3));
+  prom_dtoa_fp_t fp = {prom_dtoa_cached_powers_f[index], prom_dtoa_cached_powers_e[index]};
+  return fp;
+}
+
+static void prom_dtoa_round(char *buffer, int len, uint64_t delta, uint64_t rest, uint64_t ten_kappa, uint64_t wp_w) {
+  while (rest < wp_w && delta - rest >= ten_kappa &&
+         (rest + ten_kappa < wp_w || wp_w - rest > rest + ten_kappa - wp_w)) {
+    buffer[len - 1]--;
+    rest += ten_kappa;
+  }
+}
+
+static int prom_dtoa_count_digits(uint32_t n) {
+  int digits = 1;
+  while (digits < 10 && n >= prom_dtoa_pow10[digits]) digits++;
+  return digits;
+}
+
+/**
+ * @brief Generates the digits of the shortest number in the interval (mp - delta, mp) closest to w
+ */
+static void prom_dtoa_digit_gen(prom_dtoa_fp_t w, prom_dtoa_fp_t mp, uint64_t delta, char *buffer, int *len, int *k) {
+  const prom_dtoa_fp_t one = {UINT64_C(1) << -mp.e, mp.e};
+  const uint64_t wp_w = mp.f - w.f;
+  uint32_t p1 = (uint32_t)(mp.f >> -one.e);
+  uint64_t p2 = mp.f & (one.f - 1);
+  int kappa = prom_dtoa_count_digits(p1);
+  *len = 0;
+
+  // Integral part
+  while (kappa > 0) {
+    uint32_t d = (uint32_t)(p1 / prom_dtoa_pow10[kappa - 1]);
+    p1 = (uint32_t)(p1 % prom_dtoa_pow10[kappa - 1]);
+    if (d || *len) buffer[(*len)++] = (char)('0' + d);
+    kappa--;
+    uint64_t rest = ((uint64_t)p1 << -one.e) + p2;
+    if (rest <= delta) {
+      *k += kappa;
+      prom_dtoa_round(buffer, *len, delta, rest, prom_dtoa_pow10[kappa] << -one.e, wp_w);
+      return;
+    }
+  }
+
+  // Fractional part
+  for (;;) {
+    p2 *= 10;
+    delta *= 10;
+    char d = (char)(p2 >> -one.e);
+    if (d || *len) buffer[(*len)++] = (char)('0' + d);
+    p2 &= one.f - 1;
+    kappa--;
+    if (p2 < delta) {
+      *k += kappa;
+      int index = -kappa;
+      prom_dtoa_round(buffer, *len, delta, p2, one.f, index < 20 ? wp_w * prom_dtoa_pow10[index] : 0);
+      return;
+    }
+  }
+}
+
+/**
+ * @brief Writes the digits of a positive value into buffer, the value being digits * 10^k
+ */
+static void prom_dtoa_grisu2(double value, char *buffer, int *len, int *k) {
+  prom_dtoa_fp_t v = prom_dtoa_fp_from_double(value);
+  prom_dtoa_fp_t w_m, w_p;
+  prom_dtoa_normalized_boundaries(v, &w_m, &w_p);
+
+  const prom_dtoa_fp_t c_mk = prom_dtoa_cached_power(w_p.e, k);
+  const prom_dtoa_fp_t w = prom_dtoa_fp_mul(prom_dtoa_fp_normalize(v), c_mk);
+  prom_dtoa_fp_t wp = prom_dtoa_fp_mul(w_p, c_mk);
+  prom_dtoa_fp_t wm = prom_dtoa_fp_mul(w_m, c_mk);
+  // Shrink the interval by one unit on each side to stay inside it despite the rounding of the products
+  wm.f++;
+  wp.f--;
+  prom_dtoa_digit_gen(w, wp, wp.f - wm.f, buffer, len, k);
+}
+
+static size_t prom_dtoa_write_exponent(int k, char *buffer) {
+  char *start = buffer;
+  *buffer++ = k < 0 ? '-' : '+';
+  if (k < 0) k = -k;
+  if (k >= 100) {
+    *buffer++ = (char)('0' + k / 100);
+    k %= 100;
+    *buffer++ = (char)('0' + k / 10);
+  } else if (k >= 10) {
+    *buffer++ = (char)('0' + k / 10);
+  }
+  *buffer++ = (char)('0' + k % 10);
+  return (size_t)(buffer - start);
+}
+
+/**
+ * @brief Lays out len digits worth digits * 10^k in fixed or scientific notation and returns the resulting length
+ */
+static size_t prom_dtoa_prettify(char *buffer, int len, int k) {
+  const int kk = len + k;  // 10^(kk - 1) <= v < 10^kk
+
+  if (len <= kk && kk <= 21) {
+    // 1234e7 -> 12340000000
+    for (int i = len; i < kk; i++) buffer[i] = '0';
+    return (size_t)kk;
+  }
+  if (0 < kk && kk <= 21) {
+    // 1234e-2 -> 12.34
+    memmove(&buffer[kk + 1], &buffer[kk], (size_t)(len - kk));
+    buffer[kk] = '.';
+    return (size_t)len + 1;
+  }
+  if (-6 < kk && kk <= 0) {
+    // 1234e-6 -> 0.001234
+    const int offset = 2 - kk;
+    memmove(&buffer[offset], &buffer[0], (size_t)len);
+    buffer[0] = '0';
+    buffer[1] = '.';
+    for (int i = 2; i < offset; i++) buffer[i] = '0';
+    return (size_t)(len + offset);
+  }
+  if (len == 1) {
+    // 1e30
+    buffer[1] = 'e';
+    return 2 + prom_dtoa_write_exponent(kk - 1, &buffer[2]);
+  }
+  // 1234e30 -> 1.234e+33
+  memmove(&buffer[2], &buffer[1], (size_t)(len - 1));
+  buffer[1] = '.';
+  buffer[len + 1] = 'e';
+  return (size_t)len + 2 + prom_dtoa_write_exponent(kk - 1, &buffer[len + 2]);
+}
+
+/**
+ * @brief Writes a non-negative integer and returns its length
+ */
+static size_t prom_dtoa_write_integer(uint64_t value, char *buffer) {
+  char digits[20];
+  size_t len = 0;
+  do {
+    digits[len++] = (char)('0' + value % 10);
+    value /= 10;
+  } while (value != 0);
+  for (size_t i = 0; i < len; i++) buffer[i] = digits[len - 1 - i];
+  return len;
+}
+
+size_t prom_dtoa(double value, char *buf) {
+  size_t len = 0;
+
+  if (isnan(value)) {
+    memcpy(buf, "NaN", 4);
+    return 3;
+  }
+  if (isinf(value)) {
+    memcpy(buf, value > 0 ? "+Inf" : "-Inf", 5);
+    return 4;
+  }
+
+  if (signbit(value)) {
+    buf[len++] = '-';
+    value = -value;
+  }
+
+  if (value < PROM_DTOA_MAX_EXACT_INTEGER && value == (double)(uint64_t)value) {
+    // Counters and most gauges are integral, they skip Grisu altogether
+    len += prom_dtoa_write_integer((uint64_t)value, buf + len);
+  } else {
+    int digits = 0;
+    int k = 0;
+    prom_dtoa_grisu2(value, buf + len, &digits, &k);
+    len += prom_dtoa_prettify(buf + len, digits, k);
+  }
+  buf[len] = '\0';
+  return len;
+}
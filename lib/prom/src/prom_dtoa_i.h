@@ -0,0 +1,37 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PROM_DTOA_I_H
+#define PROM_DTOA_I_H
+
+#include <stddef.h>
+
+/**
+ * @brief API PRIVATE Size of a buffer large enough for any double formatted by prom_dtoa, terminating null included
+ */
+#define PROM_DTOA_BUFFER_SIZE 32
+
+/**
+ * @brief API PRIVATE Writes the shortest decimal representation of value that parses back to the same double into buf,
+ * of PROM_DTOA_BUFFER_SIZE bytes, and returns its length. The string is null terminated.
+ *
+ * Integral values are written as plain integers. Other values are written in fixed notation when their decimal
+ * exponent is in [-6, 21) and in scientific notation otherwise, e.g. 0.25, 1.5e+300. NaN and the infinities are written
+ * as NaN, +Inf and -Inf, as the exposition format expects.
+ */
+size_t prom_dtoa(double value, char *buf);
+
+#endif  // PROM_DTOA_I_H
@@ -99,3 +99,13 @@ int prom_gauge_set(prom_gauge_t *self, double r_value, const char **label_values
   if (sample == NULL) return 1;
   return prom_metric_sample_set(sample, r_value);
 }
+
+prom_metric_sample_t *prom_gauge_with_labels(prom_gauge_t *self, const char **label_values) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return NULL;
+  if (self->type != PROM_GAUGE) {
+    PROM_LOG(PROM_METRIC_INCORRECT_TYPE);
+    return NULL;
+  }
+  return prom_metric_sample_from_labels(self, label_values);
+}
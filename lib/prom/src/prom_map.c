@@ -16,6 +16,8 @@
 
 #include <pthread.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
 
 // Public
 #include "prom_alloc.h"
@@ -79,39 +81,30 @@ prom_map_t *prom_map_new() {
   prom_map_t *self = (prom_map_t *)prom_malloc(sizeof(prom_map_t));
   self->size = 0;
   self->max_size = PROM_MAP_INITIAL_SIZE;
+  self->slots = NULL;
+  self->rwlock = NULL;
 
   self->keys = prom_linked_list_new();
   if (self->keys == NULL) return NULL;
 
-  // These each key will be allocated once by prom_map_node_new and used here as well to save memory. With that said
-  // we will only have to deallocate each key once. That will happen on prom_map_node_destroy.
+  // Each key is allocated once by prom_map_set_internal and owned by its slot, the list of keys only references it. With
+  // that said we will only have to deallocate each key once. That will happen when the slot is emptied.
   r = prom_linked_list_set_free_fn(self->keys, prom_linked_list_no_op_free);
   if (r) {
     prom_map_destroy(self);
     return NULL;
   }
 
-  self->addrs = prom_malloc(sizeof(prom_linked_list_t) * self->max_size);
+  self->slots = prom_malloc(sizeof(prom_map_slot_t) * self->max_size);
+  memset(self->slots, 0, sizeof(prom_map_slot_t) * self->max_size);
   self->free_value_fn = destroy_map_node_value_no_op;
 
-  for (int i = 0; i < self->max_size; i++) {
-    self->addrs[i] = prom_linked_list_new();
-    r = prom_linked_list_set_free_fn(self->addrs[i], prom_map_node_free);
-    if (r) {
-      prom_map_destroy(self);
-      return NULL;
-    }
-    r = prom_linked_list_set_compare_fn(self->addrs[i], prom_map_node_compare);
-    if (r) {
-      prom_map_destroy(self);
-      return NULL;
-    }
-  }
-
   self->rwlock = (pthread_rwlock_t *)prom_malloc(sizeof(pthread_rwlock_t));
   r = pthread_rwlock_init(self->rwlock, NULL);
   if (r) {
     PROM_LOG(PROM_PTHREAD_RWLOCK_INIT_ERROR);
+    prom_free(self->rwlock);
+    self->rwlock = NULL;
     prom_map_destroy(self);
     return NULL;
   }
@@ -128,18 +121,25 @@ int prom_map_destroy(prom_map_t *self) {
   if (r) ret = r;
   self->keys = NULL;
 
-  for (size_t i = 0; i < self->max_size; i++) {
-    r = prom_linked_list_destroy(self->addrs[i]);
-    if (r) ret = r;
-    self->addrs[i] = NULL;
+  if (self->slots != NULL) {
+    for (size_t i = 0; i < self->max_size; i++) {
+      prom_map_slot_t *slot = &self->slots[i];
+      if (slot->key == NULL) continue;
+      prom_free((void *)slot->key);
+      slot->key = NULL;
+      if (slot->value != NULL) (*self->free_value_fn)(slot->value);
+      slot->value = NULL;
+    }
   }
-  prom_free(self->addrs);
-  self->addrs = NULL;
+  prom_free(self->slots);
+  self->slots = NULL;
 
-  r = pthread_rwlock_destroy(self->rwlock);
-  if (r) {
-    PROM_LOG(PROM_PTHREAD_RWLOCK_DESTROY_ERROR)
-    ret = r;
+  if (self->rwlock != NULL) {
+    r = pthread_rwlock_destroy(self->rwlock);
+    if (r) {
+      PROM_LOG(PROM_PTHREAD_RWLOCK_DESTROY_ERROR)
+      ret = r;
+    }
   }
 
   prom_free(self->rwlock);
@@ -150,64 +150,92 @@ int prom_map_destroy(prom_map_t *self) {
   return ret;
 }
 
-static size_t prom_map_get_index_internal(const char *key, size_t *size, size_t *max_size) {
-  size_t index;
-  size_t a = 31415, b = 27183;
-  for (index = 0; *key != '\0'; key++, a = a * b % (*max_size - 1)) {
-    index = (a * index + *key) % *max_size;
+/**
+ * @brief API PRIVATE hash function that returns a 64-bit hash of the given key.
+ *
+ * The key is consumed eight bytes at a time, each word is mixed into the state with a multiply and xor-shift, and the
+ * final state goes through the murmur3 finalizer so that every input bit affects the low bits used as the home slot.
+ */
+uint64_t prom_map_hash(const char *key) {
+  const uint64_t m = 0x9e3779b97f4a7c15ULL;
+  size_t len = strlen(key);
+  uint64_t h = len * m;
+
+  const char *p = key;
+  for (; len >= 8; p += 8, len -= 8) {
+    uint64_t word;
+    memcpy(&word, p, sizeof(word));
+    h ^= word * m;
+    h ^= h >> 29;
+    h *= m;
   }
-  return index;
+  if (len > 0) {
+    uint64_t word = 0;
+    memcpy(&word, p, len);
+    h ^= word * m;
+    h ^= h >> 29;
+    h *= m;
+  }
+
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
 }
 
 /**
- * @brief API PRIVATE hash function that returns an array index from the given key and prom_map.
- *
- * The algorithm is based off of Horner's method. In a simpler version, you set the return value to 0. Next, for each
- * character in the string, you add the integer value of the current character to the product of the prime number and
- * the current return value, set the result to the return value, then finally return the return value.
- *
- * In this version of the algorithm, we attempt to achieve a probabily of key to index conversion collisions to
- * 1/M (with M being the max_size of the map). This optimizes dispersion and consequently, evens out the performance
- * for gets and sets for each item. Instead of using a fixed prime number, we generate a coefficient for each iteration
- * through the loop.
+ * @brief API PRIVATE returns the home slot of the given key, the slot it takes when it does not collide.
  *
- * Reference:
- *   * Algorithms in C: Third Edition by Robert Sedgewick, p579
+ * The map is an open addressing table with Robin Hood linear probing: every slot stores the full hash of its key, so a
+ * probe only compares the strings of keys whose hash matches, and the distance of an entry from its home slot can be
+ * derived from the hash without looking at the key. A probe stops as soon as it meets an entry closer to its own home
+ * than the probed key would be, which keeps unsuccessful lookups short even at high load.
  */
 size_t prom_map_get_index(prom_map_t *self, const char *key) {
-  return prom_map_get_index_internal(key, &self->size, &self->max_size);
+  return (size_t)prom_map_hash(key) & (self->max_size - 1);
 }
 
-static void *prom_map_get_internal(const char *key, size_t *size, size_t *max_size, prom_linked_list_t *keys,
-                                   prom_linked_list_t **addrs, prom_map_node_free_value_fn free_value_fn) {
-  size_t index = prom_map_get_index_internal(key, size, max_size);
-  prom_linked_list_t *list = addrs[index];
-  prom_map_node_t *temp_map_node = prom_map_node_new(key, NULL, free_value_fn);
-
-  for (prom_linked_list_node_t *current_node = list->head; current_node != NULL; current_node = current_node->next) {
-    prom_map_node_t *current_map_node = (prom_map_node_t *)current_node->item;
-    prom_linked_list_compare_t result = prom_linked_list_compare(list, current_map_node, temp_map_node);
-    if (result == PROM_EQUAL) {
-      prom_map_node_destroy(temp_map_node);
-      temp_map_node = NULL;
-      return current_map_node->value;
-    }
+/**
+ * @brief API PRIVATE returns the distance of the entry in the given slot from its home slot.
+ */
+static inline size_t prom_map_probe_distance(const prom_map_slot_t *slot, size_t index, size_t mask) {
+  return (index - ((size_t)slot->hash & mask)) & mask;
+}
+
+/**
+ * @brief API PRIVATE returns the slot holding the given key, or NULL if the key is not present.
+ */
+static prom_map_slot_t *prom_map_find_internal(const char *key, uint64_t hash, prom_map_slot_t *slots,
+                                               size_t max_size) {
+  size_t mask = max_size - 1;
+  size_t index = (size_t)hash & mask;
+  for (size_t distance = 0; distance < max_size; distance++, index = (index + 1) & mask) {
+    prom_map_slot_t *slot = &slots[index];
+    if (slot->key == NULL || prom_map_probe_distance(slot, index, mask) < distance) return NULL;
+    if (slot->hash == hash && strcmp(slot->key, key) == 0) return slot;
   }
-  prom_map_node_destroy(temp_map_node);
-  temp_map_node = NULL;
   return NULL;
 }
 
 void *prom_map_get(prom_map_t *self, const char *key) {
+  PROM_ASSERT(self != NULL);
+  return prom_map_get_with_hash(self, key, prom_map_hash(key));
+}
+
+void *prom_map_get_with_hash(prom_map_t *self, const char *key, uint64_t hash) {
   PROM_ASSERT(self != NULL);
   int r = 0;
-  r = pthread_rwlock_wrlock(self->rwlock);
+  // Lookups only read the table, so any number of them run concurrently and only wait for prom_map_set/delete
+  r = pthread_rwlock_rdlock(self->rwlock);
   if (r) {
     PROM_LOG(PROM_PTHREAD_RWLOCK_LOCK_ERROR);
-    NULL;
+    return NULL;
   }
-  void *payload =
-      prom_map_get_internal(key, &self->size, &self->max_size, self->keys, self->addrs, self->free_value_fn);
+  // The probe key is compared in place against the stored keys, a lookup never allocates
+  prom_map_slot_t *slot = prom_map_find_internal(key, hash, self->slots, self->max_size);
+  void *payload = slot != NULL ? slot->value : NULL;
   r = pthread_rwlock_unlock(self->rwlock);
   if (r) {
     PROM_LOG(PROM_PTHREAD_RWLOCK_UNLOCK_ERROR);
@@ -216,105 +244,70 @@ void *prom_map_get(prom_map_t *self, const char *key) {
   return payload;
 }
 
+/**
+ * @brief API PRIVATE places an entry that is known not to be in the table, displacing richer entries on the way.
+ */
+static void prom_map_place_internal(prom_map_slot_t entry, prom_map_slot_t *slots, size_t max_size) {
+  size_t mask = max_size - 1;
+  size_t index = (size_t)entry.hash & mask;
+  size_t distance = 0;
+  while (slots[index].key != NULL) {
+    size_t existing = prom_map_probe_distance(&slots[index], index, mask);
+    if (existing < distance) {
+      // Robin Hood: the entry further from home takes the slot, the displaced one continues probing
+      prom_map_slot_t displaced = slots[index];
+      slots[index] = entry;
+      entry = displaced;
+      distance = existing;
+    }
+    index = (index + 1) & mask;
+    distance++;
+  }
+  slots[index] = entry;
+}
+
 static int prom_map_set_internal(const char *key, void *value, size_t *size, size_t *max_size, prom_linked_list_t *keys,
-                                 prom_linked_list_t **addrs, prom_map_node_free_value_fn free_value_fn,
+                                 prom_map_slot_t *slots, prom_map_node_free_value_fn free_value_fn,
                                  bool destroy_current_value) {
-  prom_map_node_t *map_node = prom_map_node_new(key, value, free_value_fn);
-  if (map_node == NULL) return 1;
-
-  size_t index = prom_map_get_index_internal(key, size, max_size);
-  prom_linked_list_t *list = addrs[index];
-  for (prom_linked_list_node_t *current_node = list->head; current_node != NULL; current_node = current_node->next) {
-    prom_map_node_t *current_map_node = (prom_map_node_t *)current_node->item;
-    prom_linked_list_compare_t result = prom_linked_list_compare(list, current_map_node, map_node);
-    if (result == PROM_EQUAL) {
-      if (destroy_current_value) {
-        free_value_fn(current_map_node->value);
-        current_map_node->value = NULL;
-      }
-      prom_free((char *)current_map_node->key);
-      current_map_node->key = NULL;
-      prom_free(current_map_node);
-      current_map_node = NULL;
-      current_node->item = map_node;
-      return 0;
-    }
+  uint64_t hash = prom_map_hash(key);
+  prom_map_slot_t *slot = prom_map_find_internal(key, hash, slots, *max_size);
+  if (slot != NULL) {
+    // The key is kept, so the list of keys keeps referencing valid memory
+    if (destroy_current_value && slot->value != NULL && slot->value != value) free_value_fn(slot->value);
+    slot->value = value;
+    return 0;
   }
-  prom_linked_list_append(list, map_node);
-  prom_linked_list_append(keys, (char *)map_node->key);
+
+  prom_map_slot_t entry = {hash, prom_strdup(key), value};
+  if (entry.key == NULL) return 1;
+  prom_map_place_internal(entry, slots, *max_size);
+  prom_linked_list_append(keys, (char *)entry.key);
   (*size)++;
   return 0;
 }
 
 int prom_map_ensure_space(prom_map_t *self) {
   PROM_ASSERT(self != NULL);
-  int r = 0;
 
-  if (self->size <= self->max_size / 2) {
+  // Keep the load factor at or below 7/8, Robin Hood probing keeps probe sequences short up to there
+  if ((self->size + 1) * 8 <= self->max_size * 7) {
     return 0;
   }
 
-  // Increase the max size
   size_t new_max = self->max_size * 2;
-  size_t new_size = 0;
-
-  // Create a new list of keys
-  prom_linked_list_t *new_keys = prom_linked_list_new();
-  if (new_keys == NULL) return 1;
-
-  r = prom_linked_list_set_free_fn(new_keys, prom_linked_list_no_op_free);
-  if (r) return r;
-
-  // Create a new array of addrs
-  prom_linked_list_t **new_addrs = prom_malloc(sizeof(prom_linked_list_t) * new_max);
+  prom_map_slot_t *new_slots = prom_malloc(sizeof(prom_map_slot_t) * new_max);
+  if (new_slots == NULL) return 1;
+  memset(new_slots, 0, sizeof(prom_map_slot_t) * new_max);
 
-  // Initialize the new array
-  for (int i = 0; i < new_max; i++) {
-    new_addrs[i] = prom_linked_list_new();
-    r = prom_linked_list_set_free_fn(new_addrs[i], prom_map_node_free);
-    if (r) return r;
-    r = prom_linked_list_set_compare_fn(new_addrs[i], prom_map_node_compare);
-    if (r) return r;
-  }
-
-  // Iterate through each linked-list at each memory region in the map's backbone
-  for (int i = 0; i < self->max_size; i++) {
-    // Create a new map node for each node in the linked list and insert it into the new map. Afterwards, deallocate
-    // the old map node
-    prom_linked_list_t *list = self->addrs[i];
-    prom_linked_list_node_t *current_node = list->head;
-    while (current_node != NULL) {
-      prom_map_node_t *map_node = (prom_map_node_t *)current_node->item;
-      r = prom_map_set_internal(map_node->key, map_node->value, &new_size, &new_max, new_keys, new_addrs,
-                                self->free_value_fn, false);
-      if (r) return r;
-
-      prom_linked_list_node_t *next = current_node->next;
-      prom_free(current_node);
-      current_node = NULL;
-      prom_free((void *)map_node->key);
-      map_node->key = NULL;
-      prom_free(map_node);
-      map_node = NULL;
-      current_node = next;
-    }
-    // We're done deallocating each map node in the linked list, so deallocate the linked-list object
-    prom_free(self->addrs[i]);
-    self->addrs[i] = NULL;
+  // Entries are moved as they are, the stored hashes save hashing every key again and the keys stay where the list of
+  // keys expects them
+  for (size_t i = 0; i < self->max_size; i++) {
+    if (self->slots[i].key != NULL) prom_map_place_internal(self->slots[i], new_slots, new_max);
   }
-  // Destroy the collection of keys in the map
-  prom_linked_list_destroy(self->keys);
-  self->keys = NULL;
-
-  // Deallocate the backbone of the map
-  prom_free(self->addrs);
-  self->addrs = NULL;
 
-  // Update the members of the current map
-  self->size = new_size;
+  prom_free(self->slots);
+  self->slots = new_slots;
   self->max_size = new_max;
-  self->keys = new_keys;
-  self->addrs = new_addrs;
 
   return 0;
 }
@@ -339,7 +332,7 @@ int prom_map_set(prom_map_t *self, const char *key, void *value) {
       return r;
     }
   }
-  r = prom_map_set_internal(key, value, &self->size, &self->max_size, self->keys, self->addrs, self->free_value_fn,
+  r = prom_map_set_internal(key, value, &self->size, &self->max_size, self->keys, self->slots, self->free_value_fn,
                             true);
   if (r) {
     int rr = 0;
@@ -359,29 +352,32 @@ int prom_map_set(prom_map_t *self, const char *key, void *value) {
 }
 
 static int prom_map_delete_internal(const char *key, size_t *size, size_t *max_size, prom_linked_list_t *keys,
-                                    prom_linked_list_t **addrs, prom_map_node_free_value_fn free_value_fn) {
+                                    prom_map_slot_t *slots, prom_map_node_free_value_fn free_value_fn) {
   int r = 0;
-  size_t index = prom_map_get_index_internal(key, size, max_size);
-  prom_linked_list_t *list = addrs[index];
-  prom_map_node_t *temp_map_node = prom_map_node_new(key, NULL, free_value_fn);
-
-  for (prom_linked_list_node_t *current_node = list->head; current_node != NULL; current_node = current_node->next) {
-    prom_map_node_t *current_map_node = (prom_map_node_t *)current_node->item;
-    prom_linked_list_compare_t result = prom_linked_list_compare(list, current_map_node, temp_map_node);
-    if (result == PROM_EQUAL) {
-      r = prom_linked_list_remove(list, current_node);
-      if (r) return r;
-
-      r = prom_linked_list_remove(keys, (char *)current_map_node->key);
-      if (r) return r;
-
-      (*size)--;
-      break;
-    }
+  prom_map_slot_t *slot = prom_map_find_internal(key, prom_map_hash(key), slots, *max_size);
+  if (slot == NULL) return 0;
+
+  // Unlink the key first, it is freed along with the slot
+  r = prom_linked_list_remove(keys, (char *)slot->key);
+  if (r) return r;
+
+  prom_free((void *)slot->key);
+  if (slot->value != NULL) free_value_fn(slot->value);
+
+  // Backward shift deletion: pull the following entries one slot closer to home until one is already home, so no
+  // tombstones are needed
+  size_t mask = *max_size - 1;
+  size_t index = (size_t)(slot - slots);
+  size_t next = (index + 1) & mask;
+  while (slots[next].key != NULL && prom_map_probe_distance(&slots[next], next, mask) > 0) {
+    slots[index] = slots[next];
+    index = next;
+    next = (next + 1) & mask;
   }
-  r = prom_map_node_destroy(temp_map_node);
-  temp_map_node = NULL;
-  return r;
+  memset(&slots[index], 0, sizeof(prom_map_slot_t));
+
+  (*size)--;
+  return 0;
 }
 
 int prom_map_delete(prom_map_t *self, const char *key) {
@@ -391,9 +387,9 @@ int prom_map_delete(prom_map_t *self, const char *key) {
   r = pthread_rwlock_wrlock(self->rwlock);
   if (r) {
     PROM_LOG(PROM_PTHREAD_RWLOCK_LOCK_ERROR);
-    ret = r;
+    return r;
   }
-  r = prom_map_delete_internal(key, &self->size, &self->max_size, self->keys, self->addrs, self->free_value_fn);
+  r = prom_map_delete_internal(key, &self->size, &self->max_size, self->keys, self->slots, self->free_value_fn);
   if (r) ret = r;
   r = pthread_rwlock_unlock(self->rwlock);
   if (r) {
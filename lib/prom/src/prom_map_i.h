@@ -17,6 +17,8 @@
 #ifndef PROM_MAP_I_INCLUDED
 #define PROM_MAP_I_INCLUDED
 
+#include <stdint.h>
+
 #include "prom_map_t.h"
 
 prom_map_t *prom_map_new(void);
@@ -25,6 +27,16 @@ int prom_map_set_free_value_fn(prom_map_t *self, prom_map_node_free_value_fn fre
 
 void *prom_map_get(prom_map_t *self, const char *key);
 
+/**
+ * @brief API PRIVATE Returns the hash of a key, as used by prom_map_get_with_hash
+ */
+uint64_t prom_map_hash(const char *key);
+
+/**
+ * @brief API PRIVATE Same as prom_map_get, for callers that looked up the key before and kept its hash
+ */
+void *prom_map_get_with_hash(prom_map_t *self, const char *key, uint64_t hash);
+
 int prom_map_set(prom_map_t *self, const char *key, void *value);
 
 int prom_map_delete(prom_map_t *self, const char *key);
@@ -29,6 +29,10 @@
 #include "prom_metric_i.h"
 #include "prom_metric_sample_histogram_i.h"
 #include "prom_metric_sample_i.h"
+#include "prom_metric_template_i.h"
+
+// Size of the stack buffer in which l_values are formatted for lookups, longer ones take the locked slow path
+#define PROM_METRIC_L_VALUE_STACK_SIZE 256
 
 char *prom_metric_type_map[4] = {"counter", "gauge", "histogram", "summary"};
 
@@ -40,6 +44,8 @@ prom_metric_t *prom_metric_new(prom_metric_type_t metric_type, const char *name,
   self->name = name;
   self->help = help;
   self->buckets = NULL;
+  // Starting at 1 makes the sum of the generations of a registry grow when a metric is added
+  atomic_init(&self->generation, 1);
 
   const char **k = (const char **)prom_malloc(sizeof(const char *) * label_key_count);
 
@@ -79,6 +85,11 @@ prom_metric_t *prom_metric_new(prom_metric_type_t metric_type, const char *name,
     prom_metric_destroy(self);
     return NULL;
   }
+  self->template = prom_metric_template_new();
+  if (self->template == NULL) {
+    prom_metric_destroy(self);
+    return NULL;
+  }
   self->rwlock = (pthread_rwlock_t *)prom_malloc(sizeof(pthread_rwlock_t));
   r = pthread_rwlock_init(self->rwlock, NULL);
   if (r) {
@@ -109,6 +120,10 @@ int prom_metric_destroy(prom_metric_t *self) {
   self->formatter = NULL;
   if (r) ret = r;
 
+  r = prom_metric_template_destroy(self->template);
+  self->template = NULL;
+  if (r) ret = r;
+
   r = pthread_rwlock_destroy(self->rwlock);
   if (r) {
     PROM_LOG(PROM_PTHREAD_RWLOCK_DESTROY_ERROR);
@@ -147,6 +162,29 @@ void prom_metric_free_generic(void *item) {
 prom_metric_sample_t *prom_metric_sample_from_labels(prom_metric_t *self, const char **label_values) {
   PROM_ASSERT(self != NULL);
   int r = 0;
+
+  // Fast path: an existing sample is found under the read lock, with the l_value formatted on the stack, so updaters
+  // and scrapes of the same metric do not exclude each other
+  char l_value_buffer[PROM_METRIC_L_VALUE_STACK_SIZE];
+  size_t l_value_len =
+      prom_metric_formatter_l_value_to_buffer(l_value_buffer, sizeof(l_value_buffer), self->name, NULL,
+                                              self->label_key_count, self->label_keys, label_values);
+  if (l_value_len < sizeof(l_value_buffer)) {
+    r = pthread_rwlock_rdlock(self->rwlock);
+    if (r) {
+      PROM_LOG(PROM_PTHREAD_RWLOCK_LOCK_ERROR);
+      return NULL;
+    }
+    prom_metric_sample_t *sample = (prom_metric_sample_t *)prom_map_get(self->samples, l_value_buffer);
+    r = pthread_rwlock_unlock(self->rwlock);
+    if (r) {
+      PROM_LOG(PROM_PTHREAD_RWLOCK_UNLOCK_ERROR);
+      return NULL;
+    }
+    if (sample != NULL) return sample;
+  }
+
+  // Slow path: create the sample, or look up an l_value too long for the stack, under the write lock
   r = pthread_rwlock_wrlock(self->rwlock);
   if (r) {
     PROM_LOG(PROM_PTHREAD_RWLOCK_LOCK_ERROR);
@@ -154,6 +192,7 @@ prom_metric_sample_t *prom_metric_sample_from_labels(prom_metric_t *self, const
   }
 
 #define PROM_METRIC_SAMPLE_FROM_LABELS_HANDLE_UNLOCK() \
+  prom_metric_formatter_reset(self->formatter);        \
   r = pthread_rwlock_unlock(self->rwlock);             \
   if (r) PROM_LOG(PROM_PTHREAD_RWLOCK_UNLOCK_ERROR);   \
   return NULL;
@@ -165,31 +204,86 @@ prom_metric_sample_t *prom_metric_sample_from_labels(prom_metric_t *self, const
     PROM_METRIC_SAMPLE_FROM_LABELS_HANDLE_UNLOCK();
   }
 
-  // This must be freed before returning
-  const char *l_value = prom_metric_formatter_dump(self->formatter);
-  if (l_value == NULL) {
-    PROM_METRIC_SAMPLE_FROM_LABELS_HANDLE_UNLOCK();
-  }
+  // Look the l_value up in place, it is only copied when a new sample has to be created
+  const char *l_value = prom_metric_formatter_str(self->formatter);
 
   // Get sample
   prom_metric_sample_t *sample = (prom_metric_sample_t *)prom_map_get(self->samples, l_value);
   if (sample == NULL) {
-    sample = prom_metric_sample_new(self->type, l_value, 0.0);
+    sample = prom_metric_sample_new(self->type, l_value, 0.0, &self->generation);
+    if (sample == NULL) {
+      PROM_METRIC_SAMPLE_FROM_LABELS_HANDLE_UNLOCK();
+    }
     r = prom_map_set(self->samples, l_value, sample);
     if (r) {
       PROM_METRIC_SAMPLE_FROM_LABELS_HANDLE_UNLOCK();
     }
+    prom_metric_template_invalidate(self->template);
+    prom_metric_generation_bump(&self->generation);
   }
+  prom_metric_formatter_reset(self->formatter);
   pthread_rwlock_unlock(self->rwlock);
-  prom_free((void *)l_value);
   return sample;
 }
 
+int prom_metric_remove_sample(prom_metric_t *self, const char **label_values) {
+  PROM_ASSERT(self != NULL);
+  int r = 0;
+  int ret = 0;
+  r = pthread_rwlock_wrlock(self->rwlock);
+  if (r) {
+    PROM_LOG(PROM_PTHREAD_RWLOCK_LOCK_ERROR);
+    return r;
+  }
+
+  r = prom_metric_formatter_load_l_value(self->formatter, self->name, NULL, self->label_key_count, self->label_keys,
+                                         label_values);
+  if (r) {
+    ret = r;
+  } else {
+    // The map destroys the sample through its free_value_fn, the template must not point to it anymore
+    prom_metric_template_invalidate(self->template);
+    ret = prom_map_delete(self->samples, prom_metric_formatter_str(self->formatter));
+    if (!ret) prom_metric_generation_bump(&self->generation);
+  }
+  prom_metric_formatter_reset(self->formatter);
+
+  r = pthread_rwlock_unlock(self->rwlock);
+  if (r) {
+    PROM_LOG(PROM_PTHREAD_RWLOCK_UNLOCK_ERROR);
+    ret = r;
+  }
+  return ret;
+}
+
 prom_metric_sample_histogram_t *prom_metric_sample_histogram_from_labels(prom_metric_t *self,
                                                                          const char **label_values) {
   PROM_ASSERT(self != NULL);
 
   int r = 0;
+
+  // Fast path: an existing sample is found under the read lock, as in prom_metric_sample_from_labels
+  char l_value_buffer[PROM_METRIC_L_VALUE_STACK_SIZE];
+  size_t l_value_len =
+      prom_metric_formatter_l_value_to_buffer(l_value_buffer, sizeof(l_value_buffer), self->name, NULL,
+                                              self->label_key_count, self->label_keys, label_values);
+  if (l_value_len < sizeof(l_value_buffer)) {
+    r = pthread_rwlock_rdlock(self->rwlock);
+    if (r) {
+      PROM_LOG(PROM_PTHREAD_RWLOCK_LOCK_ERROR);
+      return NULL;
+    }
+    prom_metric_sample_histogram_t *sample =
+        (prom_metric_sample_histogram_t *)prom_map_get(self->samples, l_value_buffer);
+    r = pthread_rwlock_unlock(self->rwlock);
+    if (r) {
+      PROM_LOG(PROM_PTHREAD_RWLOCK_UNLOCK_ERROR);
+      return NULL;
+    }
+    if (sample != NULL) return sample;
+  }
+
+  // Slow path: create the sample under the write lock
   r = pthread_rwlock_wrlock(self->rwlock);
   if (r) {
     PROM_LOG(PROM_PTHREAD_RWLOCK_LOCK_ERROR);
@@ -197,11 +291,12 @@ prom_metric_sample_histogram_t *prom_metric_sample_histogram_from_labels(prom_me
   }
 
 #define PROM_METRIC_SAMPLE_HISTOGRAM_FROM_LABELS_HANDLE_UNLOCK() \
+  prom_metric_formatter_reset(self->formatter);                  \
   r = pthread_rwlock_unlock(self->rwlock);                       \
   if (r) {                                                       \
     PROM_LOG(PROM_PTHREAD_RWLOCK_UNLOCK_ERROR);                  \
-    return NULL;                                                 \
-  }
+  }                                                              \
+  return NULL;
 
   // Load the l_value
   r = prom_metric_formatter_load_l_value(self->formatter, self->name, NULL, self->label_key_count, self->label_keys,
@@ -210,29 +305,26 @@ prom_metric_sample_histogram_t *prom_metric_sample_histogram_from_labels(prom_me
     PROM_METRIC_SAMPLE_HISTOGRAM_FROM_LABELS_HANDLE_UNLOCK();
   }
 
-  // This must be freed before returning
-  const char *l_value = prom_metric_formatter_dump(self->formatter);
-  if (l_value == NULL) {
-    PROM_METRIC_SAMPLE_HISTOGRAM_FROM_LABELS_HANDLE_UNLOCK();
-  }
+  // Look the l_value up in place, it is only copied when a new sample has to be created
+  const char *l_value = prom_metric_formatter_str(self->formatter);
 
   // Get sample
   prom_metric_sample_histogram_t *sample = (prom_metric_sample_histogram_t *)prom_map_get(self->samples, l_value);
   if (sample == NULL) {
     sample = prom_metric_sample_histogram_new(self->name, self->buckets, self->label_key_count, self->label_keys,
-                                              label_values);
+                                              label_values, &self->generation);
     if (sample == NULL) {
-      prom_free((void *)l_value);
       PROM_METRIC_SAMPLE_HISTOGRAM_FROM_LABELS_HANDLE_UNLOCK();
     }
     r = prom_map_set(self->samples, l_value, sample);
     if (r) {
-      prom_free((void *)l_value);
-      pthread_rwlock_unlock(self->rwlock);
+      prom_metric_sample_histogram_destroy(sample);
       PROM_METRIC_SAMPLE_HISTOGRAM_FROM_LABELS_HANDLE_UNLOCK();
     }
+    prom_metric_template_invalidate(self->template);
+    prom_metric_generation_bump(&self->generation);
   }
+  prom_metric_formatter_reset(self->formatter);
   pthread_rwlock_unlock(self->rwlock);
-  prom_free((void *)l_value);
   return sample;
 }
@@ -21,13 +21,16 @@
 
 // Private
 #include "prom_assert.h"
+#include "prom_collector_i.h"
 #include "prom_collector_t.h"
+#include "prom_errors.h"
 #include "prom_linked_list_t.h"
+#include "prom_log.h"
 #include "prom_map_i.h"
 #include "prom_metric_formatter_i.h"
-#include "prom_metric_sample_histogram_t.h"
 #include "prom_metric_sample_t.h"
 #include "prom_metric_t.h"
+#include "prom_metric_template_i.h"
 #include "prom_string_builder_i.h"
 
 prom_metric_formatter_t *prom_metric_formatter_new() {
@@ -158,31 +161,83 @@ int prom_metric_formatter_load_l_value(prom_metric_formatter_t *self, const char
   return 0;
 }
 
-int prom_metric_formatter_load_sample(prom_metric_formatter_t *self, prom_metric_sample_t *sample) {
-  PROM_ASSERT(self != NULL);
-  if (self == NULL) return 1;
+/**
+ * @brief API PRIVATE Appends a string to buf without overflowing it and returns the new length, which keeps counting
+ * past size so that the caller learns the length it needed.
+ */
+static size_t prom_metric_formatter_append(char *buf, size_t size, size_t len, const char *str) {
+  for (; *str != '\0'; str++, len++) {
+    if (len + 1 < size) buf[len] = *str;
+  }
+  return len;
+}
+
+size_t prom_metric_formatter_l_value_to_buffer(char *buf, size_t size, const char *name, const char *suffix,
+                                               size_t label_count, const char **label_keys,
+                                               const char **label_values) {
+  size_t len = 0;
+  len = prom_metric_formatter_append(buf, size, len, name);
+  if (suffix != NULL) {
+    len = prom_metric_formatter_append(buf, size, len, "_");
+    len = prom_metric_formatter_append(buf, size, len, suffix);
+  }
+  for (size_t i = 0; i < label_count; i++) {
+    len = prom_metric_formatter_append(buf, size, len, i == 0 ? "{" : ",");
+    len = prom_metric_formatter_append(buf, size, len, label_keys[i]);
+    len = prom_metric_formatter_append(buf, size, len, "=\"");
+    len = prom_metric_formatter_append(buf, size, len, label_values[i]);
+    len = prom_metric_formatter_append(buf, size, len, "\"");
+  }
+  if (label_count > 0) len = prom_metric_formatter_append(buf, size, len, "}");
+  if (size > 0) buf[len < size ? len : size - 1] = '\0';
+  return len;
+}
 
+/**
+ * @brief Loads one sample line from its l_value and r_value
+ */
+static int prom_metric_formatter_load_line(prom_metric_formatter_t *self, const char *l_value, double r_value) {
   int r = 0;
 
-  r = prom_string_builder_add_str(self->string_builder, sample->l_value);
+  r = prom_string_builder_add_str(self->string_builder, l_value);
   if (r) return r;
 
   r = prom_string_builder_add_char(self->string_builder, ' ');
   if (r) return r;
 
-  char buffer[50];
-  sprintf(buffer, "%.17g", sample->r_value);
-  r = prom_string_builder_add_str(self->string_builder, buffer);
+  r = prom_string_builder_add_double(self->string_builder, r_value);
   if (r) return r;
 
   return prom_string_builder_add_char(self->string_builder, '\n');
 }
 
+int prom_metric_formatter_load_sample(prom_metric_formatter_t *self, prom_metric_sample_t *sample) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+
+  return prom_metric_formatter_load_line(self, sample->l_value, sample->r_value);
+}
+
 int prom_metric_formatter_clear(prom_metric_formatter_t *self) {
   PROM_ASSERT(self != NULL);
   return prom_string_builder_clear(self->string_builder);
 }
 
+int prom_metric_formatter_reset(prom_metric_formatter_t *self) {
+  PROM_ASSERT(self != NULL);
+  return prom_string_builder_reset(self->string_builder);
+}
+
+const char *prom_metric_formatter_str(prom_metric_formatter_t *self) {
+  PROM_ASSERT(self != NULL);
+  return prom_string_builder_str(self->string_builder);
+}
+
+size_t prom_metric_formatter_len(prom_metric_formatter_t *self) {
+  PROM_ASSERT(self != NULL);
+  return prom_string_builder_len(self->string_builder);
+}
+
 char *prom_metric_formatter_dump(prom_metric_formatter_t *self) {
   PROM_ASSERT(self != NULL);
   int r = 0;
@@ -203,37 +258,47 @@ int prom_metric_formatter_load_metric(prom_metric_formatter_t *self, prom_metric
 
   int r = 0;
 
-  r = prom_metric_formatter_load_help(self, metric->name, metric->help);
-  if (r) return r;
-
-  r = prom_metric_formatter_load_type(self, metric->name, metric->type);
-  if (r) return r;
+  // Hold the metric read lock so that samples cannot be removed while they are being formatted
+  r = pthread_rwlock_rdlock(metric->rwlock);
+  if (r) {
+    PROM_LOG(PROM_PTHREAD_RWLOCK_LOCK_ERROR);
+    return r;
+  }
 
-  for (prom_linked_list_node_t *current_node = metric->samples->keys->head; current_node != NULL;
-       current_node = current_node->next) {
-    const char *key = (const char *)current_node->item;
-    if (metric->type == PROM_HISTOGRAM) {
-      prom_metric_sample_histogram_t *hist_sample =
-          (prom_metric_sample_histogram_t *)prom_map_get(metric->samples, key);
-
-      if (hist_sample == NULL) return 1;
-
-      for (prom_linked_list_node_t *current_hist_node = hist_sample->l_value_list->head; current_hist_node != NULL;
-           current_hist_node = current_hist_node->next) {
-        const char *hist_key = (const char *)current_hist_node->item;
-        prom_metric_sample_t *sample = (prom_metric_sample_t *)prom_map_get(hist_sample->samples, hist_key);
-        if (sample == NULL) return 1;
-        r = prom_metric_formatter_load_sample(self, sample);
-        if (r) return r;
-      }
-    } else {
-      prom_metric_sample_t *sample = (prom_metric_sample_t *)prom_map_get(metric->samples, key);
-      if (sample == NULL) return 1;
-      r = prom_metric_formatter_load_sample(self, sample);
-      if (r) return r;
+  // A stale template is rebuilt under the write lock, then the read lock is taken again, which a sample added in
+  // between may make stale once more
+  while (!metric->template->valid) {
+    r = pthread_rwlock_unlock(metric->rwlock);
+    if (r) {
+      PROM_LOG(PROM_PTHREAD_RWLOCK_UNLOCK_ERROR);
+      return r;
+    }
+    r = pthread_rwlock_wrlock(metric->rwlock);
+    if (r) {
+      PROM_LOG(PROM_PTHREAD_RWLOCK_LOCK_ERROR);
+      return r;
+    }
+    int build_r = metric->template->valid ? 0 : prom_metric_template_build(metric->template, metric);
+    r = pthread_rwlock_unlock(metric->rwlock);
+    if (r) {
+      PROM_LOG(PROM_PTHREAD_RWLOCK_UNLOCK_ERROR);
+      return r;
+    }
+    if (build_r) return build_r;
+    r = pthread_rwlock_rdlock(metric->rwlock);
+    if (r) {
+      PROM_LOG(PROM_PTHREAD_RWLOCK_LOCK_ERROR);
+      return r;
     }
   }
-  return prom_string_builder_add_char(self->string_builder, '\n');
+
+  r = prom_metric_template_render(metric->template, metric, self->string_builder);
+  int unlock_r = pthread_rwlock_unlock(metric->rwlock);
+  if (unlock_r) {
+    PROM_LOG(PROM_PTHREAD_RWLOCK_UNLOCK_ERROR);
+    return unlock_r;
+  }
+  return r;
 }
 
 int prom_metric_formatter_load_metrics(prom_metric_formatter_t *self, prom_map_t *collectors) {
@@ -245,7 +310,7 @@ int prom_metric_formatter_load_metrics(prom_metric_formatter_t *self, prom_map_t
     prom_collector_t *collector = (prom_collector_t *)prom_map_get(collectors, collector_name);
     if (collector == NULL) return 1;
 
-    prom_map_t *metrics = collector->collect_fn(collector);
+    prom_map_t *metrics = prom_collector_collect(collector);
     if (metrics == NULL) return 1;
 
     for (prom_linked_list_node_t *current_node = metrics->keys->head; current_node != NULL;
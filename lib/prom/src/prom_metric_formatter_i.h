@@ -56,6 +56,15 @@ int prom_metric_formatter_load_type(prom_metric_formatter_t *self, const char *n
 int prom_metric_formatter_load_l_value(prom_metric_formatter_t *metric_formatter, const char *name, const char *suffix,
                                        size_t label_count, const char **label_keys, const char **label_values);
 
+/**
+ * @brief API PRIVATE Writes the same l_value as prom_metric_formatter_load_l_value into a caller-owned buffer, so that
+ * concurrent callers do not share a formatter. The result is truncated to size - 1 bytes and NUL-terminated.
+ * @return The length of the full l_value; it was truncated if this is not less than size.
+ */
+size_t prom_metric_formatter_l_value_to_buffer(char *buf, size_t size, const char *name, const char *suffix,
+                                               size_t label_count, const char **label_keys,
+                                               const char **label_values);
+
 /**
  * @brief API PRIVATE Loads the formatter with a metric sample
  */
@@ -76,6 +85,21 @@ int prom_metric_formatter_load_metrics(prom_metric_formatter_t *self, prom_map_t
  */
 int prom_metric_formatter_clear(prom_metric_formatter_t *self);
 
+/**
+ * @brief API PRIVATE Empty the underlying string_builder while keeping its buffer
+ */
+int prom_metric_formatter_reset(prom_metric_formatter_t *self);
+
+/**
+ * @brief API PRIVATE Returns the string being built, without copying it. Valid until the formatter is loaded or reset.
+ */
+const char *prom_metric_formatter_str(prom_metric_formatter_t *self);
+
+/**
+ * @brief API PRIVATE Returns the length of the string being built
+ */
+size_t prom_metric_formatter_len(prom_metric_formatter_t *self);
+
 /**
  * @brief API PRIVATE Returns the string built by prom_metric_formatter
  */
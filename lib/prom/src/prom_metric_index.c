@@ -0,0 +1,109 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+// Public
+#include "prom_alloc.h"
+
+// Private
+#include "prom_assert.h"
+#include "prom_metric_index_i.h"
+#include "prom_metric_index_t.h"
+#include "prom_metric_t.h"
+
+#define PROM_METRIC_INDEX_INITIAL_CAPACITY 32
+
+prom_metric_index_t *prom_metric_index_new(void) {
+  prom_metric_index_t *self = (prom_metric_index_t *)prom_malloc(sizeof(prom_metric_index_t));
+  if (self == NULL) return NULL;
+  self->entries = NULL;
+  self->size = 0;
+  self->capacity = 0;
+  return self;
+}
+
+int prom_metric_index_destroy(prom_metric_index_t *self) {
+  if (self == NULL) return 0;
+  prom_free(self->entries);
+  self->entries = NULL;
+  prom_free(self);
+  return 0;
+}
+
+/**
+ * @brief Compares the name of an entry with a key, or only with its first key_len characters when matching a prefix.
+ * Names sorted in ascending order compare in ascending order too, so every comparison below is monotonic.
+ */
+static int prom_metric_index_compare(const char *name, const char *key, bool prefix, size_t key_len) {
+  return prefix ? strncmp(name, key, key_len) : strcmp(name, key);
+}
+
+/**
+ * @brief Returns the position of the first entry comparing greater than or equal to the key or, if past_equal is true,
+ * greater than it
+ */
+static size_t prom_metric_index_bound(prom_metric_index_t *self, const char *key, bool prefix, bool past_equal) {
+  size_t key_len = prefix ? strlen(key) : 0;
+  size_t low = 0, high = self->size;
+  while (low < high) {
+    size_t middle = low + (high - low) / 2;
+    int c = prom_metric_index_compare(self->entries[middle].name, key, prefix, key_len);
+    if (c < 0 || (past_equal && c == 0)) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  return low;
+}
+
+int prom_metric_index_add(prom_metric_index_t *self, prom_collector_t *collector, prom_metric_t *metric) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL || metric == NULL) return 1;
+
+  if (self->size == self->capacity) {
+    size_t capacity = self->capacity == 0 ? PROM_METRIC_INDEX_INITIAL_CAPACITY : self->capacity * 2;
+    prom_metric_index_entry_t *entries =
+        (prom_metric_index_entry_t *)prom_realloc(self->entries, capacity * sizeof(prom_metric_index_entry_t));
+    if (entries == NULL) return 1;
+    self->entries = entries;
+    self->capacity = capacity;
+  }
+
+  // After the entries with the same name, so that they stay in registration order
+  size_t position = prom_metric_index_bound(self, metric->name, false, true);
+  memmove(&self->entries[position + 1], &self->entries[position],
+          (self->size - position) * sizeof(prom_metric_index_entry_t));
+  self->entries[position] = (prom_metric_index_entry_t){metric->name, metric, collector};
+  self->size++;
+  return 0;
+}
+
+void prom_metric_index_remove_collector(prom_metric_index_t *self, prom_collector_t *collector) {
+  PROM_ASSERT(self != NULL);
+  size_t kept = 0;
+  for (size_t i = 0; i < self->size; i++) {
+    if (self->entries[i].collector != collector) self->entries[kept++] = self->entries[i];
+  }
+  self->size = kept;
+}
+
+void prom_metric_index_range(prom_metric_index_t *self, const char *key, bool prefix, size_t *begin, size_t *end) {
+  PROM_ASSERT(self != NULL);
+  *begin = prom_metric_index_bound(self, key, prefix, false);
+  *end = prom_metric_index_bound(self, key, prefix, true);
+}
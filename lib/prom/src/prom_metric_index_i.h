@@ -0,0 +1,52 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PROM_METRIC_INDEX_I_H
+#define PROM_METRIC_INDEX_I_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Private
+#include "prom_metric_index_t.h"
+
+/**
+ * @brief API PRIVATE Returns an empty prom_metric_index_t
+ */
+prom_metric_index_t *prom_metric_index_new(void);
+
+/**
+ * @brief API PRIVATE Destroys a prom_metric_index_t. The metrics and collectors it refers to are not destroyed.
+ */
+int prom_metric_index_destroy(prom_metric_index_t *self);
+
+/**
+ * @brief API PRIVATE Inserts a metric of a collector at its place in the index
+ */
+int prom_metric_index_add(prom_metric_index_t *self, prom_collector_t *collector, prom_metric_t *metric);
+
+/**
+ * @brief API PRIVATE Removes the metrics of a collector from the index, before the collector is destroyed
+ */
+void prom_metric_index_remove_collector(prom_metric_index_t *self, prom_collector_t *collector);
+
+/**
+ * @brief API PRIVATE Sets [begin, end) to the range of entries whose name is key or, if prefix is true, starts with
+ * key. The range is empty if no name matches.
+ */
+void prom_metric_index_range(prom_metric_index_t *self, const char *key, bool prefix, size_t *begin, size_t *end);
+
+#endif  // PROM_METRIC_INDEX_I_H
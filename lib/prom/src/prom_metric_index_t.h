@@ -0,0 +1,45 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PROM_METRIC_INDEX_T_H
+#define PROM_METRIC_INDEX_T_H
+
+#include <stddef.h>
+
+// Public
+#include "prom_collector.h"
+#include "prom_metric.h"
+
+/**
+ * @brief API PRIVATE A metric of the index and the collector it was added to
+ */
+typedef struct prom_metric_index_entry {
+  const char *name;            /**< name of the metric, owned by the metric */
+  prom_metric_t *metric;       /**< the metric */
+  prom_collector_t *collector; /**< collector the metric was added to */
+} prom_metric_index_entry_t;
+
+/**
+ * @brief API PRIVATE The metrics of a registry sorted by name, so that the metrics with a given name or prefix are a
+ * contiguous range found by binary search. Entries are inserted in place when a metric or a collector is registered.
+ */
+typedef struct prom_metric_index {
+  prom_metric_index_entry_t *entries; /**< entries sorted by name, in registration order within a name */
+  size_t size;                        /**< number of entries */
+  size_t capacity;                    /**< number of entries allocated */
+} prom_metric_index_t;
+
+#endif  // PROM_METRIC_INDEX_T_H
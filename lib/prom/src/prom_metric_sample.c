@@ -15,6 +15,7 @@
  */
 
 #include <stdatomic.h>
+#include <string.h>
 
 // Public
 #include "prom_alloc.h"
@@ -26,11 +27,13 @@
 #include "prom_metric_sample_i.h"
 #include "prom_metric_sample_t.h"
 
-prom_metric_sample_t *prom_metric_sample_new(prom_metric_type_t type, const char *l_value, double r_value) {
+prom_metric_sample_t *prom_metric_sample_new(prom_metric_type_t type, const char *l_value, double r_value,
+                                             _Atomic uint64_t *generation) {
   prom_metric_sample_t *self = (prom_metric_sample_t *)prom_malloc(sizeof(prom_metric_sample_t));
   self->type = type;
   self->l_value = prom_strdup(l_value);
   self->r_value = ATOMIC_VAR_INIT(r_value);
+  self->generation = generation;
   return self;
 }
 
@@ -67,6 +70,7 @@ int prom_metric_sample_add(prom_metric_sample_t *self, double r_value) {
   for (;;) {
     _Atomic double new = ATOMIC_VAR_INIT(old + r_value);
     if (atomic_compare_exchange_weak(&self->r_value, &old, new)) {
+      if (r_value != 0) prom_metric_generation_bump(self->generation);
       return 0;
     }
   }
@@ -82,6 +86,7 @@ int prom_metric_sample_sub(prom_metric_sample_t *self, double r_value) {
   for (;;) {
     _Atomic double new = ATOMIC_VAR_INIT(old - r_value);
     if (atomic_compare_exchange_weak(&self->r_value, &old, new)) {
+      if (r_value != 0) prom_metric_generation_bump(self->generation);
       return 0;
     }
   }
@@ -92,6 +97,8 @@ int prom_metric_sample_set(prom_metric_sample_t *self, double r_value) {
     PROM_LOG(PROM_METRIC_INCORRECT_TYPE);
     return 1;
   }
-  atomic_store(&self->r_value, r_value);
+  // Setting the same value does not change the exposition, compared bit for bit as -0 is formatted differently than 0
+  double old = atomic_exchange(&self->r_value, r_value);
+  if (memcmp(&old, &r_value, sizeof(double)) != 0) prom_metric_generation_bump(self->generation);
   return 0;
 }
@@ -15,7 +15,11 @@
  */
 
 #include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 
 // Public
 #include "prom_alloc.h"
@@ -24,12 +28,9 @@
 // Private
 #include "prom_assert.h"
 #include "prom_errors.h"
-#include "prom_linked_list_i.h"
 #include "prom_log.h"
-#include "prom_map_i.h"
 #include "prom_metric_formatter_i.h"
 #include "prom_metric_sample_histogram_i.h"
-#include "prom_metric_sample_i.h"
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Static Declarations
@@ -44,23 +45,12 @@ static const char *prom_metric_sample_histogram_l_value_for_inf(prom_metric_samp
                                                                 size_t label_count, const char **label_keys,
                                                                 const char **label_values);
 
-static void prom_metric_sample_histogram_free_str_generic(void *gen);
+static const char *prom_metric_sample_histogram_l_value_for_suffix(prom_metric_sample_histogram_t *self,
+                                                                   const char *name, const char *suffix,
+                                                                   size_t label_count, const char **label_keys,
+                                                                   const char **label_values);
 
-static int prom_metric_sample_histogram_init_bucket_samples(prom_metric_sample_histogram_t *self, const char *name,
-                                                            size_t label_count, const char **label_keys,
-                                                            const char **label_values);
-
-static int prom_metric_sample_histogram_init_inf(prom_metric_sample_histogram_t *self, const char *name,
-                                                 size_t label_count, const char **label_keys,
-                                                 const char **label_values);
-
-static int prom_metric_sample_histogram_init_count(prom_metric_sample_histogram_t *self, const char *name,
-                                                   size_t label_count, const char **label_keys,
-                                                   const char **label_values);
-
-static int prom_metric_sample_histogram_init_summary(prom_metric_sample_histogram_t *self, const char *name,
-                                                     size_t label_count, const char **label_keys,
-                                                     const char **label_values);
+static void prom_metric_sample_histogram_atomic_add(_Atomic double *target, double value);
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // End static declarations
@@ -68,206 +58,70 @@ static int prom_metric_sample_histogram_init_summary(prom_metric_sample_histogra
 
 prom_metric_sample_histogram_t *prom_metric_sample_histogram_new(const char *name, prom_histogram_buckets_t *buckets,
                                                                  size_t label_count, const char **label_keys,
-                                                                 const char **label_values) {
-  // Capture return codes
-  int r = 0;
-
+                                                                 const char **label_values,
+                                                                 _Atomic uint64_t *generation) {
   // Allocate and set self
   prom_metric_sample_histogram_t *self =
       (prom_metric_sample_histogram_t *)prom_malloc(sizeof(prom_metric_sample_histogram_t));
+  if (self == NULL) return NULL;
 
-  // Allocate and set the l_value_list
-  self->l_value_list = prom_linked_list_new();
-  if (self->l_value_list == NULL) {
-    prom_metric_sample_histogram_destroy(self);
-    return NULL;
+  self->buckets = buckets;
+  self->generation = generation;
+  self->bucket_count = (size_t)prom_histogram_buckets_count(buckets);
+  atomic_init(&self->count_and_hot, 0);
+
+  // Both shards share one allocation: one counter per upper bound plus the +Inf bucket, all starting at zero
+  _Atomic uint64_t *buckets_storage =
+      (_Atomic uint64_t *)prom_malloc(sizeof(_Atomic uint64_t) * 2 * (self->bucket_count + 1));
+  for (size_t i = 0; i < 2; i++) {
+    atomic_init(&self->shards[i].count, 0);
+    atomic_init(&self->shards[i].sum, 0.0);
+    self->shards[i].buckets = buckets_storage == NULL ? NULL : buckets_storage + i * (self->bucket_count + 1);
   }
-
-  // Allocate and set the metric formatter
+  // The l_values of the buckets, +Inf, count and sum, in exposition order
+  self->l_values = (const char **)prom_malloc(sizeof(char *) * PROM_METRIC_SAMPLE_HISTOGRAM_L_VALUE_COUNT(self));
   self->metric_formatter = prom_metric_formatter_new();
-  if (self->metric_formatter == NULL) {
-    prom_metric_sample_histogram_destroy(self);
-    return NULL;
-  }
-
-  // Store map of l_value/prom_metric_sample_t
-  self->samples = prom_map_new();
-  if (self->samples == NULL) {
-    prom_metric_sample_histogram_destroy(self);
-    return NULL;
-  }
-
-  // Set the free value function on the samples map
-  r = prom_map_set_free_value_fn(self->samples, &prom_metric_sample_free_generic);
-  if (r) {
-    prom_metric_sample_histogram_destroy(self);
-    return NULL;
+  self->snapshot_lock = (pthread_mutex_t *)prom_malloc(sizeof(pthread_mutex_t));
+  if (self->snapshot_lock != NULL && pthread_mutex_init(self->snapshot_lock, NULL)) {
+    PROM_LOG(PROM_PTHREAD_MUTEX_INIT_ERROR);
+    prom_free(self->snapshot_lock);
+    self->snapshot_lock = NULL;
   }
-
-  // Set a map of bucket: l_value
-  self->l_values = prom_map_new();  // Store map of bucket/l_value
-  if (self->l_values == NULL) {
+  if (buckets_storage == NULL || self->l_values == NULL || self->metric_formatter == NULL ||
+      self->snapshot_lock == NULL) {
+    prom_free(self->l_values);
+    self->l_values = NULL;
     prom_metric_sample_histogram_destroy(self);
     return NULL;
   }
-
-  // Set the free value function for thhe l_values map
-  r = prom_map_set_free_value_fn(self->l_values, prom_metric_sample_histogram_free_str_generic);
-  if (r) {
-    prom_metric_sample_histogram_destroy(self);
-    return NULL;
+  for (size_t i = 0; i < 2 * (self->bucket_count + 1); i++) {
+    atomic_init(&buckets_storage[i], 0);
   }
-
-  self->buckets = buckets;
-
-  // Allocate and initialize the lock
-  self->rwlock = (pthread_rwlock_t *)prom_malloc(sizeof(pthread_rwlock_t));
-  r = pthread_rwlock_init(self->rwlock, NULL);
-  if (r) {
-    prom_metric_sample_histogram_destroy(self);
-    return NULL;
+  for (size_t i = 0; i < PROM_METRIC_SAMPLE_HISTOGRAM_L_VALUE_COUNT(self); i++) {
+    self->l_values[i] = NULL;
   }
 
-  // Allocate and initialize bucket metric samples
-  r = prom_metric_sample_histogram_init_bucket_samples(self, name, label_count, label_keys, label_values);
-  if (r) {
-    prom_metric_sample_histogram_destroy(self);
-    return NULL;
+  // For each bucket, the l_value contains the metric name, user labels, and finally, the le label and bucket value
+  for (size_t i = 0; i < self->bucket_count; i++) {
+    self->l_values[i] = prom_metric_sample_histogram_l_value_for_bucket(self, name, label_count, label_keys,
+                                                                        label_values, self->buckets->upper_bounds[i]);
   }
-
-  // Allocate and initialize the +Inf metric sample
-  r = prom_metric_sample_histogram_init_inf(self, name, label_count, label_keys, label_values);
-  if (r) {
-    prom_metric_sample_histogram_destroy(self);
-    return NULL;
-  }
-
-  // Allocate and initialize the count metric sample
-  r = prom_metric_sample_histogram_init_count(self, name, label_count, label_keys, label_values);
-  if (r) {
-    prom_metric_sample_histogram_destroy(self);
-    return NULL;
-  }
-
-  // Add summary sample
-  r = prom_metric_sample_histogram_init_summary(self, name, label_count, label_keys, label_values);
-  if (r) {
-    prom_metric_sample_histogram_destroy(self);
-    return NULL;
-  }
-
-  // The value of nodes in this map will be simple prom_metric_sample pointers.
-  r = prom_map_set_free_value_fn(self->samples, &prom_metric_sample_free_generic);
-  if (r) {
-    prom_metric_sample_histogram_destroy(self);
-    return NULL;
+  self->l_values[PROM_METRIC_SAMPLE_HISTOGRAM_INF_INDEX(self)] =
+      prom_metric_sample_histogram_l_value_for_inf(self, name, label_count, label_keys, label_values);
+  self->l_values[PROM_METRIC_SAMPLE_HISTOGRAM_COUNT_INDEX(self)] =
+      prom_metric_sample_histogram_l_value_for_suffix(self, name, "count", label_count, label_keys, label_values);
+  self->l_values[PROM_METRIC_SAMPLE_HISTOGRAM_SUM_INDEX(self)] =
+      prom_metric_sample_histogram_l_value_for_suffix(self, name, "sum", label_count, label_keys, label_values);
+
+  for (size_t i = 0; i < PROM_METRIC_SAMPLE_HISTOGRAM_L_VALUE_COUNT(self); i++) {
+    if (self->l_values[i] == NULL) {
+      prom_metric_sample_histogram_destroy(self);
+      return NULL;
+    }
   }
   return self;
 }
 
-static int prom_metric_sample_histogram_init_bucket_samples(prom_metric_sample_histogram_t *self, const char *name,
-                                                            size_t label_count, const char **label_keys,
-                                                            const char **label_values) {
-  PROM_ASSERT(self);
-  int r = 0;
-  int bucket_count = prom_histogram_buckets_count(self->buckets);
-
-  // For each bucket, create an prom_metric_sample_t with an appropriate l_value and default value of 0.0. The
-  // l_value will contain the metric name, user labels, and finally, the le label and bucket value.
-  for (int i = 0; i < bucket_count; i++) {
-    const char *l_value = prom_metric_sample_histogram_l_value_for_bucket(self, name, label_count, label_keys,
-                                                                          label_values, self->buckets->upper_bounds[i]);
-    if (l_value == NULL) return 1;
-
-    r = prom_linked_list_append(self->l_value_list, prom_strdup(l_value));
-    if (r) return r;
-
-    const char *bucket_key = prom_metric_sample_histogram_bucket_to_str(self->buckets->upper_bounds[i]);
-    if (bucket_key == NULL) return 1;
-
-    r = prom_map_set(self->l_values, bucket_key, (char *)l_value);
-    if (r) return r;
-
-    prom_metric_sample_t *sample = prom_metric_sample_new(PROM_HISTOGRAM, l_value, 0.0);
-    if (sample == NULL) return 1;
-
-    r = prom_map_set(self->samples, l_value, sample);
-    if (r) return r;
-
-    prom_free((void *)bucket_key);
-  }
-  return 0;
-}
-
-static int prom_metric_sample_histogram_init_inf(prom_metric_sample_histogram_t *self, const char *name,
-                                                 size_t label_count, const char **label_keys,
-                                                 const char **label_values) {
-  PROM_ASSERT(self != NULL);
-  int r = 0;
-  const char *inf_l_value =
-      prom_metric_sample_histogram_l_value_for_inf(self, name, label_count, label_keys, label_values);
-  if (inf_l_value == NULL) return 1;
-
-  r = prom_linked_list_append(self->l_value_list, prom_strdup(inf_l_value));
-  if (r) return r;
-
-  r = prom_map_set(self->l_values, "+Inf", (char *)inf_l_value);
-  if (r) return r;
-
-  prom_metric_sample_t *inf_sample = prom_metric_sample_new(PROM_HISTOGRAM, (char *)inf_l_value, 0.0);
-  if (inf_sample == NULL) return 1;
-
-  return prom_map_set(self->samples, inf_l_value, inf_sample);
-}
-
-static int prom_metric_sample_histogram_init_count(prom_metric_sample_histogram_t *self, const char *name,
-                                                   size_t label_count, const char **label_keys,
-                                                   const char **label_values) {
-  PROM_ASSERT(self != NULL);
-  int r = 0;
-
-  r = prom_metric_formatter_load_l_value(self->metric_formatter, name, "count", label_count, label_keys, label_values);
-  if (r) return r;
-
-  const char *count_l_value = prom_metric_formatter_dump(self->metric_formatter);
-  if (count_l_value == NULL) return 1;
-
-  r = prom_linked_list_append(self->l_value_list, prom_strdup(count_l_value));
-  if (r) return r;
-
-  r = prom_map_set(self->l_values, "count", (char *)count_l_value);
-  if (r) return r;
-
-  prom_metric_sample_t *count_sample = prom_metric_sample_new(PROM_HISTOGRAM, count_l_value, 0.0);
-  if (count_sample == NULL) return 1;
-
-  return prom_map_set(self->samples, count_l_value, count_sample);
-}
-
-static int prom_metric_sample_histogram_init_summary(prom_metric_sample_histogram_t *self, const char *name,
-                                                     size_t label_count, const char **label_keys,
-                                                     const char **label_values) {
-  PROM_ASSERT(self != NULL);
-  int r = 0;
-
-  r = prom_metric_formatter_load_l_value(self->metric_formatter, name, "sum", label_count, label_keys, label_values);
-  if (r) return r;
-
-  const char *sum_l_value = prom_metric_formatter_dump(self->metric_formatter);
-  if (sum_l_value == NULL) return 1;
-
-  r = prom_linked_list_append(self->l_value_list, prom_strdup(sum_l_value));
-  if (r) return r;
-
-  r = prom_map_set(self->l_values, "sum", (char *)sum_l_value);
-  if (r) return r;
-
-  prom_metric_sample_t *sum_sample = prom_metric_sample_new(PROM_HISTOGRAM, sum_l_value, 0.0);
-  if (sum_sample == NULL) return 1;
-
-  return prom_map_set(self->samples, sum_l_value, sum_sample);
-}
-
 int prom_metric_sample_histogram_destroy(prom_metric_sample_histogram_t *self) {
   PROM_ASSERT(self != NULL);
   int r = 0;
@@ -275,27 +129,35 @@ int prom_metric_sample_histogram_destroy(prom_metric_sample_histogram_t *self) {
 
   if (self == NULL) return 0;
 
-  r = prom_linked_list_destroy(self->l_value_list);
-  self->l_value_list = NULL;
-  if (r) ret = r;
-
-  r = prom_map_destroy(self->samples);
-  if (r) ret = r;
-  self->samples = NULL;
-
-  r = prom_map_destroy(self->l_values);
-  if (r) ret = r;
+  if (self->l_values != NULL) {
+    for (size_t i = 0; i < PROM_METRIC_SAMPLE_HISTOGRAM_L_VALUE_COUNT(self); i++) {
+      prom_free((void *)self->l_values[i]);
+      self->l_values[i] = NULL;
+    }
+  }
+  prom_free(self->l_values);
   self->l_values = NULL;
 
-  r = prom_metric_formatter_destroy(self->metric_formatter);
-  if (r) ret = r;
-  self->metric_formatter = NULL;
+  // The first shard owns the buckets of both
+  prom_free((void *)self->shards[0].buckets);
+  self->shards[0].buckets = NULL;
+  self->shards[1].buckets = NULL;
 
-  r = pthread_rwlock_destroy(self->rwlock);
-  if (r) ret = r;
+  if (self->snapshot_lock != NULL) {
+    r = pthread_mutex_destroy(self->snapshot_lock);
+    if (r) {
+      PROM_LOG(PROM_PTHREAD_MUTEX_DESTROY_ERROR);
+      ret = r;
+    }
+    prom_free(self->snapshot_lock);
+  }
+  self->snapshot_lock = NULL;
 
-  prom_free(self->rwlock);
-  self->rwlock = NULL;
+  if (self->metric_formatter != NULL) {
+    r = prom_metric_formatter_destroy(self->metric_formatter);
+    if (r) ret = r;
+  }
+  self->metric_formatter = NULL;
 
   prom_free(self);
   self = NULL;
@@ -316,102 +178,89 @@ void prom_metric_sample_histogram_free_generic(void *gen) {
   prom_metric_sample_histogram_destroy(self);
 }
 
-int prom_metric_sample_histogram_observe(prom_metric_sample_histogram_t *self, double value) {
-  int r = 0;
-
-  r = pthread_rwlock_wrlock(self->rwlock);
-  if (r) {
-    printf("RETURN CODE: %d\n", r);
-    PROM_LOG(PROM_PTHREAD_RWLOCK_LOCK_ERROR);
-    return r;
+size_t prom_metric_sample_histogram_bucket_index(const double *upper_bounds, size_t bucket_count, double value) {
+  // Binary search of the first upper bound that is not below the value. NaN compares false and lands in +Inf.
+  size_t low = 0;
+  size_t high = bucket_count;
+  while (low < high) {
+    size_t mid = low + (high - low) / 2;
+    if (value <= upper_bounds[mid]) {
+      high = mid;
+    } else {
+      low = mid + 1;
+    }
   }
+  return low;
+}
 
-#define PROM_METRIC_SAMPLE_HISTOGRAM_OBSERVE_HANDLE_UNLOCK(r) \
-  int rr = 0;                                                 \
-  rr = pthread_rwlock_unlock(self->rwlock);                   \
-  if (rr) {                                                   \
-    PROM_LOG(PROM_PTHREAD_RWLOCK_UNLOCK_ERROR);               \
-    return rr;                                                \
-  } else {                                                    \
-    return r;                                                 \
+static void prom_metric_sample_histogram_atomic_add(_Atomic double *target, double value) {
+  double old = atomic_load_explicit(target, memory_order_relaxed);
+  while (!atomic_compare_exchange_weak_explicit(target, &old, old + value, memory_order_relaxed, memory_order_relaxed)) {
   }
+}
 
-  // Update the counter for the proper bucket if found
-  int bucket_count = prom_histogram_buckets_count(self->buckets);
-  for (int i = (bucket_count - 1); i >= 0; i--) {
-    if (value > self->buckets->upper_bounds[i]) {
-      break;
-    }
-
-    const char *bucket_key = prom_metric_sample_histogram_bucket_to_str(self->buckets->upper_bounds[i]);
-    if (bucket_key == NULL) {
-      PROM_METRIC_SAMPLE_HISTOGRAM_OBSERVE_HANDLE_UNLOCK(1)
-    }
+int prom_metric_sample_histogram_observe(prom_metric_sample_histogram_t *self, double value) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
 
-    const char *l_value = prom_map_get(self->l_values, bucket_key);
-    if (l_value == NULL) {
-      prom_free((void *)bucket_key);
-      PROM_METRIC_SAMPLE_HISTOGRAM_OBSERVE_HANDLE_UNLOCK(1)
-    }
+  // Registering the observation on count_and_hot also tells which shard is hot. That shard stays hot until the
+  // observation is completed below, a snapshot waits for it before reading the shard.
+  uint64_t n = atomic_fetch_add_explicit(&self->count_and_hot, 1, memory_order_acquire);
+  prom_metric_sample_histogram_shard_t *hot = &self->shards[n >> 63];
 
-    prom_metric_sample_t *sample = prom_map_get(self->samples, l_value);
-    if (sample == NULL) {
-      prom_free((void *)bucket_key);
-      PROM_METRIC_SAMPLE_HISTOGRAM_OBSERVE_HANDLE_UNLOCK(1)
-    }
+  // Only the bucket the value falls in is incremented, the cumulative counts are computed when scraping
+  size_t index = prom_metric_sample_histogram_bucket_index(self->buckets->upper_bounds, self->bucket_count, value);
+  atomic_fetch_add_explicit(&hot->buckets[index], 1, memory_order_relaxed);
+  prom_metric_sample_histogram_atomic_add(&hot->sum, value);
 
-    prom_free((void *)bucket_key);
-    r = prom_metric_sample_add(sample, 1.0);
-    if (r) {
-      PROM_METRIC_SAMPLE_HISTOGRAM_OBSERVE_HANDLE_UNLOCK(r);
-    }
-  }
-
-  // Update the +Inf and count samples
-  const char *inf_l_value = prom_map_get(self->l_values, "+Inf");
-  if (inf_l_value == NULL) {
-    PROM_METRIC_SAMPLE_HISTOGRAM_OBSERVE_HANDLE_UNLOCK(1);
-  }
+  atomic_fetch_add_explicit(&hot->count, 1, memory_order_release);
+  prom_metric_generation_bump(self->generation);
+  return 0;
+}
 
-  prom_metric_sample_t *inf_sample = prom_map_get(self->samples, inf_l_value);
-  if (inf_sample == NULL) {
-    PROM_METRIC_SAMPLE_HISTOGRAM_OBSERVE_HANDLE_UNLOCK(1);
-  }
+int prom_metric_sample_histogram_snapshot(prom_metric_sample_histogram_t *self, uint64_t *counts, double *sum) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
 
-  r = prom_metric_sample_add(inf_sample, 1.0);
+  int r = pthread_mutex_lock(self->snapshot_lock);
   if (r) {
-    PROM_METRIC_SAMPLE_HISTOGRAM_OBSERVE_HANDLE_UNLOCK(1);
-  }
-
-  const char *count_l_value = prom_map_get(self->l_values, "count");
-  if (count_l_value == NULL) {
-    PROM_METRIC_SAMPLE_HISTOGRAM_OBSERVE_HANDLE_UNLOCK(1);
+    PROM_LOG(PROM_PTHREAD_MUTEX_LOCK_ERROR);
+    return r;
   }
 
-  prom_metric_sample_t *count_sample = prom_map_get(self->samples, count_l_value);
-  if (count_sample == NULL) {
-    PROM_METRIC_SAMPLE_HISTOGRAM_OBSERVE_HANDLE_UNLOCK(1);
-  }
+  // Flip the hot bit: new observations go to the other shard and the current hot one becomes cold
+  uint64_t n = atomic_fetch_add_explicit(&self->count_and_hot, PROM_METRIC_SAMPLE_HISTOGRAM_HOT_BIT,
+                                         memory_order_acq_rel);
+  uint64_t count = n & ~PROM_METRIC_SAMPLE_HISTOGRAM_HOT_BIT;
+  prom_metric_sample_histogram_shard_t *hot = &self->shards[(n >> 63) ^ 1];
+  prom_metric_sample_histogram_shard_t *cold = &self->shards[n >> 63];
 
-  r = prom_metric_sample_add(count_sample, 1.0);
-  if (r) {
-    PROM_METRIC_SAMPLE_HISTOGRAM_OBSERVE_HANDLE_UNLOCK(1);
+  // The cold shard holds every observation so far once the ones started on it before the flip are completed
+  while (atomic_load_explicit(&cold->count, memory_order_acquire) != count) {
+    sched_yield();
   }
 
-  // Update the sum sample
-  const char *sum_l_value = prom_map_get(self->l_values, "sum");
-  if (sum_l_value == NULL) {
-    PROM_METRIC_SAMPLE_HISTOGRAM_OBSERVE_HANDLE_UNLOCK(1);
+  uint64_t cumulative = 0;
+  for (size_t i = 0; i <= self->bucket_count; i++) {
+    uint64_t bucket = atomic_load_explicit(&cold->buckets[i], memory_order_relaxed);
+    cumulative += bucket;
+    counts[i] = cumulative;
+    // Fold the cold shard into the hot one so that it keeps the whole history for the next snapshot
+    atomic_fetch_add_explicit(&hot->buckets[i], bucket, memory_order_relaxed);
+    atomic_store_explicit(&cold->buckets[i], 0, memory_order_relaxed);
   }
+  *sum = atomic_load_explicit(&cold->sum, memory_order_relaxed);
+  prom_metric_sample_histogram_atomic_add(&hot->sum, *sum);
+  atomic_store_explicit(&cold->sum, 0.0, memory_order_relaxed);
+  atomic_fetch_add_explicit(&hot->count, count, memory_order_release);
+  atomic_store_explicit(&cold->count, 0, memory_order_relaxed);
 
-  prom_metric_sample_t *sum_sample = prom_map_get(self->samples, sum_l_value);
-  if (sum_sample == NULL) {
-    PROM_METRIC_SAMPLE_HISTOGRAM_OBSERVE_HANDLE_UNLOCK(1);
+  r = pthread_mutex_unlock(self->snapshot_lock);
+  if (r) {
+    PROM_LOG(PROM_PTHREAD_MUTEX_UNLOCK_ERROR);
+    return r;
   }
-
-  r = prom_metric_sample_add(sum_sample, value);
-  PROM_METRIC_SAMPLE_HISTOGRAM_OBSERVE_HANDLE_UNLOCK(r);
-  return r;
+  return 0;
 }
 
 static const char *prom_metric_sample_histogram_l_value_for_bucket(prom_metric_sample_histogram_t *self,
@@ -493,17 +342,30 @@ static const char *prom_metric_sample_histogram_l_value_for_inf(prom_metric_samp
   return ret;
 }
 
-static void prom_metric_sample_histogram_free_str_generic(void *gen) {
-  char *str = (char *)gen;
-  prom_free((void *)str);
-  str = NULL;
+static const char *prom_metric_sample_histogram_l_value_for_suffix(prom_metric_sample_histogram_t *self,
+                                                                   const char *name, const char *suffix,
+                                                                   size_t label_count, const char **label_keys,
+                                                                   const char **label_values) {
+  PROM_ASSERT(self != NULL);
+  int r = 0;
+
+  r = prom_metric_formatter_load_l_value(self->metric_formatter, name, suffix, label_count, label_keys, label_values);
+  if (r) {
+    prom_metric_formatter_reset(self->metric_formatter);
+    return NULL;
+  }
+  return (const char *)prom_metric_formatter_dump(self->metric_formatter);
 }
 
-char *prom_metric_sample_histogram_bucket_to_str(double bucket) {
-  char *buf = (char *)prom_malloc(sizeof(char) * 50);
+char *prom_metric_sample_histogram_bucket_format(double bucket, char *buf) {
   sprintf(buf, "%g", bucket);
   if (!strchr(buf, '.')) {
     strcat(buf, ".0");
   }
   return buf;
 }
+
+char *prom_metric_sample_histogram_bucket_to_str(double bucket) {
+  char *buf = (char *)prom_malloc(sizeof(char) * PROM_METRIC_SAMPLE_HISTOGRAM_BUCKET_STR_SIZE);
+  return prom_metric_sample_histogram_bucket_format(bucket, buf);
+}
@@ -28,7 +28,8 @@
  */
 prom_metric_sample_histogram_t *prom_metric_sample_histogram_new(const char *name, prom_histogram_buckets_t *buckets,
                                                                  size_t label_count, const char **label_keys,
-                                                                 const char **label_vales);
+                                                                 const char **label_vales,
+                                                                 _Atomic uint64_t *generation);
 
 /**
  * @brief API PRIVATE Destroy a prom_metric_sample_histogram_t
@@ -40,6 +41,33 @@ int prom_metric_sample_histogram_destroy(prom_metric_sample_histogram_t *self);
  */
 int prom_metric_sample_histogram_destroy_generic(void *gen);
 
+/**
+ * @brief API PRIVATE Returns the index of the bucket a value falls in: the first upper bound not below the value, or
+ * bucket_count for +Inf
+ */
+size_t prom_metric_sample_histogram_bucket_index(const double *upper_bounds, size_t bucket_count, double value);
+
+/**
+ * @brief API PRIVATE Takes a consistent snapshot of the sample: the cumulative count of each bucket, +Inf last, into
+ * counts, of bucket_count + 1 entries, and the sum. The +Inf count is the count of the sample. Observers are never
+ * blocked, only concurrent snapshots of the same sample wait for each other.
+ */
+int prom_metric_sample_histogram_snapshot(prom_metric_sample_histogram_t *self, uint64_t *counts, double *sum);
+
+/**
+ * @brief API PRIVATE Size of the buffer that holds the le label value of a bucket
+ */
+#define PROM_METRIC_SAMPLE_HISTOGRAM_BUCKET_STR_SIZE 50
+
+/**
+ * @brief API PRIVATE Writes the le label value of a bucket into buf, of PROM_METRIC_SAMPLE_HISTOGRAM_BUCKET_STR_SIZE
+ * bytes, and returns buf
+ */
+char *prom_metric_sample_histogram_bucket_format(double bucket, char *buf);
+
+/**
+ * @brief API PRIVATE Returns the le label value of a bucket. The returned string must be deallocated.
+ */
 char *prom_metric_sample_histogram_bucket_to_str(double bucket);
 
 void prom_metric_sample_histogram_free_generic(void *gen);
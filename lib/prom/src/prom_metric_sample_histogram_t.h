@@ -15,25 +15,56 @@
  */
 
 #include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
 
 // Public
 #include "prom_histogram_buckets.h"
 #include "prom_metric_sample_histogram.h"
 
 // Private
-#include "prom_map_t.h"
 #include "prom_metric_formatter_t.h"
 
 #ifndef PROM_METRIC_HISTOGRAM_SAMPLE_T_H
 #define PROM_METRIC_HISTOGRAM_SAMPLE_T_H
 
+/**
+ * @brief API PRIVATE One of the two copies of the counters of a histogram sample
+ */
+typedef struct prom_metric_sample_histogram_shard {
+  _Atomic uint64_t count;    /**< observations completed on this shard */
+  _Atomic double sum;        /**< sum of the observed values */
+  _Atomic uint64_t *buckets; /**< observations per bucket, not cumulative; the last one is +Inf */
+} prom_metric_sample_histogram_shard_t;
+
+/**
+ * @brief API PRIVATE Bit of count_and_hot that selects the hot shard
+ */
+#define PROM_METRIC_SAMPLE_HISTOGRAM_HOT_BIT (UINT64_C(1) << 63)
+
+/**
+ * @brief API PRIVATE A histogram sample is made of a hot and a cold shard. Observers only write the hot one. A scrape
+ * swaps them by flipping the hot bit of count_and_hot, waits for the observations already started on the now cold shard
+ * to complete, reads it and then folds it into the hot one.
+ */
 struct prom_metric_sample_histogram {
-  prom_linked_list_t *l_value_list;
-  prom_map_t *l_values;
-  prom_map_t *samples;
-  prom_metric_formatter_t *metric_formatter;
-  prom_histogram_buckets_t *buckets;
-  pthread_rwlock_t *rwlock;
+  prom_histogram_buckets_t *buckets;              /**< upper bounds of the buckets, in increasing order */
+  size_t bucket_count;                            /**< number of upper bounds, +Inf excluded */
+  _Atomic uint64_t count_and_hot;                 /**< hot bit and, below it, the observations started */
+  prom_metric_sample_histogram_shard_t shards[2]; /**< hot and cold shards */
+  pthread_mutex_t *snapshot_lock;                 /**< serializes the scrapes, observers never take it */
+  const char **l_values;                          /**< l_values of the buckets, +Inf, count and sum, in order */
+  prom_metric_formatter_t *metric_formatter;      /**< formatter used to build the l_values */
+  _Atomic uint64_t *generation;                   /**< generation of the metric owning the sample */
 };
 
+/**
+ * @brief API PRIVATE Positions of the +Inf, count and sum l_values in l_values, and the number of l_values
+ */
+#define PROM_METRIC_SAMPLE_HISTOGRAM_INF_INDEX(self) ((self)->bucket_count)
+#define PROM_METRIC_SAMPLE_HISTOGRAM_COUNT_INDEX(self) ((self)->bucket_count + 1)
+#define PROM_METRIC_SAMPLE_HISTOGRAM_SUM_INDEX(self) ((self)->bucket_count + 2)
+#define PROM_METRIC_SAMPLE_HISTOGRAM_L_VALUE_COUNT(self) ((self)->bucket_count + 3)
+
 #endif  // PROM_METRIC_HISTOGRAM_SAMPLE_T_H
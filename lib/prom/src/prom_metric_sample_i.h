@@ -26,8 +26,10 @@
  * @param type The type of metric sample
  * @param l_value The entire left value of the metric e.g metric_name{foo="bar"}
  * @param r_value A double representing the value of the sample
+ * @param generation The generation of the metric owning the sample
  */
-prom_metric_sample_t *prom_metric_sample_new(prom_metric_type_t type, const char *l_value, double r_value);
+prom_metric_sample_t *prom_metric_sample_new(prom_metric_type_t type, const char *l_value, double r_value,
+                                             _Atomic uint64_t *generation);
 
 /**
  * @brief API PRIVATE Destroy the prom_metric_sample**
@@ -24,6 +24,7 @@ struct prom_metric_sample {
   prom_metric_type_t type; /**< type is the metric type for the sample */
   char *l_value;           /**< l_value is the full metric name and label set represeted as a string */
   _Atomic double r_value;  /**< r_value is the value of the metric sample */
+  _Atomic uint64_t *generation; /**< generation of the metric owning the sample, bumped when r_value changes */
 };
 
 #endif  // PROM_METRIC_SAMPLE_T_H
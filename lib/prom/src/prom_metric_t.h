@@ -18,6 +18,8 @@
 #define PROM_METRIC_T_H
 
 #include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
 
 // Public
 #include "prom_histogram_buckets.h"
@@ -27,6 +29,7 @@
 #include "prom_map_i.h"
 #include "prom_map_t.h"
 #include "prom_metric_formatter_t.h"
+#include "prom_metric_template_t.h"
 
 /**
  * @brief API PRIVATE Contains metric type constants
@@ -50,8 +53,18 @@ struct prom_metric {
   prom_histogram_buckets_t *buckets;  /**< buckets          Array of histogram bucket upper bound values */
   size_t label_key_count;             /**< label_keys_count The count of labe_keys*/
   prom_metric_formatter_t *formatter; /**< formatter        The metric formatter  */
+  prom_metric_template_t *template;   /**< template         Rendered static text of the samples, for scrapes */
   pthread_rwlock_t *rwlock;           /**< rwlock           Required for locking on certain non-atomic operations */
   const char **label_keys;            /**< labels           Array comprised of const char **/
+  _Atomic uint64_t generation;        /**< generation       Starts at 1, bumped whenever the samples change */
 };
 
+/**
+ * @brief API PRIVATE Bumps a metric generation. Called after the change it accounts for, with release ordering, so that
+ * a scrape that loads the generation with acquire ordering before reading the samples sees every change counted in it.
+ */
+static inline void prom_metric_generation_bump(_Atomic uint64_t *generation) {
+  atomic_fetch_add_explicit(generation, 1, memory_order_release);
+}
+
 #endif  // PROM_METRIC_T_H
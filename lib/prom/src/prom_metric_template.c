@@ -0,0 +1,226 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+
+// Public
+#include "prom_alloc.h"
+
+// Private
+#include "prom_assert.h"
+#include "prom_linked_list_t.h"
+#include "prom_map_i.h"
+#include "prom_metric_sample_histogram_i.h"
+#include "prom_metric_sample_t.h"
+#include "prom_metric_t.h"
+#include "prom_metric_template_i.h"
+#include "prom_string_builder_i.h"
+
+// The initial number of segments allocated by a template
+#define PROM_METRIC_TEMPLATE_INIT_CAPACITY 8
+
+// Number of bucket counts a histogram snapshot keeps on the stack, larger histograms allocate them
+#define PROM_METRIC_TEMPLATE_HISTOGRAM_STACK_SIZE 64
+
+prom_metric_template_t *prom_metric_template_new(void) {
+  prom_metric_template_t *self = (prom_metric_template_t *)prom_malloc(sizeof(prom_metric_template_t));
+  self->text = prom_string_builder_new();
+  if (self->text == NULL) {
+    prom_free(self);
+    return NULL;
+  }
+  self->capacity = PROM_METRIC_TEMPLATE_INIT_CAPACITY;
+  self->segment_ends = (size_t *)prom_malloc(sizeof(size_t) * self->capacity);
+  self->samples = (void **)prom_malloc(sizeof(void *) * self->capacity);
+  self->segment_count = 0;
+  self->sample_count = 0;
+  self->valid = false;
+  return self;
+}
+
+int prom_metric_template_destroy(prom_metric_template_t *self) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 0;
+
+  int r = prom_string_builder_destroy(self->text);
+  self->text = NULL;
+  prom_free(self->segment_ends);
+  self->segment_ends = NULL;
+  prom_free(self->samples);
+  self->samples = NULL;
+  prom_free(self);
+  self = NULL;
+  return r;
+}
+
+void prom_metric_template_invalidate(prom_metric_template_t *self) {
+  PROM_ASSERT(self != NULL);
+  self->valid = false;
+}
+
+/**
+ * @brief API PRIVATE Appends the segment that precedes a value: the end of the previous line, if any, and the l_value
+ */
+static int prom_metric_template_add_segment(prom_metric_template_t *self, const char *l_value) {
+  int r = 0;
+  if (self->segment_count == self->capacity) {
+    self->capacity <<= 1;
+    self->segment_ends = (size_t *)prom_realloc(self->segment_ends, sizeof(size_t) * self->capacity);
+    self->samples = (void **)prom_realloc(self->samples, sizeof(void *) * self->capacity);
+  }
+
+  if (self->segment_count > 0) {
+    r = prom_string_builder_add_char(self->text, '\n');
+    if (r) return r;
+  }
+  r = prom_string_builder_add_str(self->text, l_value);
+  if (r) return r;
+  r = prom_string_builder_add_char(self->text, ' ');
+  if (r) return r;
+
+  self->segment_ends[self->segment_count++] = prom_string_builder_len(self->text);
+  return 0;
+}
+
+/**
+ * @brief API PRIVATE Appends a "# <keyword> <name> <text>" line
+ */
+static int prom_metric_template_add_comment(prom_metric_template_t *self, const char *keyword, const char *name,
+                                            const char *text) {
+  int r = 0;
+  r = prom_string_builder_add_str(self->text, keyword);
+  if (r) return r;
+  r = prom_string_builder_add_str(self->text, name);
+  if (r) return r;
+  r = prom_string_builder_add_char(self->text, ' ');
+  if (r) return r;
+  r = prom_string_builder_add_str(self->text, text);
+  if (r) return r;
+  return prom_string_builder_add_char(self->text, '\n');
+}
+
+int prom_metric_template_build(prom_metric_template_t *self, prom_metric_t *metric) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+
+  int r = 0;
+  self->valid = false;
+  self->segment_count = 0;
+  self->sample_count = 0;
+  r = prom_string_builder_reset(self->text);
+  if (r) return r;
+
+  r = prom_metric_template_add_comment(self, "# HELP ", metric->name, metric->help);
+  if (r) return r;
+  r = prom_metric_template_add_comment(self, "# TYPE ", metric->name, prom_metric_type_map[metric->type]);
+  if (r) return r;
+
+  for (prom_linked_list_node_t *current_node = metric->samples->keys->head; current_node != NULL;
+       current_node = current_node->next) {
+    const char *key = (const char *)current_node->item;
+    void *sample = prom_map_get(metric->samples, key);
+    if (sample == NULL) return 1;
+
+    // Recorded before its segments are added, which may grow samples
+    size_t sample_index = self->sample_count;
+    if (metric->type == PROM_HISTOGRAM) {
+      prom_metric_sample_histogram_t *hist_sample = (prom_metric_sample_histogram_t *)sample;
+      for (size_t i = 0; i < PROM_METRIC_SAMPLE_HISTOGRAM_L_VALUE_COUNT(hist_sample); i++) {
+        r = prom_metric_template_add_segment(self, hist_sample->l_values[i]);
+        if (r) return r;
+      }
+    } else {
+      r = prom_metric_template_add_segment(self, ((prom_metric_sample_t *)sample)->l_value);
+      if (r) return r;
+    }
+    self->samples[sample_index] = sample;
+    self->sample_count++;
+  }
+
+  // Ends the last line and the metric
+  if (self->segment_count > 0) {
+    r = prom_string_builder_add_char(self->text, '\n');
+    if (r) return r;
+  }
+  r = prom_string_builder_add_char(self->text, '\n');
+  if (r) return r;
+
+  self->valid = true;
+  return 0;
+}
+
+/**
+ * @brief API PRIVATE Copies the next segment of the template and formats the value that follows it
+ */
+static int prom_metric_template_render_value(prom_metric_template_t *self, prom_string_builder_t *string_builder,
+                                             size_t *segment, double value) {
+  size_t start = *segment == 0 ? 0 : self->segment_ends[*segment - 1];
+  int r = prom_string_builder_add_strn(string_builder, prom_string_builder_str(self->text) + start,
+                                       self->segment_ends[*segment] - start);
+  if (r) return r;
+  (*segment)++;
+  return prom_string_builder_add_double(string_builder, value);
+}
+
+/**
+ * @brief API PRIVATE Renders the bucket, +Inf, count and sum values of a histogram sample from one consistent
+ * snapshot, so the count always matches +Inf and the sum covers exactly the counted observations.
+ */
+static int prom_metric_template_render_histogram(prom_metric_template_t *self, prom_string_builder_t *string_builder,
+                                                 size_t *segment, prom_metric_sample_histogram_t *sample) {
+  int r = 0;
+  uint64_t stack_counts[PROM_METRIC_TEMPLATE_HISTOGRAM_STACK_SIZE];
+  uint64_t *counts = stack_counts;
+  if (sample->bucket_count + 1 > PROM_METRIC_TEMPLATE_HISTOGRAM_STACK_SIZE) {
+    counts = (uint64_t *)prom_malloc(sizeof(uint64_t) * (sample->bucket_count + 1));
+    if (counts == NULL) return 1;
+  }
+
+  double sum = 0.0;
+  r = prom_metric_sample_histogram_snapshot(sample, counts, &sum);
+  for (size_t i = 0; !r && i <= sample->bucket_count; i++) {
+    r = prom_metric_template_render_value(self, string_builder, segment, (double)counts[i]);
+  }
+  if (!r) r = prom_metric_template_render_value(self, string_builder, segment, (double)counts[sample->bucket_count]);
+  if (!r) r = prom_metric_template_render_value(self, string_builder, segment, sum);
+
+  if (counts != stack_counts) prom_free(counts);
+  return r;
+}
+
+int prom_metric_template_render(prom_metric_template_t *self, prom_metric_t *metric,
+                                prom_string_builder_t *string_builder) {
+  PROM_ASSERT(self != NULL);
+  PROM_ASSERT(self->valid);
+  if (self == NULL || !self->valid) return 1;
+
+  int r = 0;
+  size_t segment = 0;
+  for (size_t i = 0; i < self->sample_count; i++) {
+    if (metric->type == PROM_HISTOGRAM) {
+      r = prom_metric_template_render_histogram(self, string_builder, &segment,
+                                                (prom_metric_sample_histogram_t *)self->samples[i]);
+    } else {
+      r = prom_metric_template_render_value(self, string_builder, &segment,
+                                            ((prom_metric_sample_t *)self->samples[i])->r_value);
+    }
+    if (r) return r;
+  }
+
+  size_t start = segment == 0 ? 0 : self->segment_ends[segment - 1];
+  return prom_string_builder_add_strn(string_builder, prom_string_builder_str(self->text) + start,
+                                      prom_string_builder_len(self->text) - start);
+}
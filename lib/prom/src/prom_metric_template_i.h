@@ -0,0 +1,53 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PROM_METRIC_TEMPLATE_I_H
+#define PROM_METRIC_TEMPLATE_I_H
+
+// Private
+#include "prom_metric_t.h"
+#include "prom_metric_template_t.h"
+#include "prom_string_builder_t.h"
+
+/**
+ * @brief API PRIVATE Returns an invalid prom_metric_template_t, it is built by the first scrape
+ */
+prom_metric_template_t *prom_metric_template_new(void);
+
+/**
+ * @brief API PRIVATE Destroys a prom_metric_template_t
+ */
+int prom_metric_template_destroy(prom_metric_template_t *self);
+
+/**
+ * @brief API PRIVATE Marks the template stale. The caller must hold the metric write lock.
+ */
+void prom_metric_template_invalidate(prom_metric_template_t *self);
+
+/**
+ * @brief API PRIVATE Renders the static text of the metric into the template. The caller must hold the metric write
+ * lock.
+ */
+int prom_metric_template_build(prom_metric_template_t *self, prom_metric_t *metric);
+
+/**
+ * @brief API PRIVATE Appends the metric in the exposition format to string_builder, copying the segments of a valid
+ * template and formatting the current values between them. The caller must hold the metric read lock.
+ */
+int prom_metric_template_render(prom_metric_template_t *self, prom_metric_t *metric,
+                                prom_string_builder_t *string_builder);
+
+#endif  // PROM_METRIC_TEMPLATE_I_H
@@ -0,0 +1,41 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PROM_METRIC_TEMPLATE_T_H
+#define PROM_METRIC_TEMPLATE_T_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Private
+#include "prom_string_builder_t.h"
+
+/**
+ * @brief API PRIVATE The rendered static text of a metric: its HELP and TYPE lines and the l_value of every line,
+ * split into one segment per value. A scrape copies each segment and formats the value that follows it. The template
+ * is rebuilt lazily after a sample is added or removed.
+ */
+typedef struct prom_metric_template {
+  prom_string_builder_t *text; /**< segments, back to back; the text after the last segment closes the metric */
+  size_t *segment_ends;        /**< offset in text at which each segment ends, i.e. its value goes */
+  size_t segment_count;        /**< number of segments, i.e. of values */
+  void **samples;              /**< sample of each group of segments, in exposition order */
+  size_t sample_count;         /**< number of samples */
+  size_t capacity;             /**< number of segment_ends allocated; samples never outnumber segments */
+  bool valid;                  /**< false once the samples of the metric changed, until the template is rebuilt */
+} prom_metric_template_t;
+
+#endif  // PROM_METRIC_TEMPLATE_T_H
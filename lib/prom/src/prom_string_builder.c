@@ -21,6 +21,7 @@
 
 // Private
 #include "prom_assert.h"
+#include "prom_dtoa_i.h"
 #include "prom_string_builder_i.h"
 #include "prom_string_builder_t.h"
 
@@ -87,13 +88,19 @@ static int prom_string_builder_ensure_space(prom_string_builder_t *self, size_t
 }
 
 int prom_string_builder_add_str(prom_string_builder_t *self, const char *str) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+  if (str == NULL || *str == '\0') return 0;
+  return prom_string_builder_add_strn(self, str, strlen(str));
+}
+
+int prom_string_builder_add_strn(prom_string_builder_t *self, const char *str, size_t len) {
   PROM_ASSERT(self != NULL);
   int r = 0;
 
   if (self == NULL) return 1;
-  if (str == NULL || *str == '\0') return 0;
+  if (len == 0) return 0;
 
-  size_t len = strlen(str);
   r = prom_string_builder_ensure_space(self, len);
   if (r) return r;
 
@@ -117,6 +124,19 @@ int prom_string_builder_add_char(prom_string_builder_t *self, char c) {
   return 0;
 }
 
+int prom_string_builder_add_double(prom_string_builder_t *self, double value) {
+  PROM_ASSERT(self != NULL);
+  int r = 0;
+
+  if (self == NULL) return 1;
+  r = prom_string_builder_ensure_space(self, PROM_DTOA_BUFFER_SIZE);
+  if (r) return r;
+
+  // Formatted in place, prom_dtoa writes the terminating null
+  self->len += prom_dtoa(value, self->str + self->len);
+  return 0;
+}
+
 int prom_string_builder_truncate(prom_string_builder_t *self, size_t len) {
   PROM_ASSERT(self != NULL);
   if (self == NULL) return 1;
@@ -134,6 +154,14 @@ int prom_string_builder_clear(prom_string_builder_t *self) {
   return prom_string_builder_init(self);
 }
 
+int prom_string_builder_reset(prom_string_builder_t *self) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+  self->len = 0;
+  self->str[0] = '\0';
+  return 0;
+}
+
 size_t prom_string_builder_len(prom_string_builder_t *self) {
   PROM_ASSERT(self != NULL);
   return self->len;
@@ -39,18 +39,36 @@ int prom_string_builder_destroy(prom_string_builder_t *self);
  */
 int prom_string_builder_add_str(prom_string_builder_t *self, const char *str);
 
+/**
+ * API PRIVATE
+ * @brief Adds the first len characters of a string, which may contain no terminating null
+ */
+int prom_string_builder_add_strn(prom_string_builder_t *self, const char *str, size_t len);
+
 /**
  * API PRIVATE
  * @brief Adds a char
  */
 int prom_string_builder_add_char(prom_string_builder_t *self, char c);
 
+/**
+ * API PRIVATE
+ * @brief Adds the shortest representation of a double that parses back to the same value
+ */
+int prom_string_builder_add_double(prom_string_builder_t *self, double value);
+
 /**
  * API PRIVATE
  * @brief Clear the string
  */
 int prom_string_builder_clear(prom_string_builder_t *self);
 
+/**
+ * API PRIVATE
+ * @brief Empty the string while keeping the allocated buffer
+ */
+int prom_string_builder_reset(prom_string_builder_t *self);
+
 /**
  * API PRIVATE
  * @brief Remove data from the end
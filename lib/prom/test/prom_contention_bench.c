@@ -0,0 +1,150 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Measures updaters and scrapers of the same metrics running at once. N updater threads set labeled gauges and
+ * increment labeled counters, picking the metric and the label set with a per-thread xorshift, while M scraper threads
+ * render the default registry with prom_collector_registry_bridge back to back. Reports the updates and scrapes per
+ * second and the scrape latency percentiles.
+ *
+ * Usage: prom_contention_bench [updaters] [scrapers] [seconds] [metrics]
+ */
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "prom.h"
+
+#define LABEL_SETS 8
+#define MAX_LATENCIES 1000000
+
+static const char *devices[LABEL_SETS] = {"sda", "sdb", "sdc", "sdd", "nvme0n1", "nvme1n1", "dm-0", "dm-1"};
+
+static prom_metric_t **metrics;
+static int metric_count;
+static atomic_bool stop;
+static atomic_ullong updates;
+
+static double *latencies;
+static atomic_size_t latency_count;
+
+static double now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static void *updater(void *arg) {
+  uint64_t state = (uintptr_t)arg * 0x9E3779B97F4A7C15ull + 1;
+  unsigned long long done = 0;
+  while (!atomic_load_explicit(&stop, memory_order_relaxed)) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    int index = (int)(state % (uint64_t)metric_count);
+    const char *labels[] = {devices[(state >> 32) % LABEL_SETS]};
+    // Even metrics are gauges and odd ones counters
+    if (index % 2 == 0) {
+      prom_gauge_set(metrics[index], (double)(state & 0xffff), labels);
+    } else {
+      prom_counter_inc(metrics[index], labels);
+    }
+    done++;
+  }
+  atomic_fetch_add(&updates, done);
+  return NULL;
+}
+
+static void *scraper(void *arg) {
+  (void)arg;
+  while (!atomic_load_explicit(&stop, memory_order_relaxed)) {
+    double start = now_ns();
+    const char *text = prom_collector_registry_bridge(PROM_COLLECTOR_REGISTRY_DEFAULT);
+    double elapsed = now_ns() - start;
+    free((void *)text);
+    size_t slot = atomic_fetch_add(&latency_count, 1);
+    if (slot < MAX_LATENCIES) latencies[slot] = elapsed;
+  }
+  return NULL;
+}
+
+static int compare_latencies(const void *a, const void *b) {
+  double x = *(const double *)a;
+  double y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+int main(int argc, char **argv) {
+  int updater_count = argc > 1 ? atoi(argv[1]) : 4;
+  int scraper_count = argc > 2 ? atoi(argv[2]) : 4;
+  double seconds = argc > 3 ? atof(argv[3]) : 2.0;
+  metric_count = argc > 4 ? atoi(argv[4]) : 200;
+  if (metric_count < 1) metric_count = 1;
+
+  prom_collector_registry_default_init();
+  metrics = malloc((size_t)metric_count * sizeof(prom_metric_t *));
+  // Metrics keep the name they are given, it must outlive them
+  char(*names)[32] = malloc((size_t)metric_count * sizeof(*names));
+  latencies = malloc(MAX_LATENCIES * sizeof(double));
+  const char *label_keys[] = {"device"};
+  for (int i = 0; i < metric_count; i++) {
+    snprintf(names[i], sizeof(names[i]), i % 2 == 0 ? "bench_gauge_%d" : "bench_counter_%d_total", i);
+    metrics[i] = prom_collector_registry_must_register_metric(
+        i % 2 == 0 ? prom_gauge_new(names[i], "contention bench", 1, label_keys)
+                   : prom_counter_new(names[i], "contention bench", 1, label_keys));
+    // Every label set exists before timing, so that updates take the steady-state path
+    for (int j = 0; j < LABEL_SETS; j++) {
+      const char *labels[] = {devices[j]};
+      if (i % 2 == 0) {
+        prom_gauge_set(metrics[i], 0, labels);
+      } else {
+        prom_counter_add(metrics[i], 0, labels);
+      }
+    }
+  }
+
+  pthread_t *threads = malloc((size_t)(updater_count + scraper_count) * sizeof(pthread_t));
+  double start = now_ns();
+  for (int i = 0; i < updater_count; i++) pthread_create(&threads[i], NULL, updater, (void *)(uintptr_t)(i + 1));
+  for (int i = 0; i < scraper_count; i++) pthread_create(&threads[updater_count + i], NULL, scraper, NULL);
+  struct timespec wait = {(time_t)seconds, (long)((seconds - (time_t)seconds) * 1e9)};
+  nanosleep(&wait, NULL);
+  atomic_store(&stop, true);
+  for (int i = 0; i < updater_count + scraper_count; i++) pthread_join(threads[i], NULL);
+  double elapsed = (now_ns() - start) / 1e9;
+
+  size_t scrapes = atomic_load(&latency_count);
+  size_t measured = scrapes < MAX_LATENCIES ? scrapes : MAX_LATENCIES;
+  printf("%d updaters, %d scrapers, %d metrics x %d label sets: %.2fM updates/s, %.0f scrapes/s", updater_count,
+         scraper_count, metric_count, LABEL_SETS, (double)atomic_load(&updates) / elapsed / 1e6,
+         (double)scrapes / elapsed);
+  if (measured > 0) {
+    qsort(latencies, measured, sizeof(double), compare_latencies);
+    printf(", scrape p50 %.0f us, p99 %.0f us", latencies[measured / 2] / 1e3, latencies[measured * 99 / 100] / 1e3);
+  }
+  printf("\n");
+
+  free(threads);
+  free(latencies);
+  free(metrics);
+  prom_collector_registry_destroy(PROM_COLLECTOR_REGISTRY_DEFAULT);
+  free(names);
+  return 0;
+}
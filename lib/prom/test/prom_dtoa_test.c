@@ -0,0 +1,146 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Validates prom_dtoa against "%.17g", which always round-trips: for every value of a fixed set of edge cases and of a
+ * large pseudo-random corpus, the string written by prom_dtoa must parse back to the same double as the "%.17g" one
+ * and must not have more significant digits. NaN and the infinities must be spelled as the exposition format expects.
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "prom_dtoa_i.h"
+
+#define RANDOM_BIT_PATTERNS 1000000
+#define RANDOM_DECIMALS 300000
+
+static long failures = 0;
+static long checked = 0;
+
+// xorshift64, a fixed seed keeps the corpus reproducible
+static uint64_t random_state = 88172645463325252ULL;
+
+static uint64_t next_random(void) {
+  random_state ^= random_state << 13;
+  random_state ^= random_state >> 7;
+  random_state ^= random_state << 17;
+  return random_state;
+}
+
+static void fail(double value, const char *dtoa, const char *reason) {
+  if (failures < 10) fprintf(stderr, "FAIL %.17g -> \"%s\": %s\n", value, dtoa, reason);
+  failures++;
+}
+
+// Counts the significant digits of a decimal string, whether in fixed or scientific notation
+static int significant_digits(const char *str) {
+  int digits = 0;
+  int trailing_zeros = 0;
+  bool leading = true;
+  for (const char *c = str; *c != '\0' && *c != 'e'; c++) {
+    if (*c < '0' || *c > '9') continue;
+    if (*c == '0' && leading) continue;
+    leading = false;
+    digits++;
+    trailing_zeros = *c == '0' ? trailing_zeros + 1 : 0;
+  }
+  // Trailing zeros of an integer only place the decimal point
+  if (strchr(str, '.') == NULL && strchr(str, 'e') == NULL && digits > trailing_zeros) digits -= trailing_zeros;
+  return digits;
+}
+
+static void check(double value) {
+  char dtoa[PROM_DTOA_BUFFER_SIZE];
+  char reference[64];
+  size_t len = prom_dtoa(value, dtoa);
+  checked++;
+
+  if (len != strlen(dtoa) || len >= PROM_DTOA_BUFFER_SIZE) {
+    fail(value, dtoa, "bad length");
+    return;
+  }
+  if (isnan(value)) {
+    if (strcmp(dtoa, "NaN") != 0) fail(value, dtoa, "NaN spelled differently");
+    return;
+  }
+  if (isinf(value)) {
+    if (strcmp(dtoa, value > 0 ? "+Inf" : "-Inf") != 0) fail(value, dtoa, "infinity spelled differently");
+    return;
+  }
+
+  snprintf(reference, sizeof(reference), "%.17g", value);
+  double parsed = strtod(dtoa, NULL);
+  double reference_parsed = strtod(reference, NULL);
+  if (memcmp(&parsed, &reference_parsed, sizeof(double)) != 0) {
+    fail(value, dtoa, "does not round-trip like %.17g");
+  } else if (significant_digits(dtoa) > significant_digits(reference)) {
+    fail(value, dtoa, "more significant digits than %.17g");
+  }
+}
+
+int main(void) {
+  const double edge_cases[] = {0.0,
+                               -0.0,
+                               1.0,
+                               -1.0,
+                               0.1,
+                               0.2,
+                               0.3,
+                               0.5,
+                               100.0,
+                               3.14159,
+                               12345.678,
+                               1e-7,
+                               1e-6,
+                               1e15,
+                               1e16,
+                               1e17,
+                               1e21,
+                               1e22,
+                               123456789012345678.0,
+                               9007199254740992.0,
+                               9007199254740993.0,
+                               5e-324,
+                               2.2250738585072014e-308,
+                               1.7976931348623157e308,
+                               NAN,
+                               INFINITY,
+                               -INFINITY};
+  for (size_t i = 0; i < sizeof(edge_cases) / sizeof(edge_cases[0]); i++) check(edge_cases[i]);
+
+  // Every bit pattern is a valid double, which covers all exponents and subnormals
+  for (long i = 0; i < RANDOM_BIT_PATTERNS; i++) {
+    uint64_t bits = next_random();
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    check(value);
+  }
+
+  // Values as exported by collectors: integers, counters in thousandths and small ratios
+  for (long i = 0; i < RANDOM_DECIMALS; i++) {
+    check((double)(int64_t)(next_random() >> 11));
+    check((double)(next_random() % 100000000) / 1000.0);
+    check((double)(next_random() % 1000) * 1e-3);
+  }
+
+  printf("%ld values checked, %ld failures\n", checked, failures);
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
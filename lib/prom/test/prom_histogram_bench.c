@@ -0,0 +1,86 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Measures prom_histogram_observe on one labeled sample shared by 1, 8 and 64 threads, the worst case for contention
+ * on its counters. Values are spread over the 16 buckets so that every counter is written. Reports the aggregate
+ * observations per second and the CPU time per observation, which stays comparable when there are more threads than
+ * cores.
+ *
+ * Usage: prom_histogram_bench [observations per thread]
+ */
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "prom.h"
+
+#define BUCKETS 16
+
+static prom_histogram_t *histogram;
+static long observations;
+
+static double now_ns(clockid_t clock) {
+  struct timespec ts;
+  clock_gettime(clock, &ts);
+  return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static void *observer(void *arg) {
+  uint64_t state = (uintptr_t)arg * 0x9E3779B97F4A7C15ull + 1;
+  const char *labels[] = {"sda"};
+  for (long i = 0; i < observations; i++) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    prom_histogram_observe(histogram, (double)(state % (BUCKETS + 1)), labels);
+  }
+  return NULL;
+}
+
+int main(int argc, char **argv) {
+  long total = argc > 1 ? atol(argv[1]) : 2000000;
+  const int thread_counts[] = {1, 8, 64};
+  const char *label_keys[] = {"device"};
+
+  histogram = prom_histogram_new("bench_histogram", "observe bench", prom_histogram_buckets_linear(0.5, 1, BUCKETS), 1,
+                                 label_keys);
+  // Creates the sample, so that only steady-state observes are timed
+  prom_histogram_observe(histogram, 0, (const char *[]){"sda"});
+
+  for (size_t t = 0; t < sizeof(thread_counts) / sizeof(thread_counts[0]); t++) {
+    int threads = thread_counts[t];
+    observations = total / threads;
+    pthread_t *ids = malloc((size_t)threads * sizeof(pthread_t));
+    double start = now_ns(CLOCK_MONOTONIC);
+    double cpu_start = now_ns(CLOCK_PROCESS_CPUTIME_ID);
+    for (int i = 0; i < threads; i++) pthread_create(&ids[i], NULL, observer, (void *)(uintptr_t)(i + 1));
+    for (int i = 0; i < threads; i++) pthread_join(ids[i], NULL);
+    double elapsed = now_ns(CLOCK_MONOTONIC) - start;
+    double cpu = now_ns(CLOCK_PROCESS_CPUTIME_ID) - cpu_start;
+    free(ids);
+
+    double done = (double)observations * threads;
+    printf("%2d threads: %6.2fM observations/s, %6.1f ns of CPU per observation\n", threads, done / elapsed * 1e3,
+           cpu / done);
+  }
+
+  prom_histogram_destroy(histogram);
+  return 0;
+}
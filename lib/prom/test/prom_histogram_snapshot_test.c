@@ -0,0 +1,152 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Checks that histogram scrapes are consistent while observers are running. Observer threads observe the values 0, 1,
+ * 2 and 3, one per bucket, on a labeled histogram while a scraper renders the registry over and over. Every scrape must
+ * report cumulative buckets that never decrease, a +Inf bucket equal to _count and a _sum equal to the one rebuilt from
+ * the bucket counts, and _count must never go backwards between scrapes. The final scrape must account for every
+ * observation.
+ */
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "prom.h"
+
+#define OBSERVERS 4
+#define SCRAPES 2000
+#define BUCKETS 3
+
+static prom_histogram_t *histogram;
+static atomic_bool stop;
+static long observed[OBSERVERS];
+
+static int failures = 0;
+static int reported = 0;
+
+static void fail(const char *what, const char *scrape) {
+  failures++;
+  // One full scrape is enough to diagnose, the rest only count
+  if (reported++ == 0) fprintf(stderr, "FAIL %s in scrape:\n%s\n", what, scrape);
+}
+
+static void *observer(void *arg) {
+  long id = (long)(uintptr_t)arg;
+  const char *labels[] = {"sda"};
+  long done = 0;
+  while (!atomic_load_explicit(&stop, memory_order_relaxed)) {
+    prom_histogram_observe(histogram, (double)((id + done) % (BUCKETS + 1)), labels);
+    done++;
+  }
+  observed[id] = done;
+  return NULL;
+}
+
+// Reads the value at the end of the line that starts with prefix, returns false if the line is missing
+static bool scrape_value(const char *scrape, const char *prefix, double *value) {
+  const char *line = strstr(scrape, prefix);
+  if (line == NULL) return false;
+  *value = strtod(line + strlen(prefix), NULL);
+  return true;
+}
+
+// Checks one scrape and returns its _count, -1 if it is inconsistent
+static double check_scrape(const char *scrape) {
+  static const char *bucket_prefixes[BUCKETS + 1] = {
+      "snapshot_test{device=\"sda\",le=\"0.5\"} ", "snapshot_test{device=\"sda\",le=\"1.5\"} ",
+      "snapshot_test{device=\"sda\",le=\"2.5\"} ", "snapshot_test{device=\"sda\",le=\"+Inf\"} "};
+  double buckets[BUCKETS + 1];
+  double count, sum;
+  for (int i = 0; i <= BUCKETS; i++) {
+    if (!scrape_value(scrape, bucket_prefixes[i], &buckets[i])) {
+      fail("missing bucket", scrape);
+      return -1;
+    }
+  }
+  if (!scrape_value(scrape, "snapshot_test_count{device=\"sda\"} ", &count) ||
+      !scrape_value(scrape, "snapshot_test_sum{device=\"sda\"} ", &sum)) {
+    fail("missing _count or _sum", scrape);
+    return -1;
+  }
+
+  // The value i lands in bucket i, so the sum follows from the non-cumulative counts
+  double rebuilt = 0;
+  for (int i = 0; i <= BUCKETS; i++) {
+    double in_bucket = buckets[i] - (i > 0 ? buckets[i - 1] : 0);
+    if (in_bucket < 0) {
+      fail("decreasing cumulative buckets", scrape);
+      return -1;
+    }
+    rebuilt += i * in_bucket;
+  }
+  if (buckets[BUCKETS] != count) {
+    fail("+Inf bucket different from _count", scrape);
+    return -1;
+  }
+  if (rebuilt != sum) {
+    fail("_sum different from the sum of the bucket counts", scrape);
+    return -1;
+  }
+  return count;
+}
+
+int main(void) {
+  const char *label_keys[] = {"device"};
+  prom_collector_registry_default_init();
+  histogram = prom_collector_registry_must_register_metric(prom_histogram_new(
+      "snapshot_test", "histogram snapshot test", prom_histogram_buckets_linear(0.5, 1, BUCKETS), 1, label_keys));
+  prom_histogram_observe(histogram, 0, (const char *[]){"sda"});
+
+  pthread_t observers[OBSERVERS];
+  for (long i = 0; i < OBSERVERS; i++) pthread_create(&observers[i], NULL, observer, (void *)(uintptr_t)i);
+
+  double last_count = 0;
+  int in_flight = 0;
+  for (int i = 0; i < SCRAPES; i++) {
+    const char *scrape = prom_collector_registry_bridge(PROM_COLLECTOR_REGISTRY_DEFAULT);
+    double count = check_scrape(scrape);
+    if (count >= 0 && count < last_count) fail("_count going backwards", scrape);
+    if (count > last_count) in_flight++;
+    if (count > last_count) last_count = count;
+    free((void *)scrape);
+  }
+
+  atomic_store(&stop, true);
+  long total = 1;
+  for (int i = 0; i < OBSERVERS; i++) {
+    pthread_join(observers[i], NULL);
+    total += observed[i];
+  }
+
+  const char *scrape = prom_collector_registry_bridge(PROM_COLLECTOR_REGISTRY_DEFAULT);
+  if (check_scrape(scrape) != (double)total) fail("final _count different from the observations", scrape);
+  free((void *)scrape);
+
+  if (failures) {
+    fprintf(stderr, "FAIL %d inconsistent checks\n", failures);
+  } else {
+    printf("ok %d scrapes, %d of them while the count grew, %ld observations\n", SCRAPES, in_flight, total);
+  }
+
+  prom_collector_registry_destroy(PROM_COLLECTOR_REGISTRY_DEFAULT);
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,129 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Checks that the steady-state update paths do not allocate: looking up an existing key in a prom_map, setting a
+ * labeled gauge, incrementing a labeled counter and observing a labeled histogram. malloc, calloc and realloc are
+ * interposed to count the calls made while counting is on; glibc routes strdup through the interposed malloc as well.
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "prom.h"
+#include "prom_map_i.h"
+
+#define ITERATIONS 10000
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static int counting = 0;
+static long allocations = 0;
+
+void *malloc(size_t size) {
+  if (counting) allocations++;
+  return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+  if (counting) allocations++;
+  return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+  if (counting) allocations++;
+  return __libc_realloc(ptr, size);
+}
+
+static int failures = 0;
+
+// Fails unless allocations were observed exactly when they are expected
+static void expect_allocations(const char *name, bool expected, long observed) {
+  if ((observed != 0) != expected) {
+    fprintf(stderr, "FAIL %s: %ld allocations\n", name, observed);
+    failures++;
+  } else {
+    printf("ok %s: %ld allocations\n", name, observed);
+  }
+}
+
+int main(void) {
+  const char *label_keys[] = {"device"};
+  const char *sda[] = {"sda"};
+  const char *sdb[] = {"sdb"};
+
+  prom_map_t *map = prom_map_new();
+  static int value = 1;
+  prom_map_set(map, "sda", &value);
+  uint64_t hash = prom_map_hash("sda");
+
+  prom_gauge_t *gauge = prom_gauge_new("test_gauge", "gauge", 1, label_keys);
+  prom_counter_t *counter = prom_counter_new("test_counter", "counter", 1, label_keys);
+  prom_histogram_t *histogram =
+      prom_histogram_new("test_histogram", "histogram", prom_histogram_buckets_linear(0.1, 0.1, 10), 1, label_keys);
+
+  // The first update of a label combination creates its sample
+  prom_gauge_set(gauge, 1.0, sda);
+  prom_counter_inc(counter, sda);
+  prom_histogram_observe(histogram, 0.35, sda);
+
+  int misses = 0;
+  counting = 1;
+  for (int i = 0; i < ITERATIONS; i++) {
+    if (prom_map_get(map, "sda") != &value || prom_map_get_with_hash(map, "sda", hash) != &value) misses++;
+  }
+  counting = 0;
+  if (misses) {
+    fprintf(stderr, "FAIL prom_map_get: %d lookups missed\n", misses);
+    failures++;
+  }
+  expect_allocations("prom_map_get", false, allocations);
+
+  allocations = 0;
+  counting = 1;
+  for (int i = 0; i < ITERATIONS; i++) prom_gauge_set(gauge, i, sda);
+  counting = 0;
+  expect_allocations("prom_gauge_set", false, allocations);
+
+  allocations = 0;
+  counting = 1;
+  for (int i = 0; i < ITERATIONS; i++) prom_counter_inc(counter, sda);
+  counting = 0;
+  expect_allocations("prom_counter_inc", false, allocations);
+
+  allocations = 0;
+  counting = 1;
+  for (int i = 0; i < ITERATIONS; i++) prom_histogram_observe(histogram, i * 0.0001, sda);
+  counting = 0;
+  expect_allocations("prom_histogram_observe", false, allocations);
+
+  // A new label combination must allocate, which also proves that the interposition is in effect
+  allocations = 0;
+  counting = 1;
+  prom_gauge_set(gauge, 1.0, sdb);
+  counting = 0;
+  expect_allocations("prom_gauge_set new sample", true, allocations);
+
+  prom_histogram_destroy(histogram);
+  prom_counter_destroy(counter);
+  prom_gauge_destroy(gauge);
+  prom_map_destroy(map);
+
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,109 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Measures the prom_map at 10, 1k and 100k entries: the latency of inserting new keys, updating existing keys and
+ * looking up present and absent keys, and the heap memory held per entry as reported by mallinfo2. Keys are shaped
+ * like the label keys built by the metrics ("device=sda,..."). Lookups walk the keys in a shuffled order so that the
+ * larger maps are not served from a warm cache line by line.
+ */
+
+#include <malloc.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "prom_map_i.h"
+
+// Lookups and updates timed per size, spread over repeated passes on the keys
+#define OPERATIONS 2000000
+
+static volatile uintptr_t sink;
+
+static double now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static char **make_keys(size_t count, const char *prefix) {
+  char **keys = malloc(count * sizeof(char *));
+  for (size_t i = 0; i < count; i++) {
+    keys[i] = malloc(48);
+    snprintf(keys[i], 48, "%s=\"dev%zu\",queue=\"%zu\"", prefix, i, i % 16);
+  }
+  // Fisher-Yates with a fixed seed, so that runs are comparable
+  srand(42);
+  for (size_t i = count - 1; i > 0; i--) {
+    size_t j = (size_t)rand() % (i + 1);
+    char *swap = keys[i];
+    keys[i] = keys[j];
+    keys[j] = swap;
+  }
+  return keys;
+}
+
+// Heap bytes in use, including the blocks large enough to be served by mmap
+static size_t heap_in_use(void) {
+  struct mallinfo2 info = mallinfo2();
+  return info.uordblks + info.hblkhd;
+}
+
+static void free_keys(char **keys, size_t count) {
+  for (size_t i = 0; i < count; i++) free(keys[i]);
+  free(keys);
+}
+
+// Times OPERATIONS lookups of the given keys, in ns per lookup
+static double time_gets(prom_map_t *map, char **keys, size_t count) {
+  double start = now_ns();
+  for (size_t i = 0; i < OPERATIONS; i++) sink += (uintptr_t)prom_map_get(map, keys[i % count]);
+  return (now_ns() - start) / OPERATIONS;
+}
+
+static void bench(size_t count) {
+  static int value = 1;
+  char **keys = make_keys(count, "device");
+  char **absent = make_keys(count, "missing");
+
+  size_t before = heap_in_use();
+  prom_map_t *map = prom_map_new();
+  double start = now_ns();
+  for (size_t i = 0; i < count; i++) prom_map_set(map, keys[i], &value);
+  double insert = (now_ns() - start) / count;
+  size_t used = heap_in_use() - before;
+
+  start = now_ns();
+  for (size_t i = 0; i < OPERATIONS; i++) prom_map_set(map, keys[i % count], &value);
+  double update = (now_ns() - start) / OPERATIONS;
+
+  double hit = time_gets(map, keys, count);
+  double miss = time_gets(map, absent, count);
+
+  printf("%7zu entries: insert %6.1f ns  update %6.1f ns  get hit %6.1f ns  get miss %6.1f ns  memory %6.1f B/entry\n",
+         count, insert, update, hit, miss, (double)used / count);
+
+  prom_map_destroy(map);
+  free_keys(keys, count);
+  free_keys(absent, count);
+}
+
+int main(void) {
+  const size_t sizes[] = {10, 1000, 100000};
+  for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) bench(sizes[i]);
+  return 0;
+}
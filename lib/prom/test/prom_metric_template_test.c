@@ -0,0 +1,174 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Checks that the templates render the same bytes as the renderer they replaced, which built every line from the
+ * l_value and value of each sample. That renderer is kept below as the reference. Gauges, counters and histograms are
+ * compared after their first samples are created, after values change, after samples are added and removed between
+ * scrapes and once a metric has no samples left.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "prom.h"
+#include "prom_linked_list_t.h"
+#include "prom_map_i.h"
+#include "prom_map_t.h"
+#include "prom_metric_formatter_i.h"
+#include "prom_metric_formatter_t.h"
+#include "prom_metric_i.h"
+#include "prom_metric_sample_histogram_i.h"
+#include "prom_metric_sample_histogram_t.h"
+#include "prom_metric_sample_t.h"
+#include "prom_metric_t.h"
+#include "prom_string_builder_i.h"
+
+static int failures = 0;
+
+// The line renderer of the previous formatter
+static int reference_load_line(prom_metric_formatter_t *self, const char *l_value, double r_value) {
+  int r = prom_string_builder_add_str(self->string_builder, l_value);
+  if (!r) r = prom_string_builder_add_char(self->string_builder, ' ');
+  if (!r) r = prom_string_builder_add_double(self->string_builder, r_value);
+  if (!r) r = prom_string_builder_add_char(self->string_builder, '\n');
+  return r;
+}
+
+// The histogram renderer of the previous formatter
+static int reference_load_histogram(prom_metric_formatter_t *self, prom_metric_sample_histogram_t *sample) {
+  uint64_t *counts = malloc(sizeof(uint64_t) * (sample->bucket_count + 1));
+  double sum = 0.0;
+  int r = prom_metric_sample_histogram_snapshot(sample, counts, &sum);
+  for (size_t i = 0; !r && i <= sample->bucket_count; i++) {
+    r = reference_load_line(self, sample->l_values[i], (double)counts[i]);
+  }
+  if (!r) {
+    r = reference_load_line(self, sample->l_values[PROM_METRIC_SAMPLE_HISTOGRAM_COUNT_INDEX(sample)],
+                            (double)counts[sample->bucket_count]);
+  }
+  if (!r) r = reference_load_line(self, sample->l_values[PROM_METRIC_SAMPLE_HISTOGRAM_SUM_INDEX(sample)], sum);
+  free(counts);
+  return r;
+}
+
+// The metric renderer of the previous formatter, prom_metric_formatter_load_metric before the templates
+static int reference_load_metric(prom_metric_formatter_t *self, prom_metric_t *metric) {
+  int r = prom_metric_formatter_load_help(self, metric->name, metric->help);
+  if (!r) r = prom_metric_formatter_load_type(self, metric->name, metric->type);
+  for (prom_linked_list_node_t *node = metric->samples->keys->head; !r && node != NULL; node = node->next) {
+    void *sample = prom_map_get(metric->samples, (const char *)node->item);
+    if (sample == NULL) return 1;
+    if (metric->type == PROM_HISTOGRAM) {
+      r = reference_load_histogram(self, (prom_metric_sample_histogram_t *)sample);
+    } else {
+      r = prom_metric_formatter_load_sample(self, (prom_metric_sample_t *)sample);
+    }
+  }
+  if (!r) r = prom_string_builder_add_char(self->string_builder, '\n');
+  return r;
+}
+
+// Renders the metrics both ways and fails unless the output is byte-identical
+static void expect_identical(const char *name, prom_metric_t **metrics, size_t count) {
+  prom_metric_formatter_t *expected = prom_metric_formatter_new();
+  prom_metric_formatter_t *actual = prom_metric_formatter_new();
+  int r = 0;
+  for (size_t i = 0; !r && i < count; i++) {
+    r = reference_load_metric(expected, metrics[i]);
+    if (!r) r = prom_metric_formatter_load_metric(actual, metrics[i]);
+  }
+
+  const char *expected_str = prom_metric_formatter_str(expected);
+  const char *actual_str = prom_metric_formatter_str(actual);
+  if (r) {
+    fprintf(stderr, "FAIL %s: rendering returned %d\n", name, r);
+    failures++;
+  } else if (prom_metric_formatter_len(expected) != prom_metric_formatter_len(actual) ||
+             memcmp(expected_str, actual_str, prom_metric_formatter_len(expected)) != 0) {
+    fprintf(stderr, "FAIL %s\nexpected:\n%s\nactual:\n%s\n", name, expected_str, actual_str);
+    failures++;
+  } else {
+    printf("ok %s: %zu bytes\n", name, prom_metric_formatter_len(actual));
+  }
+
+  prom_metric_formatter_destroy(actual);
+  prom_metric_formatter_destroy(expected);
+}
+
+int main(void) {
+  const char *disk_keys[] = {"device", "queue"};
+  const char *device_keys[] = {"device"};
+  const char *sda[] = {"sda", "0"};
+  const char *sdb[] = {"sdb", "1"};
+  const char *nvme[] = {"nvme0n1", "\"quoted\\path\"\n"};
+  const char *eth0[] = {"eth0"};
+  const char *lo[] = {"lo"};
+
+  prom_gauge_t *gauge = prom_gauge_new("test_gauge", "a gauge", 2, disk_keys);
+  prom_counter_t *counter = prom_counter_new("test_counter_total", "a counter", 0, NULL);
+  prom_gauge_t *empty = prom_gauge_new("test_empty", "a gauge without samples", 1, device_keys);
+  prom_histogram_t *histogram =
+      prom_histogram_new("test_histogram", "a histogram", prom_histogram_buckets_linear(0.5, 1, 3), 1, device_keys);
+  // More buckets than the formatter keeps on the stack
+  prom_histogram_t *wide = prom_histogram_new("test_wide_histogram", "a wide histogram",
+                                              prom_histogram_buckets_exponential(0.001, 1.25, 70), 0, NULL);
+  prom_metric_t *metrics[] = {gauge, counter, empty, histogram, wide};
+  size_t count = sizeof(metrics) / sizeof(metrics[0]);
+
+  expect_identical("before any sample", metrics, count);
+
+  prom_gauge_set(gauge, 1.5, sda);
+  prom_gauge_set(gauge, -2, sdb);
+  prom_counter_add(counter, 12345678901.0, NULL);
+  prom_histogram_observe(histogram, 0.25, eth0);
+  prom_histogram_observe(histogram, 7, eth0);
+  prom_histogram_observe(wide, 0.01, NULL);
+  prom_histogram_observe(wide, 1e9, NULL);
+  expect_identical("first samples", metrics, count);
+
+  prom_gauge_set(gauge, NAN, sda);
+  prom_gauge_set(gauge, INFINITY, sdb);
+  prom_counter_inc(counter, NULL);
+  prom_histogram_observe(histogram, 1, eth0);
+  expect_identical("values changed", metrics, count);
+
+  prom_gauge_set(gauge, 1e-300, nvme);
+  prom_histogram_observe(histogram, 2, lo);
+  prom_gauge_set(empty, 0, (const char *[]){"sdc"});
+  expect_identical("samples added", metrics, count);
+
+  prom_metric_remove_sample(gauge, sdb);
+  prom_metric_remove_sample(histogram, eth0);
+  prom_metric_remove_sample(empty, (const char *[]){"sdc"});
+  expect_identical("samples removed", metrics, count);
+
+  prom_gauge_set(gauge, -0.0, sdb);
+  prom_histogram_observe(histogram, 3, eth0);
+  expect_identical("samples added back", metrics, count);
+
+  prom_metric_remove_sample(gauge, sda);
+  prom_metric_remove_sample(gauge, sdb);
+  prom_metric_remove_sample(gauge, nvme);
+  prom_metric_remove_sample(histogram, eth0);
+  prom_metric_remove_sample(histogram, lo);
+  expect_identical("every sample removed", metrics, count);
+
+  for (size_t i = 0; i < count; i++) prom_metric_destroy(metrics[i]);
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
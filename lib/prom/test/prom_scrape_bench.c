@@ -0,0 +1,107 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Measures the cost of a scrape with 10k and 100k series, spread over gauges of 1 and of 3 labels. The metrics are
+ * registered on a registry of their own, without the process metrics, and rendered with
+ * prom_collector_registry_scrape as the exporter does. Values change between scrapes, as they do between two collection cycles, and the
+ * median and best of the scrapes are reported.
+ *
+ * Usage: prom_scrape_bench [scrapes]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "prom.h"
+
+// Series per metric, so that 10k series are 10 metrics
+#define SERIES_PER_METRIC 1000
+
+static double now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static int compare_times(const void *a, const void *b) {
+  double x = *(const double *)a;
+  double y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+static void bench(size_t series, size_t label_count, int scrapes) {
+  static const char *label_keys[] = {"device", "queue", "direction"};
+  char registry_name[32];
+  snprintf(registry_name, sizeof(registry_name), "bench_%zu_%zu", series, label_count);
+  prom_collector_registry_t *registry = prom_collector_registry_new(registry_name);
+  prom_collector_t *collector = prom_collector_new("bench");
+  prom_collector_registry_register_collector(registry, collector);
+
+  size_t metric_count = series / SERIES_PER_METRIC;
+  prom_gauge_t **gauges = malloc(metric_count * sizeof(prom_gauge_t *));
+  // Metrics keep the name they are given, it must outlive them
+  char(*names)[32] = malloc(metric_count * sizeof(*names));
+  char values[3][16];
+  const char *label_values[] = {values[0], values[1], values[2]};
+  for (size_t m = 0; m < metric_count; m++) {
+    snprintf(names[m], sizeof(names[m]), "bench_gauge_%zu", m);
+    gauges[m] = prom_gauge_new(names[m], "scrape bench", label_count, label_keys);
+    prom_collector_add_metric(collector, gauges[m]);
+    for (size_t s = 0; s < SERIES_PER_METRIC; s++) {
+      snprintf(values[0], sizeof(values[0]), "dev%zu", s);
+      snprintf(values[1], sizeof(values[1]), "%zu", s % 8);
+      snprintf(values[2], sizeof(values[2]), "%s", s % 2 ? "read" : "write");
+      prom_gauge_set(gauges[m], (double)s, label_values);
+    }
+  }
+
+  double *times = malloc((size_t)scrapes * sizeof(double));
+  size_t bytes = 0;
+  for (int i = 0; i < scrapes; i++) {
+    // One changed value per metric, the cost of a scrape does not depend on how many changed
+    snprintf(values[0], sizeof(values[0]), "dev%d", i % SERIES_PER_METRIC);
+    snprintf(values[1], sizeof(values[1]), "%d", (i % SERIES_PER_METRIC) % 8);
+    snprintf(values[2], sizeof(values[2]), "%s", (i % SERIES_PER_METRIC) % 2 ? "read" : "write");
+    for (size_t m = 0; m < metric_count; m++) prom_gauge_set(gauges[m], i * 0.5, label_values);
+
+    double start = now_ns();
+    prom_collector_registry_scrape_t *scrape = prom_collector_registry_scrape(registry);
+    times[i] = now_ns() - start;
+    bytes += prom_collector_registry_scrape_len(scrape);
+    prom_collector_registry_scrape_release(scrape);
+  }
+  qsort(times, (size_t)scrapes, sizeof(double), compare_times);
+  printf("%zu label%s, %6zu series: median %7.2f ms, best %7.2f ms, %.1f MB per scrape\n", label_count,
+         label_count == 1 ? " " : "s", series, times[scrapes / 2] / 1e6, times[0] / 1e6, bytes / 1e6 / scrapes);
+
+  free(times);
+  free(gauges);
+  prom_collector_registry_destroy(registry);
+  free(names);
+}
+
+int main(int argc, char **argv) {
+  int scrapes = argc > 1 ? atoi(argv[1]) : 20;
+  if (scrapes < 1) scrapes = 1;
+  const size_t series[] = {10000, 100000};
+  const size_t label_counts[] = {1, 3};
+  for (size_t l = 0; l < sizeof(label_counts) / sizeof(label_counts[0]); l++) {
+    for (size_t s = 0; s < sizeof(series) / sizeof(series[0]); s++) bench(series[s], label_counts[l], scrapes);
+  }
+  return 0;
+}
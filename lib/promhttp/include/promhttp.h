@@ -23,6 +23,7 @@
  * https://www.gnu.org/software/libmicrohttpd/manual/libmicrohttpd.html#index-_002aMHD_005fAcceptPolicyCallback
  */
 
+#include <stdbool.h>
 #include <string.h>
 
 #include "microhttpd.h"
@@ -31,11 +32,81 @@
 /**
  * @brief Sets the active registry for metric scraping.
  *
+ * Registers the promhttp_metrics_responses_total self-metric on the registry, counting /metrics responses by status
+ * code. /metrics responses carry a weak ETag derived from a generation that the registry bumps on every change of a
+ * sample, leaving out the self-metrics of promhttp. A request whose If-None-Match lists the current ETag is answered
+ * with 304 Not Modified without rendering anything.
+ *
+ * /metrics?name[]=<name>&prefix=<prefix> renders only the metrics with one of the given names or starting with one of
+ * the given prefixes, see prom_collector_registry_scrape_matching. Both arguments may be repeated, up to 32 times each.
+ *
  * @param active_registery The target prom_collector_registry_t*. If null is passed, the default registry is used.
  *                         The registry MUST be initialized.
  */
 void promhttp_set_active_collector_registry(prom_collector_registry_t *active_registry);
 
+/**
+ * @brief Size of the chunks in which streamed /metrics responses are rendered
+ */
+#define PROMHTTP_STREAM_BLOCK_SIZE (32 * 1024)
+
+/**
+ * @brief Selects how /metrics responses are produced.
+ *
+ * By default the whole exposition is rendered into a pooled buffer before it is sent. When streaming, the exposition is
+ * rendered metric by metric into chunks of PROMHTTP_STREAM_BLOCK_SIZE bytes as the response is sent, which bounds the
+ * memory held by each scrape and sends the first bytes sooner. Streamed responses have no Content-Length and use
+ * chunked transfer encoding.
+ *
+ * @param streaming Whether /metrics responses are streamed
+ */
+void promhttp_set_streaming(bool streaming);
+
+/**
+ * @brief Default compression level of /metrics responses
+ */
+#define PROMHTTP_DEFAULT_COMPRESSION_LEVEL 1
+
+/**
+ * @brief Highest compression level accepted by promhttp_set_compression, the smallest output gzip can produce
+ */
+#define PROMHTTP_MAX_COMPRESSION_LEVEL 9
+
+/**
+ * @brief Default size, in bytes, below which /metrics responses are sent uncompressed
+ */
+#define PROMHTTP_DEFAULT_COMPRESSION_MIN_SIZE 1024
+
+/**
+ * @brief Enables the compression of /metrics responses for clients that accept it.
+ *
+ * The coding is negotiated from the Accept-Encoding header of each request: gzip, or zstd when promhttp is built with
+ * PROMHTTP_ZSTD and the client prefers or equally accepts it. The exposition is compressed as it is rendered and sent
+ * with chunked transfer encoding. Expositions smaller than min_size are sent uncompressed. The first call that enables
+ * compression registers the promhttp_compression_* self-metrics on the active registry, so it MUST be made after
+ * promhttp_set_active_collector_registry.
+ *
+ * @param level Compression level, used by gzip and zstd alike: 1 (fastest) to PROMHTTP_MAX_COMPRESSION_LEVEL
+ *              (smallest). 0 disables compression.
+ * @param min_size Size, in bytes, below which responses are sent uncompressed. Capped to PROMHTTP_STREAM_BLOCK_SIZE.
+ * @return A non-zero integer value upon failure, e.g. if a supported coding does not accept the level, in which case
+ *         the previous settings are kept
+ */
+int promhttp_set_compression(int level, size_t min_size);
+
+/**
+ * @brief Renders the active registry into an immutable snapshot that /metrics serves until the next one is published.
+ *
+ * Once a snapshot has been published, /metrics responses send the latest one as is, without rendering the registry or
+ * compressing anything, so the cost of a scrape does not depend on the number of metrics nor on how many clients
+ * scrape. Meant to be called by the thread that updates the metrics, once per update cycle. With compression enabled,
+ * the snapshot is compressed here with every supported coding. A snapshot is freed once it has been replaced and the
+ * last response sending it is done.
+ *
+ * @return A non-zero integer value upon failure, in which case the previous snapshot is still served
+ */
+int promhttp_publish_snapshot(void);
+
 /**
  *  @brief Starts a daemon in the background and returns a pointer to an HMD_Daemon.
  *
@@ -46,3 +117,63 @@ void promhttp_set_active_collector_registry(prom_collector_registry_t *active_re
  */
 struct MHD_Daemon *promhttp_start_daemon(unsigned int flags, unsigned short port, MHD_AcceptPolicyCallback apc,
                                          void *apc_cls);
+
+/**
+ * @brief Default number of threads of a daemon started with promhttp_start_daemon_with_config
+ */
+#define PROMHTTP_DEFAULT_THREAD_POOL_SIZE 4
+
+/**
+ * @brief Default maximum number of concurrent connections of a daemon started with promhttp_start_daemon_with_config
+ */
+#define PROMHTTP_DEFAULT_CONNECTION_LIMIT 1024
+
+/**
+ * @brief Default number of seconds an idle connection is kept open by a daemon started with
+ * promhttp_start_daemon_with_config
+ */
+#define PROMHTTP_DEFAULT_CONNECTION_TIMEOUT 10
+
+/**
+ * @brief Serving configuration of a daemon started with promhttp_start_daemon_with_config. Settings left at 0 keep
+ * the libmicrohttpd defaults.
+ */
+typedef struct promhttp_daemon_config {
+  unsigned short port;                  /**< TCP port to listen on */
+  bool epoll;                           /**< poll the connections with epoll, where libmicrohttpd supports it */
+  unsigned int thread_pool_size;        /**< threads polling and serving the connections, 0 or 1 for a single one */
+  unsigned int connection_limit;        /**< maximum number of concurrent connections */
+  unsigned int per_ip_connection_limit; /**< maximum number of concurrent connections per client address */
+  unsigned int connection_timeout;      /**< seconds an idle connection is kept open */
+  unsigned int listen_backlog;          /**< connections the kernel queues until they are accepted */
+} promhttp_daemon_config_t;
+
+/**
+ * @brief Initializer of a promhttp_daemon_config_t listening on the given port with the default settings
+ *
+ * *Example*
+ *
+ *     promhttp_daemon_config_t config = PROMHTTP_DEFAULT_DAEMON_CONFIG(8000);
+ */
+#define PROMHTTP_DEFAULT_DAEMON_CONFIG(port)                                                                           \
+  {                                                                                                                    \
+    (port), true, PROMHTTP_DEFAULT_THREAD_POOL_SIZE, PROMHTTP_DEFAULT_CONNECTION_LIMIT, 0,                              \
+        PROMHTTP_DEFAULT_CONNECTION_TIMEOUT, 0                                                                         \
+  }
+
+/**
+ * @brief Starts a daemon serving the active registry from its own threads and returns a pointer to an MHD_Daemon, or
+ * NULL upon failure.
+ *
+ * The connections are polled with epoll when requested and supported, otherwise with the best of poll and select that
+ * libmicrohttpd supports; select caps the number of connections at FD_SETSIZE. With a thread pool, every thread
+ * accepts and serves its own share of the connections, so a slow client only holds up its own thread. The caller
+ * does not need a thread of its own to keep the daemon running; it is stopped with MHD_stop_daemon.
+ *
+ * @param config The serving configuration
+ * @param apc Optional callback deciding whether to accept a connection, NULL to accept all of them
+ * @param apc_cls Argument of apc
+ * @return struct MHD_Daemon*
+ */
+struct MHD_Daemon *promhttp_start_daemon_with_config(const promhttp_daemon_config_t *config,
+                                                     MHD_AcceptPolicyCallback apc, void *apc_cls);
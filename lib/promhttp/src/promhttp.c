@@ -14,30 +14,417 @@
  * limitations under the License.
  */
 
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
 #include <string.h>
 
 #include "microhttpd.h"
 #include "prom.h"
+#include "promhttp.h"
+#include "promhttp_compression_i.h"
+#include "promhttp_metrics_i.h"
+#include "promhttp_snapshot_i.h"
 
 prom_collector_registry_t *PROM_ACTIVE_REGISTRY;
 
+static bool promhttp_streaming = false;
+static int promhttp_compression_level = 0;
+static size_t promhttp_compression_min_size = PROMHTTP_DEFAULT_COMPRESSION_MIN_SIZE;
+
+// Room for W/"<16 hex digits>-<coding>" and the terminator
+#define PROMHTTP_ETAG_SIZE 32
+
+// Maximum number of name[] and of prefix arguments of a /metrics request
+#define PROMHTTP_MAX_FILTERS 32
+
+/**
+ * @brief Metric names and prefixes a /metrics request asks for, none to render every metric
+ */
+typedef struct promhttp_filter {
+  const char *names[PROMHTTP_MAX_FILTERS];    /**< values of the name[] arguments */
+  size_t name_count;                          /**< number of names */
+  const char *prefixes[PROMHTTP_MAX_FILTERS]; /**< values of the prefix arguments */
+  size_t prefix_count;                        /**< number of prefixes */
+  bool overflow;                              /**< whether there were more arguments than PROMHTTP_MAX_FILTERS */
+} promhttp_filter_t;
+
 void promhttp_set_active_collector_registry(prom_collector_registry_t *active_registry) {
   if (!active_registry) {
     PROM_ACTIVE_REGISTRY = PROM_COLLECTOR_REGISTRY_DEFAULT;
   } else {
     PROM_ACTIVE_REGISTRY = active_registry;
   }
+  // Without its counters, responses are only left uncounted
+  promhttp_metrics_register(PROM_ACTIVE_REGISTRY);
+}
+
+void promhttp_set_streaming(bool streaming) { promhttp_streaming = streaming; }
+
+int promhttp_set_compression(int level, size_t min_size) {
+  if (level < 0) return 1;
+  if (level > 0) {
+    // The level is used by every coding, an invalid one would fail every compressed response and snapshot
+    for (int encoding = PROMHTTP_ENCODING_GZIP; encoding < PROMHTTP_ENCODING_COUNT; encoding++) {
+      if (promhttp_encoding_supported((promhttp_encoding_t)encoding) &&
+          !promhttp_compression_level_valid((promhttp_encoding_t)encoding, level)) {
+        return 1;
+      }
+    }
+    if (PROM_ACTIVE_REGISTRY == NULL) return 1;
+    int r = promhttp_compression_register_metrics(PROM_ACTIVE_REGISTRY);
+    if (r) return r;
+  }
+  promhttp_compression_level = level;
+  promhttp_compression_min_size = min_size;
+  return 0;
+}
+
+int promhttp_publish_snapshot(void) {
+  return promhttp_snapshot_publish(PROM_ACTIVE_REGISTRY, promhttp_compression_level, promhttp_compression_min_size);
+}
+
+/**
+ * @brief Formats the ETag of a /metrics response from the generation of the registry it was rendered at and the coding
+ * it is sent with. It is weak: volatile collectors such as the self-metrics of promhttp are left out of the generation, so two
+ * responses with the same ETag carry the same samples but not necessarily the same bytes.
+ */
+static void promhttp_format_etag(char *etag, size_t size, uint64_t generation, promhttp_encoding_t encoding) {
+  if (encoding == PROMHTTP_ENCODING_IDENTITY) {
+    snprintf(etag, size, "W/\"%" PRIx64 "\"", generation);
+  } else {
+    snprintf(etag, size, "W/\"%" PRIx64 "-%s\"", generation, promhttp_encoding_name(encoding));
+  }
+}
+
+/**
+ * @brief Whether an If-None-Match header value lists the ETag, or is "*". Uses the weak comparison that RFC 9110
+ * requires for If-None-Match, so the W/ prefixes are ignored.
+ */
+static bool promhttp_etag_matches(const char *if_none_match, const char *etag) {
+  if (if_none_match == NULL) return false;
+  // Compared without the W/ prefix
+  if (strncmp(etag, "W/", 2) == 0) etag += 2;
+  size_t etag_len = strlen(etag);
+
+  const char *p = if_none_match;
+  for (;;) {
+    while (*p == ' ' || *p == '\t' || *p == ',') p++;
+    if (*p == '\0') return false;
+    if (*p == '*') return true;
+    if (strncmp(p, "W/", 2) == 0) p += 2;
+    const char *end = p;
+    if (*p == '"') {
+      end = strchr(p + 1, '"');
+      if (end == NULL) return false;
+      end++;
+    }
+    if ((size_t)(end - p) == etag_len && memcmp(p, etag, etag_len) == 0) return true;
+    p = end;
+    while (*p != '\0' && *p != ',') p++;
+  }
+}
+
+/**
+ * @brief Queues a /metrics response with its ETag. With compression enabled, caches are told that it depends on
+ * Accept-Encoding.
+ */
+static enum MHD_Result promhttp_queue_metrics(struct MHD_Connection *connection, struct MHD_Response *response,
+                                              const char *etag) {
+  MHD_add_response_header(response, MHD_HTTP_HEADER_ETAG, etag);
+  if (promhttp_compression_level > 0) {
+    MHD_add_response_header(response, MHD_HTTP_HEADER_VARY, MHD_HTTP_HEADER_ACCEPT_ENCODING);
+  }
+  enum MHD_Result ret = MHD_queue_response(connection, MHD_HTTP_OK, response);
+  MHD_destroy_response(response);
+  promhttp_metrics_count_response(MHD_HTTP_OK);
+  return ret;
+}
+
+/**
+ * @brief Queues an empty 304 response telling the client that the /metrics response it holds is still current
+ */
+static enum MHD_Result promhttp_queue_not_modified(struct MHD_Connection *connection, const char *etag) {
+  struct MHD_Response *response = MHD_create_response_from_buffer(0, (void *)"", MHD_RESPMEM_PERSISTENT);
+  if (response == NULL) return MHD_NO;
+  MHD_add_response_header(response, MHD_HTTP_HEADER_ETAG, etag);
+  if (promhttp_compression_level > 0) {
+    MHD_add_response_header(response, MHD_HTTP_HEADER_VARY, MHD_HTTP_HEADER_ACCEPT_ENCODING);
+  }
+  enum MHD_Result ret = MHD_queue_response(connection, MHD_HTTP_NOT_MODIFIED, response);
+  MHD_destroy_response(response);
+  promhttp_metrics_count_response(MHD_HTTP_NOT_MODIFIED);
+  return ret;
+}
+
+/**
+ * @brief Queues a /metrics response compressed with the given coding, or uncompressed if it is below the minimum size
+ */
+static enum MHD_Result promhttp_queue_compressed_metrics(struct MHD_Connection *connection,
+                                                         promhttp_encoding_t encoding, uint64_t generation) {
+  prom_collector_registry_stream_t *stream = prom_collector_registry_stream_new(PROM_ACTIVE_REGISTRY);
+  if (stream == NULL) return MHD_NO;
+  promhttp_compressor_t *compressor = promhttp_compressor_new(stream, encoding, promhttp_compression_level);
+  if (compressor == NULL) return MHD_NO;
+
+  bool complete = false;
+  if (promhttp_compressor_prefetch(compressor, promhttp_compression_min_size, &complete)) {
+    promhttp_compressor_destroy(compressor);
+    return MHD_NO;
+  }
+
+  struct MHD_Response *response = NULL;
+  if (complete) {
+    size_t len = 0;
+    const char *data = promhttp_compressor_prefetched(compressor, &len);
+    response = MHD_create_response_from_buffer(len, (void *)data, MHD_RESPMEM_MUST_COPY);
+    promhttp_compressor_destroy(compressor);
+    encoding = PROMHTTP_ENCODING_IDENTITY;
+  } else {
+    response = MHD_create_response_from_callback(MHD_SIZE_UNKNOWN, PROMHTTP_STREAM_BLOCK_SIZE,
+                                                 &promhttp_compressor_read, compressor, &promhttp_compressor_destroy);
+    if (response == NULL) {
+      promhttp_compressor_destroy(compressor);
+      return MHD_NO;
+    }
+    MHD_add_response_header(response, MHD_HTTP_HEADER_CONTENT_ENCODING, promhttp_encoding_name(encoding));
+  }
+  if (response == NULL) return MHD_NO;
+  char etag[PROMHTTP_ETAG_SIZE];
+  promhttp_format_etag(etag, sizeof(etag), generation, encoding);
+  return promhttp_queue_metrics(connection, response, etag);
+}
+
+/**
+ * @brief Queues a /metrics response sending a published snapshot, compressed if the client accepts a coding it was
+ * compressed with, or a 304 if the client already holds it. A 200 response holds the reference to the snapshot until
+ * MHD is done with it.
+ */
+static enum MHD_Result promhttp_queue_snapshot(struct MHD_Connection *connection, promhttp_snapshot_t *snapshot,
+                                               promhttp_encoding_t encoding, const char *if_none_match) {
+  size_t len = 0;
+  const char *data = promhttp_snapshot_data(snapshot, encoding, &len);
+  if (data == NULL) {
+    // Below the minimum size, the snapshot was not compressed
+    encoding = PROMHTTP_ENCODING_IDENTITY;
+    data = promhttp_snapshot_data(snapshot, encoding, &len);
+  }
+
+  char etag[PROMHTTP_ETAG_SIZE];
+  promhttp_format_etag(etag, sizeof(etag), snapshot->generation, encoding);
+  if (promhttp_etag_matches(if_none_match, etag)) {
+    promhttp_snapshot_release(snapshot);
+    return promhttp_queue_not_modified(connection, etag);
+  }
+
+  struct MHD_Response *response =
+      MHD_create_response_from_buffer_with_free_callback_cls(len, (void *)data, &promhttp_snapshot_release, snapshot);
+  if (response == NULL) {
+    promhttp_snapshot_release(snapshot);
+    return MHD_NO;
+  }
+  if (encoding != PROMHTTP_ENCODING_IDENTITY) {
+    MHD_add_response_header(response, MHD_HTTP_HEADER_CONTENT_ENCODING, promhttp_encoding_name(encoding));
+  }
+  return promhttp_queue_metrics(connection, response, etag);
+}
+
+/**
+ * @brief Content reader of a streamed /metrics response, renders the next chunk of the exposition
+ */
+static ssize_t promhttp_read_stream(void *cls, uint64_t pos, char *buf, size_t max) {
+  (void)pos;
+  size_t len = 0;
+  if (prom_collector_registry_stream_read((prom_collector_registry_stream_t *)cls, buf, max, &len)) {
+    return MHD_CONTENT_READER_END_WITH_ERROR;
+  }
+  return len == 0 ? MHD_CONTENT_READER_END_OF_STREAM : (ssize_t)len;
+}
+
+/**
+ * @brief Free callback of a streamed /metrics response
+ */
+static void promhttp_destroy_stream(void *cls) {
+  prom_collector_registry_stream_destroy((prom_collector_registry_stream_t *)cls);
+}
+
+/**
+ * @brief Free callback of a /metrics response, gives the scrape buffer back to its pool
+ */
+static void promhttp_release_scrape(void *cls) {
+  prom_collector_registry_scrape_release((prom_collector_registry_scrape_t *)cls);
+}
+
+/**
+ * @brief Queues a 500 /metrics response
+ */
+static enum MHD_Result promhttp_queue_error(struct MHD_Connection *connection) {
+  char *buf = "Internal Server Error\n";
+  struct MHD_Response *response = MHD_create_response_from_buffer(strlen(buf), (void *)buf, MHD_RESPMEM_PERSISTENT);
+  int ret = MHD_queue_response(connection, MHD_HTTP_INTERNAL_SERVER_ERROR, response);
+  MHD_destroy_response(response);
+  promhttp_metrics_count_response(MHD_HTTP_INTERNAL_SERVER_ERROR);
+  return ret;
+}
+
+/**
+ * @brief Free callback of a compressed /metrics response
+ */
+static void promhttp_free_buffer(void *cls) { prom_free(cls); }
+
+/**
+ * @brief Iterator over the GET arguments of a /metrics request, collects the name[] and prefix arguments. The values
+ * belong to the connection and stay valid while the request is handled.
+ */
+static enum MHD_Result promhttp_collect_filter(void *cls, enum MHD_ValueKind kind, const char *key,
+                                               const char *value) {
+  (void)kind;
+  promhttp_filter_t *filter = (promhttp_filter_t *)cls;
+  if (value == NULL) return MHD_YES;
+  if (strcmp(key, "name[]") == 0 || strcmp(key, "name") == 0) {
+    if (filter->name_count == PROMHTTP_MAX_FILTERS) {
+      filter->overflow = true;
+      return MHD_NO;
+    }
+    filter->names[filter->name_count++] = value;
+  } else if (strcmp(key, "prefix") == 0) {
+    if (filter->prefix_count == PROMHTTP_MAX_FILTERS) {
+      filter->overflow = true;
+      return MHD_NO;
+    }
+    filter->prefixes[filter->prefix_count++] = value;
+  }
+  return MHD_YES;
+}
+
+/**
+ * @brief Queues a /metrics response with only the metrics matching the filter, compressed with the given coding unless
+ * it is below the minimum size. Only the matching metrics are rendered, see prom_collector_registry_scrape_matching.
+ */
+static enum MHD_Result promhttp_queue_filtered_metrics(struct MHD_Connection *connection,
+                                                       const promhttp_filter_t *filter, promhttp_encoding_t encoding,
+                                                       uint64_t generation) {
+  prom_collector_registry_scrape_t *scrape = prom_collector_registry_scrape_matching(
+      PROM_ACTIVE_REGISTRY, (const char **)filter->names, filter->name_count, (const char **)filter->prefixes,
+      filter->prefix_count);
+  if (scrape == NULL) return promhttp_queue_error(connection);
+
+  struct MHD_Response *response = NULL;
+  size_t len = prom_collector_registry_scrape_len(scrape);
+  char *compressed = NULL;
+  size_t compressed_len = 0;
+  if (encoding != PROMHTTP_ENCODING_IDENTITY && len >= promhttp_compression_min_size &&
+      promhttp_compress(encoding, promhttp_compression_level, prom_collector_registry_scrape_str(scrape), len,
+                        &compressed, &compressed_len) == 0) {
+    prom_collector_registry_scrape_release(scrape);
+    response =
+        MHD_create_response_from_buffer_with_free_callback_cls(compressed_len, compressed, &promhttp_free_buffer,
+                                                               compressed);
+    if (response == NULL) {
+      prom_free(compressed);
+      return MHD_NO;
+    }
+    MHD_add_response_header(response, MHD_HTTP_HEADER_CONTENT_ENCODING, promhttp_encoding_name(encoding));
+  } else {
+    encoding = PROMHTTP_ENCODING_IDENTITY;
+    response = MHD_create_response_from_buffer_with_free_callback_cls(len, prom_collector_registry_scrape_str(scrape),
+                                                                      &promhttp_release_scrape, scrape);
+    if (response == NULL) {
+      prom_collector_registry_scrape_release(scrape);
+      return MHD_NO;
+    }
+  }
+  char etag[PROMHTTP_ETAG_SIZE];
+  promhttp_format_etag(etag, sizeof(etag), generation, encoding);
+  return promhttp_queue_metrics(connection, response, etag);
+}
+
+/**
+ * @brief Queues a 400 response
+ */
+static enum MHD_Result promhttp_queue_bad_request(struct MHD_Connection *connection, char *buf) {
+  struct MHD_Response *response = MHD_create_response_from_buffer(strlen(buf), (void *)buf, MHD_RESPMEM_PERSISTENT);
+  int ret = MHD_queue_response(connection, MHD_HTTP_BAD_REQUEST, response);
+  MHD_destroy_response(response);
+  promhttp_metrics_count_response(MHD_HTTP_BAD_REQUEST);
+  return ret;
+}
+
+/**
+ * @brief Answers a GET /metrics, optionally restricted to the metrics named by name[] arguments or starting with a
+ * prefix argument. The If-None-Match header is checked against the generation of the registry before anything is
+ * rendered, so a 304 never touches the formatter.
+ */
+static enum MHD_Result promhttp_queue_exposition(struct MHD_Connection *connection) {
+  promhttp_filter_t filter;
+  memset(&filter, 0, sizeof(filter));
+  MHD_get_connection_values(connection, MHD_GET_ARGUMENT_KIND, &promhttp_collect_filter, &filter);
+  if (filter.overflow) return promhttp_queue_bad_request(connection, "Too many name[] or prefix arguments\n");
+  bool filtered = filter.name_count + filter.prefix_count > 0;
+
+  const char *if_none_match = MHD_lookup_connection_value(connection, MHD_HEADER_KIND, MHD_HTTP_HEADER_IF_NONE_MATCH);
+  promhttp_encoding_t encoding = PROMHTTP_ENCODING_IDENTITY;
+  if (promhttp_compression_level > 0) {
+    encoding = promhttp_negotiate_encoding(
+        MHD_lookup_connection_value(connection, MHD_HEADER_KIND, MHD_HTTP_HEADER_ACCEPT_ENCODING));
+  }
+
+  // A snapshot holds every metric, a filtered request renders its own metrics
+  promhttp_snapshot_t *snapshot = filtered ? NULL : promhttp_snapshot_acquire();
+  if (snapshot != NULL) return promhttp_queue_snapshot(connection, snapshot, encoding, if_none_match);
+
+  // Read before rendering: a change racing with the rendering makes the next response look newer, never this one
+  uint64_t generation = 0;
+  int r = filtered ? prom_collector_registry_generation_matching(PROM_ACTIVE_REGISTRY, (const char **)filter.names,
+                                                                 filter.name_count, (const char **)filter.prefixes,
+                                                                 filter.prefix_count, &generation)
+                   : prom_collector_registry_generation(PROM_ACTIVE_REGISTRY, &generation);
+  if (r) return promhttp_queue_error(connection);
+  char etag[PROMHTTP_ETAG_SIZE];
+  promhttp_format_etag(etag, sizeof(etag), generation, encoding);
+  if (promhttp_etag_matches(if_none_match, etag)) return promhttp_queue_not_modified(connection, etag);
+  if (encoding != PROMHTTP_ENCODING_IDENTITY) {
+    // The exposition is sent uncompressed when it is below the minimum size, which the client may hold instead
+    char identity_etag[PROMHTTP_ETAG_SIZE];
+    promhttp_format_etag(identity_etag, sizeof(identity_etag), generation, PROMHTTP_ENCODING_IDENTITY);
+    if (promhttp_etag_matches(if_none_match, identity_etag)) {
+      return promhttp_queue_not_modified(connection, identity_etag);
+    }
+  }
+  if (filtered) return promhttp_queue_filtered_metrics(connection, &filter, encoding, generation);
+  if (encoding != PROMHTTP_ENCODING_IDENTITY) {
+    return promhttp_queue_compressed_metrics(connection, encoding, generation);
+  }
+
+  if (promhttp_streaming) {
+    prom_collector_registry_stream_t *stream = prom_collector_registry_stream_new(PROM_ACTIVE_REGISTRY);
+    struct MHD_Response *response =
+        stream == NULL ? NULL
+                       : MHD_create_response_from_callback(MHD_SIZE_UNKNOWN, PROMHTTP_STREAM_BLOCK_SIZE,
+                                                           &promhttp_read_stream, stream, &promhttp_destroy_stream);
+    if (response == NULL) {
+      prom_collector_registry_stream_destroy(stream);
+      return MHD_NO;
+    }
+    return promhttp_queue_metrics(connection, response, etag);
+  }
+
+  // The pooled buffer is sent as is and goes back to the pool once MHD is done with the response
+  prom_collector_registry_scrape_t *scrape = prom_collector_registry_scrape(PROM_ACTIVE_REGISTRY);
+  if (scrape == NULL) return promhttp_queue_error(connection);
+  struct MHD_Response *response = MHD_create_response_from_buffer_with_free_callback_cls(
+      prom_collector_registry_scrape_len(scrape), prom_collector_registry_scrape_str(scrape), &promhttp_release_scrape,
+      scrape);
+  if (response == NULL) {
+    prom_collector_registry_scrape_release(scrape);
+    return MHD_NO;
+  }
+  return promhttp_queue_metrics(connection, response, etag);
 }
 
 enum MHD_Result promhttp_handler(void *cls, struct MHD_Connection *connection, const char *url, const char *method,
                      const char *version, const char *upload_data, size_t *upload_data_size, void **con_cls) {
-  if (strcmp(method, "GET") != 0) {
-    char *buf = "Invalid HTTP Method\n";
-    struct MHD_Response *response = MHD_create_response_from_buffer(strlen(buf), (void *)buf, MHD_RESPMEM_PERSISTENT);
-    int ret = MHD_queue_response(connection, MHD_HTTP_BAD_REQUEST, response);
-    MHD_destroy_response(response);
-    return ret;
-  }
+  if (strcmp(method, "GET") != 0) return promhttp_queue_bad_request(connection, "Invalid HTTP Method\n");
   if (strcmp(url, "/") == 0) {
     char *buf = "OK\n";
     struct MHD_Response *response = MHD_create_response_from_buffer(strlen(buf), (void *)buf, MHD_RESPMEM_PERSISTENT);
@@ -45,21 +432,47 @@ enum MHD_Result promhttp_handler(void *cls, struct MHD_Connection *connection, c
     MHD_destroy_response(response);
     return ret;
   }
-  if (strcmp(url, "/metrics") == 0) {
-    const char *buf = prom_collector_registry_bridge(PROM_ACTIVE_REGISTRY);
-    struct MHD_Response *response = MHD_create_response_from_buffer(strlen(buf), (void *)buf, MHD_RESPMEM_MUST_FREE);
-    int ret = MHD_queue_response(connection, MHD_HTTP_OK, response);
-    MHD_destroy_response(response);
-    return ret;
-  }
-  char *buf = "Bad Request\n";
-  struct MHD_Response *response = MHD_create_response_from_buffer(strlen(buf), (void *)buf, MHD_RESPMEM_PERSISTENT);
-  int ret = MHD_queue_response(connection, MHD_HTTP_BAD_REQUEST, response);
-  MHD_destroy_response(response);
-  return ret;
+  if (strcmp(url, "/metrics") == 0) return promhttp_queue_exposition(connection);
+  return promhttp_queue_bad_request(connection, "Bad Request\n");
 }
 
 struct MHD_Daemon *promhttp_start_daemon(unsigned int flags, unsigned short port, MHD_AcceptPolicyCallback apc,
                                          void *apc_cls) {
   return MHD_start_daemon(flags, port, apc, apc_cls, &promhttp_handler, NULL, MHD_OPTION_END);
 }
+
+struct MHD_Daemon *promhttp_start_daemon_with_config(const promhttp_daemon_config_t *config,
+                                                     MHD_AcceptPolicyCallback apc, void *apc_cls) {
+  if (config == NULL) return NULL;
+
+  unsigned int flags = MHD_USE_INTERNAL_POLLING_THREAD;
+  if (config->epoll && MHD_is_feature_supported(MHD_FEATURE_EPOLL) == MHD_YES) {
+    flags |= MHD_USE_EPOLL;
+  } else {
+    flags |= MHD_USE_AUTO;
+  }
+
+  // Only the settings that were given, the others keep the libmicrohttpd defaults
+  struct MHD_OptionItem options[6];
+  size_t count = 0;
+  if (config->thread_pool_size > 1) {
+    options[count++] = (struct MHD_OptionItem){MHD_OPTION_THREAD_POOL_SIZE, config->thread_pool_size, NULL};
+  }
+  if (config->connection_limit > 0) {
+    options[count++] = (struct MHD_OptionItem){MHD_OPTION_CONNECTION_LIMIT, config->connection_limit, NULL};
+  }
+  if (config->per_ip_connection_limit > 0) {
+    options[count++] =
+        (struct MHD_OptionItem){MHD_OPTION_PER_IP_CONNECTION_LIMIT, config->per_ip_connection_limit, NULL};
+  }
+  if (config->connection_timeout > 0) {
+    options[count++] = (struct MHD_OptionItem){MHD_OPTION_CONNECTION_TIMEOUT, config->connection_timeout, NULL};
+  }
+  if (config->listen_backlog > 0) {
+    options[count++] = (struct MHD_OptionItem){MHD_OPTION_LISTEN_BACKLOG_SIZE, config->listen_backlog, NULL};
+  }
+  options[count] = (struct MHD_OptionItem){MHD_OPTION_END, 0, NULL};
+
+  return MHD_start_daemon(flags, config->port, apc, apc_cls, &promhttp_handler, NULL, MHD_OPTION_ARRAY, options,
+                          MHD_OPTION_END);
+}
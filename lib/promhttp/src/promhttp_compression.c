@@ -0,0 +1,349 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <zlib.h>
+#ifdef PROMHTTP_ZSTD
+#include <zstd.h>
+#endif
+
+#include "microhttpd.h"
+#include "prom.h"
+#include "promhttp.h"
+#include "promhttp_compression_i.h"
+#include "promhttp_metrics_i.h"
+
+// windowBits of deflateInit2 for a gzip wrapper around a 32 KiB window
+#define PROMHTTP_GZIP_WINDOW_BITS (15 + 16)
+#define PROMHTTP_GZIP_MEM_LEVEL 8
+
+struct promhttp_compressor {
+  prom_collector_registry_stream_t *stream; /**< exposition being compressed */
+  promhttp_encoding_t encoding;             /**< coding of the output */
+  z_stream gzip;                            /**< deflate state, for PROMHTTP_ENCODING_GZIP */
+#ifdef PROMHTTP_ZSTD
+  ZSTD_CStream *zstd; /**< zstd state, for PROMHTTP_ENCODING_ZSTD */
+#endif
+  char input[PROMHTTP_STREAM_BLOCK_SIZE]; /**< rendered exposition waiting to be compressed */
+  size_t input_len;                       /**< bytes in input */
+  size_t input_pos;                       /**< bytes of input already compressed */
+  bool input_done;                        /**< whether the whole exposition has been rendered */
+  bool finished;                          /**< whether the compressed stream has been fully produced */
+  uint64_t input_bytes;                   /**< uncompressed bytes */
+  uint64_t output_bytes;                  /**< compressed bytes */
+  double seconds;                         /**< time spent compressing */
+};
+
+static prom_counter_t *promhttp_compression_input_bytes;
+static prom_counter_t *promhttp_compression_output_bytes;
+static prom_gauge_t *promhttp_compression_ratio;
+static prom_histogram_t *promhttp_compression_seconds;
+
+static const char *promhttp_encoding_names[PROMHTTP_ENCODING_COUNT] = {"identity", "gzip", "zstd"};
+
+const char *promhttp_encoding_name(promhttp_encoding_t encoding) { return promhttp_encoding_names[encoding]; }
+
+/**
+ * @brief Returns the quality the Accept-Encoding header gives to a coding: the q of its entry, else the q of "*", else 0
+ */
+static double promhttp_encoding_quality(const char *accept_encoding, const char *coding) {
+  double wildcard = 0.0;
+  const char *p = accept_encoding;
+  while (*p != '\0') {
+    // Each entry is "coding[;q=value]", entries are separated by commas
+    while (*p == ' ' || *p == '\t' || *p == ',') p++;
+    const char *name = p;
+    while (*p != '\0' && *p != ',' && *p != ';' && *p != ' ' && *p != '\t') p++;
+    size_t name_len = (size_t)(p - name);
+    double q = 1.0;
+    while (*p != '\0' && *p != ',') {
+      if (*p == ';') {
+        p++;
+        while (*p == ' ' || *p == '\t') p++;
+        if ((p[0] == 'q' || p[0] == 'Q') && p[1] == '=') q = strtod(p + 2, NULL);
+      } else {
+        p++;
+      }
+    }
+    if (name_len == 0) continue;
+    if (name_len == strlen(coding) && strncasecmp(name, coding, name_len) == 0) {
+      return q;
+    }
+    if (name_len == 1 && name[0] == '*') wildcard = q;
+  }
+  return wildcard;
+}
+
+bool promhttp_encoding_supported(promhttp_encoding_t encoding) {
+#ifdef PROMHTTP_ZSTD
+  if (encoding == PROMHTTP_ENCODING_ZSTD) return true;
+#endif
+  return encoding == PROMHTTP_ENCODING_GZIP;
+}
+
+bool promhttp_compression_level_valid(promhttp_encoding_t encoding, int level) {
+#ifdef PROMHTTP_ZSTD
+  // Negative zstd levels are its fast modes, left out as 0 and below are not compression levels for promhttp
+  if (encoding == PROMHTTP_ENCODING_ZSTD) return level >= 1 && level <= ZSTD_maxCLevel();
+#endif
+  if (encoding == PROMHTTP_ENCODING_GZIP) return level >= Z_BEST_SPEED && level <= Z_BEST_COMPRESSION;
+  return false;
+}
+
+promhttp_encoding_t promhttp_negotiate_encoding(const char *accept_encoding) {
+  if (accept_encoding == NULL) return PROMHTTP_ENCODING_IDENTITY;
+#ifdef PROMHTTP_ZSTD
+  double zstd = promhttp_encoding_quality(accept_encoding, "zstd");
+#else
+  double zstd = 0.0;
+#endif
+  double gzip = promhttp_encoding_quality(accept_encoding, "gzip");
+  if (zstd > 0.0 && zstd >= gzip) return PROMHTTP_ENCODING_ZSTD;
+  if (gzip > 0.0) return PROMHTTP_ENCODING_GZIP;
+  return PROMHTTP_ENCODING_IDENTITY;
+}
+
+int promhttp_compression_register_metrics(prom_collector_registry_t *registry) {
+  if (promhttp_compression_input_bytes != NULL) return 0;
+
+  const char *keys[] = {"encoding"};
+  prom_collector_t *collector = promhttp_metrics_collector(registry);
+  if (collector == NULL) return 1;
+  promhttp_compression_input_bytes = prom_counter_new("promhttp_compression_input_bytes_total",
+                                                      "Bytes of /metrics responses before compression", 1, keys);
+  promhttp_compression_output_bytes = prom_counter_new("promhttp_compression_output_bytes_total",
+                                                       "Bytes of /metrics responses after compression", 1, keys);
+  promhttp_compression_ratio = prom_gauge_new(
+      "promhttp_compression_ratio", "Compressed to uncompressed size ratio of the last compressed response", 1, keys);
+  promhttp_compression_seconds =
+      prom_histogram_new("promhttp_compression_seconds", "Time spent compressing a /metrics response",
+                         prom_histogram_buckets_exponential(0.0001, 2, 12), 1, keys);
+
+  int r = prom_collector_add_metric(collector, promhttp_compression_input_bytes);
+  if (!r) r = prom_collector_add_metric(collector, promhttp_compression_output_bytes);
+  if (!r) r = prom_collector_add_metric(collector, promhttp_compression_ratio);
+  if (!r) r = prom_collector_add_metric(collector, promhttp_compression_seconds);
+  if (r) {
+    // The metrics already added belong to the shared collector, the compression self-metrics are left disabled
+    promhttp_compression_input_bytes = NULL;
+    promhttp_compression_output_bytes = NULL;
+    promhttp_compression_ratio = NULL;
+    promhttp_compression_seconds = NULL;
+  }
+  return r;
+}
+
+promhttp_compressor_t *promhttp_compressor_new(prom_collector_registry_stream_t *stream, promhttp_encoding_t encoding,
+                                               int level) {
+  promhttp_compressor_t *self = (promhttp_compressor_t *)prom_malloc(sizeof(promhttp_compressor_t));
+  if (self == NULL) {
+    prom_collector_registry_stream_destroy(stream);
+    return NULL;
+  }
+  memset(self, 0, sizeof(*self));
+  self->stream = stream;
+  self->encoding = encoding;
+
+  int r = 1;
+  if (encoding == PROMHTTP_ENCODING_GZIP) {
+    r = deflateInit2(&self->gzip, level, Z_DEFLATED, PROMHTTP_GZIP_WINDOW_BITS, PROMHTTP_GZIP_MEM_LEVEL,
+                     Z_DEFAULT_STRATEGY) != Z_OK;
+  }
+#ifdef PROMHTTP_ZSTD
+  if (encoding == PROMHTTP_ENCODING_ZSTD) {
+    self->zstd = ZSTD_createCStream();
+    r = self->zstd == NULL || ZSTD_isError(ZSTD_CCtx_setParameter(self->zstd, ZSTD_c_compressionLevel, level));
+  }
+#endif
+  if (r) {
+    promhttp_compressor_destroy(self);
+    return NULL;
+  }
+  return self;
+}
+
+int promhttp_compressor_prefetch(promhttp_compressor_t *self, size_t min_size, bool *complete) {
+  if (min_size > sizeof(self->input)) min_size = sizeof(self->input);
+  while (self->input_len < min_size && !self->input_done) {
+    size_t len = 0;
+    int r = prom_collector_registry_stream_read(self->stream, self->input + self->input_len,
+                                                sizeof(self->input) - self->input_len, &len);
+    if (r) return r;
+    self->input_len += len;
+    self->input_bytes += len;
+    self->input_done = len == 0;
+  }
+  *complete = self->input_done;
+  return 0;
+}
+
+const char *promhttp_compressor_prefetched(promhttp_compressor_t *self, size_t *len) {
+  *len = self->input_len;
+  return self->input;
+}
+
+/**
+ * @brief Compresses the pending input into out, finishing the compressed stream once the input is done
+ */
+static int promhttp_compressor_step(promhttp_compressor_t *self, char *out, size_t max, size_t *produced) {
+  if (self->encoding == PROMHTTP_ENCODING_GZIP) {
+    self->gzip.next_in = (Bytef *)(self->input + self->input_pos);
+    self->gzip.avail_in = (uInt)(self->input_len - self->input_pos);
+    self->gzip.next_out = (Bytef *)out;
+    self->gzip.avail_out = (uInt)max;
+    int r = deflate(&self->gzip, self->input_done ? Z_FINISH : Z_NO_FLUSH);
+    if (r == Z_STREAM_ERROR) return 1;
+    self->input_pos = self->input_len - self->gzip.avail_in;
+    *produced = max - self->gzip.avail_out;
+    self->finished = r == Z_STREAM_END;
+    return 0;
+  }
+#ifdef PROMHTTP_ZSTD
+  if (self->encoding == PROMHTTP_ENCODING_ZSTD) {
+    ZSTD_inBuffer in = {self->input + self->input_pos, self->input_len - self->input_pos, 0};
+    ZSTD_outBuffer output = {out, max, 0};
+    size_t remaining = ZSTD_compressStream2(self->zstd, &output, &in, self->input_done ? ZSTD_e_end : ZSTD_e_continue);
+    if (ZSTD_isError(remaining)) return 1;
+    self->input_pos += in.pos;
+    *produced = output.pos;
+    self->finished = self->input_done && remaining == 0;
+    return 0;
+  }
+#endif
+  return 1;
+}
+
+/**
+ * @brief Returns the seconds elapsed since start, on CLOCK_MONOTONIC
+ */
+static double promhttp_compression_seconds_since(const struct timespec *start) {
+  struct timespec end;
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  return (double)(end.tv_sec - start->tv_sec) + (double)(end.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/**
+ * @brief Records one compressed response in the self-metrics, if they are registered
+ */
+static void promhttp_compression_observe(promhttp_encoding_t encoding, uint64_t input_bytes, uint64_t output_bytes,
+                                         double seconds) {
+  if (promhttp_compression_input_bytes == NULL) return;
+  const char *labels[] = {promhttp_encoding_name(encoding)};
+  prom_counter_add(promhttp_compression_input_bytes, (double)input_bytes, labels);
+  prom_counter_add(promhttp_compression_output_bytes, (double)output_bytes, labels);
+  if (input_bytes > 0) {
+    prom_gauge_set(promhttp_compression_ratio, (double)output_bytes / (double)input_bytes, labels);
+  }
+  prom_histogram_observe(promhttp_compression_seconds, seconds, labels);
+}
+
+ssize_t promhttp_compressor_read(void *cls, uint64_t pos, char *buf, size_t max) {
+  promhttp_compressor_t *self = (promhttp_compressor_t *)cls;
+  (void)pos;
+
+  // The compressor may swallow whole input blocks without output, keep feeding it until it produces something
+  size_t produced = 0;
+  while (produced == 0 && !self->finished) {
+    if (self->input_pos == self->input_len && !self->input_done) {
+      size_t len = 0;
+      if (prom_collector_registry_stream_read(self->stream, self->input, sizeof(self->input), &len)) {
+        return MHD_CONTENT_READER_END_WITH_ERROR;
+      }
+      self->input_len = len;
+      self->input_pos = 0;
+      self->input_bytes += len;
+      self->input_done = len == 0;
+    }
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int r = promhttp_compressor_step(self, buf, max, &produced);
+    self->seconds += promhttp_compression_seconds_since(&start);
+    if (r) return MHD_CONTENT_READER_END_WITH_ERROR;
+  }
+  self->output_bytes += produced;
+  return produced == 0 ? MHD_CONTENT_READER_END_OF_STREAM : (ssize_t)produced;
+}
+
+void promhttp_compressor_destroy(void *cls) {
+  promhttp_compressor_t *self = (promhttp_compressor_t *)cls;
+  if (self == NULL) return;
+
+  if (self->finished) {
+    promhttp_compression_observe(self->encoding, self->input_bytes, self->output_bytes, self->seconds);
+  }
+
+  // Both are no-ops on a state that was never initialized
+  deflateEnd(&self->gzip);
+#ifdef PROMHTTP_ZSTD
+  ZSTD_freeCStream(self->zstd);
+#endif
+  prom_collector_registry_stream_destroy(self->stream);
+  prom_free(self);
+}
+
+int promhttp_compress(promhttp_encoding_t encoding, int level, const char *data, size_t len, char **out,
+                      size_t *out_len) {
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  *out = NULL;
+  *out_len = 0;
+
+  int r = 1;
+  if (encoding == PROMHTTP_ENCODING_GZIP) {
+    z_stream gzip;
+    memset(&gzip, 0, sizeof(gzip));
+    if (deflateInit2(&gzip, level, Z_DEFLATED, PROMHTTP_GZIP_WINDOW_BITS, PROMHTTP_GZIP_MEM_LEVEL,
+                     Z_DEFAULT_STRATEGY) != Z_OK) {
+      return 1;
+    }
+    // deflateBound is large enough for deflate to finish the whole stream in one call
+    size_t bound = deflateBound(&gzip, (uLong)len);
+    *out = (char *)prom_malloc(bound);
+    gzip.next_in = (Bytef *)data;
+    gzip.avail_in = (uInt)len;
+    gzip.next_out = (Bytef *)*out;
+    gzip.avail_out = (uInt)bound;
+    r = deflate(&gzip, Z_FINISH) != Z_STREAM_END;
+    *out_len = bound - gzip.avail_out;
+    deflateEnd(&gzip);
+  }
+#ifdef PROMHTTP_ZSTD
+  if (encoding == PROMHTTP_ENCODING_ZSTD) {
+    ZSTD_CCtx *zstd = ZSTD_createCCtx();
+    if (zstd == NULL) return 1;
+    size_t bound = ZSTD_compressBound(len);
+    *out = (char *)prom_malloc(bound);
+    size_t produced = ZSTD_CCtx_setParameter(zstd, ZSTD_c_compressionLevel, level);
+    if (!ZSTD_isError(produced)) produced = ZSTD_compress2(zstd, *out, bound, data, len);
+    r = ZSTD_isError(produced);
+    *out_len = r ? 0 : produced;
+    ZSTD_freeCCtx(zstd);
+  }
+#endif
+  if (r) {
+    prom_free(*out);
+    *out = NULL;
+    *out_len = 0;
+    return r;
+  }
+
+  promhttp_compression_observe(encoding, len, *out_len, promhttp_compression_seconds_since(&start));
+  return 0;
+}
@@ -0,0 +1,103 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PROMHTTP_COMPRESSION_I_H
+#define PROMHTTP_COMPRESSION_I_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "prom.h"
+
+/**
+ * @brief API PRIVATE Content codings a /metrics response can be sent with
+ */
+typedef enum promhttp_encoding {
+  PROMHTTP_ENCODING_IDENTITY = 0,
+  PROMHTTP_ENCODING_GZIP,
+  PROMHTTP_ENCODING_ZSTD,
+  PROMHTTP_ENCODING_COUNT
+} promhttp_encoding_t;
+
+/**
+ * @brief API PRIVATE Compresses a registry stream as it is read
+ */
+typedef struct promhttp_compressor promhttp_compressor_t;
+
+/**
+ * @brief API PRIVATE Chooses the coding of a response from the Accept-Encoding header of its request, NULL if the
+ * request has none. Codings with q=0 are refused, zstd is preferred over gzip when both are accepted and supported.
+ */
+promhttp_encoding_t promhttp_negotiate_encoding(const char *accept_encoding);
+
+/**
+ * @brief API PRIVATE Returns the name of a coding, as used in Content-Encoding
+ */
+const char *promhttp_encoding_name(promhttp_encoding_t encoding);
+
+/**
+ * @brief API PRIVATE Returns whether promhttp is built with support for a coding other than identity
+ */
+bool promhttp_encoding_supported(promhttp_encoding_t encoding);
+
+/**
+ * @brief API PRIVATE Returns whether level is a valid compression level of a coding other than identity
+ */
+bool promhttp_compression_level_valid(promhttp_encoding_t encoding, int level);
+
+/**
+ * @brief API PRIVATE Registers the compression self-metrics on the registry. Later calls do nothing.
+ */
+int promhttp_compression_register_metrics(prom_collector_registry_t *registry);
+
+/**
+ * @brief API PRIVATE Creates a compressor of the given stream, which it takes ownership of
+ */
+promhttp_compressor_t *promhttp_compressor_new(prom_collector_registry_stream_t *stream, promhttp_encoding_t encoding,
+                                               int level);
+
+/**
+ * @brief API PRIVATE Renders the first min_size bytes of the exposition, at most PROMHTTP_STREAM_BLOCK_SIZE, so that
+ * small expositions can be sent uncompressed. Sets complete when the whole exposition has been rendered.
+ */
+int promhttp_compressor_prefetch(promhttp_compressor_t *self, size_t min_size, bool *complete);
+
+/**
+ * @brief API PRIVATE Returns the bytes rendered by promhttp_compressor_prefetch
+ */
+const char *promhttp_compressor_prefetched(promhttp_compressor_t *self, size_t *len);
+
+/**
+ * @brief API PRIVATE MHD content reader producing the compressed exposition. cls is the promhttp_compressor_t*.
+ */
+ssize_t promhttp_compressor_read(void *cls, uint64_t pos, char *buf, size_t max);
+
+/**
+ * @brief API PRIVATE MHD free callback of a compressed response, records the self-metrics of a completed compression
+ * and destroys the compressor. cls is the promhttp_compressor_t*.
+ */
+void promhttp_compressor_destroy(void *cls);
+
+/**
+ * @brief API PRIVATE Compresses a whole buffer at once and records it in the self-metrics. On success, out is set to a
+ * buffer of out_len bytes that the caller must prom_free.
+ */
+int promhttp_compress(promhttp_encoding_t encoding, int level, const char *data, size_t len, char **out,
+                      size_t *out_len);
+
+#endif  // PROMHTTP_COMPRESSION_I_H
@@ -0,0 +1,77 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "microhttpd.h"
+#include "prom.h"
+#include "promhttp_metrics_i.h"
+
+static prom_collector_t *promhttp_metrics_self;
+static prom_counter_t *promhttp_metrics_responses;
+
+// Samples of the response counter, bound once so that counting a response does not look its labels up
+static prom_metric_sample_t *promhttp_metrics_responses_ok;
+static prom_metric_sample_t *promhttp_metrics_responses_not_modified;
+static prom_metric_sample_t *promhttp_metrics_responses_bad_request;
+static prom_metric_sample_t *promhttp_metrics_responses_error;
+
+prom_collector_t *promhttp_metrics_collector(prom_collector_registry_t *registry) {
+  if (promhttp_metrics_self != NULL) return promhttp_metrics_self;
+
+  prom_collector_t *collector = prom_collector_new("promhttp");
+  if (collector == NULL) return NULL;
+  // The self-metrics change with every request and would otherwise make every rendering look outdated
+  if (prom_collector_set_volatile(collector, true) || prom_collector_registry_register_collector(registry, collector)) {
+    prom_collector_destroy(collector);
+    return NULL;
+  }
+  promhttp_metrics_self = collector;
+  return collector;
+}
+
+int promhttp_metrics_register(prom_collector_registry_t *registry) {
+  if (promhttp_metrics_responses != NULL) return 0;
+
+  prom_collector_t *collector = promhttp_metrics_collector(registry);
+  if (collector == NULL) return 1;
+  prom_counter_t *responses = prom_counter_new("promhttp_metrics_responses_total",
+                                               "Responses to /metrics and to malformed requests by status code", 1,
+                                               (const char *[]){"code"});
+  if (responses == NULL) return 1;
+  if (prom_collector_add_metric(collector, responses)) {
+    prom_counter_destroy(responses);
+    return 1;
+  }
+  promhttp_metrics_responses_ok = prom_counter_with_labels(responses, (const char *[]){"200"});
+  promhttp_metrics_responses_not_modified = prom_counter_with_labels(responses, (const char *[]){"304"});
+  promhttp_metrics_responses_bad_request = prom_counter_with_labels(responses, (const char *[]){"400"});
+  promhttp_metrics_responses_error = prom_counter_with_labels(responses, (const char *[]){"500"});
+  promhttp_metrics_responses = responses;
+  return 0;
+}
+
+void promhttp_metrics_count_response(unsigned int status_code) {
+  prom_metric_sample_t *sample = NULL;
+  if (status_code == MHD_HTTP_OK) {
+    sample = promhttp_metrics_responses_ok;
+  } else if (status_code == MHD_HTTP_NOT_MODIFIED) {
+    sample = promhttp_metrics_responses_not_modified;
+  } else if (status_code == MHD_HTTP_BAD_REQUEST) {
+    sample = promhttp_metrics_responses_bad_request;
+  } else if (status_code == MHD_HTTP_INTERNAL_SERVER_ERROR) {
+    sample = promhttp_metrics_responses_error;
+  }
+  if (sample != NULL) prom_metric_sample_add(sample, 1.0);
+}
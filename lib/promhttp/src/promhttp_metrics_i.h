@@ -0,0 +1,39 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PROMHTTP_METRICS_I_H
+#define PROMHTTP_METRICS_I_H
+
+#include "prom.h"
+
+/**
+ * @brief API PRIVATE Returns the "promhttp" collector holding the self-metrics of promhttp, creating it and
+ * registering it on the registry on the first call. It is volatile, see prom_collector_set_volatile. NULL upon
+ * failure.
+ */
+prom_collector_t *promhttp_metrics_collector(prom_collector_registry_t *registry);
+
+/**
+ * @brief API PRIVATE Registers the counters of /metrics responses on the registry. Later calls do nothing.
+ */
+int promhttp_metrics_register(prom_collector_registry_t *registry);
+
+/**
+ * @brief API PRIVATE Counts a /metrics response, or a 400 to any request, with the given status code
+ */
+void promhttp_metrics_count_response(unsigned int status_code);
+
+#endif  // PROMHTTP_METRICS_I_H
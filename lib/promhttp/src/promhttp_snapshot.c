@@ -0,0 +1,98 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <sched.h>
+#include <stdatomic.h>
+#include <string.h>
+
+#include "prom.h"
+#include "promhttp_compression_i.h"
+#include "promhttp_metrics_i.h"
+#include "promhttp_snapshot_i.h"
+
+// Latest published snapshot, which holds one reference to it
+static _Atomic(promhttp_snapshot_t *) promhttp_snapshot_latest;
+
+// Readers between loading promhttp_snapshot_latest and referencing the snapshot they loaded
+static _Atomic unsigned int promhttp_snapshot_acquiring;
+
+int promhttp_snapshot_publish(prom_collector_registry_t *registry, int level, size_t min_size) {
+  if (registry == NULL) return 1;
+
+  promhttp_snapshot_t *self = (promhttp_snapshot_t *)prom_malloc(sizeof(promhttp_snapshot_t));
+  if (self == NULL) return 1;
+  memset(self, 0, sizeof(*self));
+  atomic_init(&self->refs, 1);
+  // Read before rendering: a change racing with the rendering makes the next publication look newer, never this one
+  if (prom_collector_registry_generation(registry, &self->generation)) {
+    prom_free(self);
+    return 1;
+  }
+  self->scrape = prom_collector_registry_scrape(registry);
+  if (self->scrape == NULL) {
+    prom_free(self);
+    return 1;
+  }
+
+  // Compressed once here rather than on every request
+  size_t len = prom_collector_registry_scrape_len(self->scrape);
+  if (level > 0 && len >= min_size) {
+    for (int encoding = PROMHTTP_ENCODING_IDENTITY + 1; encoding < PROMHTTP_ENCODING_COUNT; encoding++) {
+      if (!promhttp_encoding_supported((promhttp_encoding_t)encoding)) continue;
+      int r = promhttp_compress((promhttp_encoding_t)encoding, level, prom_collector_registry_scrape_str(self->scrape),
+                                len, &self->encoded[encoding], &self->encoded_len[encoding]);
+      if (r) {
+        promhttp_snapshot_release(self);
+        return r;
+      }
+    }
+  }
+
+  promhttp_snapshot_t *previous = atomic_exchange(&promhttp_snapshot_latest, self);
+  if (previous == NULL) return 0;
+
+  // A reader may have loaded the previous snapshot without referencing it yet. Its window is a few instructions long,
+  // so waiting for every reader to leave it is cheaper than a lock on every request.
+  while (atomic_load(&promhttp_snapshot_acquiring) != 0) sched_yield();
+  promhttp_snapshot_release(previous);
+  return 0;
+}
+
+promhttp_snapshot_t *promhttp_snapshot_acquire(void) {
+  atomic_fetch_add(&promhttp_snapshot_acquiring, 1);
+  promhttp_snapshot_t *self = atomic_load(&promhttp_snapshot_latest);
+  if (self != NULL) atomic_fetch_add(&self->refs, 1);
+  atomic_fetch_sub(&promhttp_snapshot_acquiring, 1);
+  return self;
+}
+
+void promhttp_snapshot_release(void *cls) {
+  promhttp_snapshot_t *self = (promhttp_snapshot_t *)cls;
+  if (self == NULL || atomic_fetch_sub(&self->refs, 1) != 1) return;
+
+  for (int encoding = 0; encoding < PROMHTTP_ENCODING_COUNT; encoding++) prom_free(self->encoded[encoding]);
+  prom_collector_registry_scrape_release(self->scrape);
+  prom_free(self);
+}
+
+const char *promhttp_snapshot_data(promhttp_snapshot_t *self, promhttp_encoding_t encoding, size_t *len) {
+  if (encoding == PROMHTTP_ENCODING_IDENTITY) {
+    *len = prom_collector_registry_scrape_len(self->scrape);
+    return prom_collector_registry_scrape_str(self->scrape);
+  }
+  *len = self->encoded_len[encoding];
+  return self->encoded[encoding];
+}
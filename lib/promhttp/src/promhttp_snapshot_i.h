@@ -0,0 +1,63 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PROMHTTP_SNAPSHOT_I_H
+#define PROMHTTP_SNAPSHOT_I_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "prom.h"
+#include "promhttp_compression_i.h"
+
+/**
+ * @brief API PRIVATE An immutable rendering of a registry, with a copy compressed with every supported coding. It is
+ * shared by every response sent while it is the latest one and freed once the last of them is done with it.
+ */
+typedef struct promhttp_snapshot {
+  prom_collector_registry_scrape_t *scrape;    /**< rendered exposition */
+  char *encoded[PROMHTTP_ENCODING_COUNT];      /**< compressed expositions, NULL where not compressed */
+  size_t encoded_len[PROMHTTP_ENCODING_COUNT]; /**< sizes of the compressed expositions */
+  uint64_t generation;                         /**< generation of the registry when it was rendered */
+  _Atomic unsigned int refs;                   /**< references: the responses and, while it is latest, the slot */
+} promhttp_snapshot_t;
+
+/**
+ * @brief API PRIVATE Renders the registry into a new snapshot, compresses it when compression is enabled and it is at
+ * least min_size bytes long, and publishes it in place of the previous one.
+ */
+int promhttp_snapshot_publish(prom_collector_registry_t *registry, int level, size_t min_size);
+
+/**
+ * @brief API PRIVATE Returns a reference to the latest snapshot, NULL if none was published. The reference must be
+ * given back with promhttp_snapshot_release.
+ */
+promhttp_snapshot_t *promhttp_snapshot_acquire(void);
+
+/**
+ * @brief API PRIVATE Gives back a reference to a snapshot, freeing it with the last one. cls is the
+ * promhttp_snapshot_t*, so it is also the MHD free callback of a response sending the snapshot.
+ */
+void promhttp_snapshot_release(void *cls);
+
+/**
+ * @brief API PRIVATE Returns the exposition of the snapshot in the given coding and sets len to its size, or NULL if
+ * it was not compressed with that coding.
+ */
+const char *promhttp_snapshot_data(promhttp_snapshot_t *self, promhttp_encoding_t encoding, size_t *len);
+
+#endif  // PROMHTTP_SNAPSHOT_I_H
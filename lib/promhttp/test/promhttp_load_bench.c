@@ -0,0 +1,457 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Load driver for /metrics: keeps a number of concurrent keep-alive connections, each sending GET /metrics as soon as
+ * the previous response is complete, and reports the throughput and the latency percentiles of the responses. One
+ * epoll thread drives every connection, so hundreds of them do not need hundreds of threads.
+ *
+ * Without -t, the driver serves a registry of -s gauge series itself, from a daemon started with
+ * PROMHTTP_DEFAULT_DAEMON_CONFIG as the exporter does, and publishes a snapshot every second from an updater thread
+ * (or renders on every request with -r). With -t host:port, it loads an exporter that is already running.
+ *
+ * Usage: promhttp_load_bench [-c connections] [-d seconds] [-s series] [-p port] [-r] [-z] [-t host:port]
+ */
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "prom.h"
+#include "promhttp.h"
+
+#define SERIES_PER_METRIC 1000
+#define HEADER_MAX 8192
+#define LINE_MAX_SIZE 64
+
+typedef enum {
+  RESPONSE_HEADER,
+  RESPONSE_BODY_LENGTH,
+  RESPONSE_BODY_UNTIL_CLOSE,
+  RESPONSE_CHUNK_SIZE,
+  RESPONSE_CHUNK_DATA,
+  RESPONSE_CHUNK_END,
+  RESPONSE_TRAILER,
+} response_state_t;
+
+typedef struct load_connection {
+  int fd;
+  response_state_t state;
+  char header[HEADER_MAX]; /**< header of the response, then a chunk size or trailer line */
+  size_t header_len;
+  size_t remaining;  /**< body or chunk bytes left */
+  int status;        /**< status code of the response */
+  bool close;        /**< the server closes the connection after this response */
+  double started_ns; /**< when the request was sent */
+} load_connection_t;
+
+static struct sockaddr_storage target;
+static socklen_t target_len;
+static char request[256];
+static size_t request_len;
+
+static double *latencies;
+static size_t latency_count;
+static size_t latency_capacity;
+static unsigned long responses_by_class[6];
+static unsigned long errors;
+
+static atomic_bool stop_updater;
+
+static double now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static int compare_latencies(const void *a, const void *b) {
+  double x = *(const double *)a;
+  double y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+static void record_latency(double latency) {
+  if (latency_count == latency_capacity) {
+    latency_capacity = latency_capacity ? latency_capacity * 2 : 65536;
+    latencies = realloc(latencies, latency_capacity * sizeof(double));
+  }
+  latencies[latency_count++] = latency;
+}
+
+// Opens a connection and sends its first request, returns false if the connection could not be started
+static bool connection_start(int epoll_fd, load_connection_t *connection) {
+  connection->fd = socket(target.ss_family, SOCK_STREAM, 0);
+  if (connection->fd < 0) return false;
+  int one = 1;
+  setsockopt(connection->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  if (connect(connection->fd, (struct sockaddr *)&target, target_len) != 0) {
+    close(connection->fd);
+    return false;
+  }
+  fcntl(connection->fd, F_SETFL, fcntl(connection->fd, F_GETFL) | O_NONBLOCK);
+  struct epoll_event event = {.events = EPOLLIN, .data.ptr = connection};
+  epoll_ctl(epoll_fd, EPOLL_CTL_ADD, connection->fd, &event);
+  return true;
+}
+
+// Sends the next request; the request is small enough to always fit in the socket buffer of an idle connection
+static bool connection_send(load_connection_t *connection) {
+  connection->state = RESPONSE_HEADER;
+  connection->header_len = 0;
+  connection->close = false;
+  connection->started_ns = now_ns();
+  return send(connection->fd, request, request_len, MSG_NOSIGNAL) == (ssize_t)request_len;
+}
+
+static void connection_restart(int epoll_fd, load_connection_t *connection) {
+  close(connection->fd);
+  if (!connection_start(epoll_fd, connection) || !connection_send(connection)) errors++;
+}
+
+// Parses the status line and the headers, and picks how the body ends
+static bool parse_header(load_connection_t *connection) {
+  connection->header[connection->header_len] = '\0';
+  int minor = 0;
+  if (sscanf(connection->header, "HTTP/1.%d %d", &minor, &connection->status) != 2) return false;
+  connection->state = RESPONSE_BODY_UNTIL_CLOSE;
+  // HTTP/1.0 closes the connection unless asked to keep it
+  connection->close = minor == 0;
+  for (char *line = strstr(connection->header, "\r\n"); line != NULL; line = strstr(line + 2, "\r\n")) {
+    if (strncasecmp(line + 2, "Content-Length:", 15) == 0) {
+      connection->remaining = strtoul(line + 17, NULL, 10);
+      connection->state = RESPONSE_BODY_LENGTH;
+    } else if (strncasecmp(line + 2, "Transfer-Encoding: chunked", 26) == 0) {
+      connection->state = RESPONSE_CHUNK_SIZE;
+    } else if (strncasecmp(line + 2, "Connection: close", 17) == 0) {
+      connection->close = true;
+    } else if (strncasecmp(line + 2, "Connection: keep-alive", 22) == 0) {
+      connection->close = false;
+    }
+  }
+  connection->header_len = 0;
+  return true;
+}
+
+// Reads a line of the chunked body into header, returns the bytes consumed; *complete tells whether it ended
+static size_t read_line(load_connection_t *connection, const char *data, size_t len, bool *complete) {
+  const char *end = memchr(data, '\n', len);
+  size_t take = end != NULL ? (size_t)(end - data) + 1 : len;
+  size_t room = LINE_MAX_SIZE - connection->header_len;
+  memcpy(connection->header + connection->header_len, data, take < room ? take : room);
+  connection->header_len += take < room ? take : room;
+  *complete = end != NULL;
+  return take;
+}
+
+/**
+ * Feeds the bytes received on a connection to its response parser. Returns 1 once the response is complete, 0 while
+ * more bytes are needed and -1 on a malformed response.
+ */
+static int connection_feed(load_connection_t *connection, const char *data, size_t len) {
+  while (len > 0) {
+    size_t used = 0;
+    bool complete = false;
+    switch (connection->state) {
+      case RESPONSE_HEADER: {
+        size_t room = HEADER_MAX - 1 - connection->header_len;
+        if (room == 0) return -1;
+        used = len < room ? len : room;
+        memcpy(connection->header + connection->header_len, data, used);
+        connection->header_len += used;
+        connection->header[connection->header_len] = '\0';
+        char *end = strstr(connection->header, "\r\n\r\n");
+        if (end != NULL) {
+          // Gives back the bytes past the header
+          size_t header_len = (size_t)(end - connection->header) + 4;
+          used -= connection->header_len - header_len;
+          connection->header_len = header_len;
+          if (!parse_header(connection)) return -1;
+          // 304 and 204 responses never have a body
+          if (connection->status == 304 || connection->status == 204) return 1;
+          if (connection->state == RESPONSE_BODY_LENGTH && connection->remaining == 0) return 1;
+        }
+        break;
+      }
+      case RESPONSE_BODY_LENGTH:
+        used = len < connection->remaining ? len : connection->remaining;
+        connection->remaining -= used;
+        if (connection->remaining == 0) return 1;
+        break;
+      case RESPONSE_BODY_UNTIL_CLOSE:
+        used = len;
+        break;
+      case RESPONSE_CHUNK_SIZE:
+        used = read_line(connection, data, len, &complete);
+        if (complete) {
+          connection->header[connection->header_len] = '\0';
+          connection->remaining = strtoul(connection->header, NULL, 16);
+          connection->header_len = 0;
+          connection->state = connection->remaining > 0 ? RESPONSE_CHUNK_DATA : RESPONSE_TRAILER;
+        }
+        break;
+      case RESPONSE_CHUNK_DATA:
+        used = len < connection->remaining ? len : connection->remaining;
+        connection->remaining -= used;
+        if (connection->remaining == 0) connection->state = RESPONSE_CHUNK_END;
+        break;
+      case RESPONSE_CHUNK_END:
+        used = read_line(connection, data, len, &complete);
+        if (complete) {
+          connection->header_len = 0;
+          connection->state = RESPONSE_CHUNK_SIZE;
+        }
+        break;
+      case RESPONSE_TRAILER:
+        used = read_line(connection, data, len, &complete);
+        if (complete) {
+          // An empty line ends the trailer and the response
+          bool empty = connection->header_len <= 2;
+          connection->header_len = 0;
+          if (empty) return 1;
+        }
+        break;
+    }
+    data += used;
+    len -= used;
+  }
+  return 0;
+}
+
+static void connection_done(int epoll_fd, load_connection_t *connection) {
+  record_latency(now_ns() - connection->started_ns);
+  int status_class = connection->status / 100;
+  responses_by_class[status_class >= 1 && status_class <= 5 ? status_class : 0]++;
+  if (connection->close) {
+    connection_restart(epoll_fd, connection);
+  } else if (!connection_send(connection)) {
+    errors++;
+    connection_restart(epoll_fd, connection);
+  }
+}
+
+static void run_load(int connection_count, double seconds) {
+  int epoll_fd = epoll_create1(0);
+  load_connection_t *connections = calloc((size_t)connection_count, sizeof(load_connection_t));
+  int started = 0;
+  for (int i = 0; i < connection_count; i++) {
+    if (connection_start(epoll_fd, &connections[i]) && connection_send(&connections[i])) {
+      started++;
+    } else {
+      errors++;
+    }
+  }
+  if (started < connection_count) fprintf(stderr, "only %d of %d connections started\n", started, connection_count);
+
+  static char buf[65536];
+  struct epoll_event events[256];
+  double start = now_ns();
+  double end = start + seconds * 1e9;
+  while (now_ns() < end) {
+    int ready = epoll_wait(epoll_fd, events, 256, 100);
+    for (int i = 0; i < ready; i++) {
+      load_connection_t *connection = events[i].data.ptr;
+      ssize_t n = recv(connection->fd, buf, sizeof(buf), 0);
+      if (n < 0 && (errno == EAGAIN || errno == EINTR)) continue;
+      if (n <= 0) {
+        // A response delimited by the end of the connection is complete, anything else was cut short
+        if (n == 0 && connection->state == RESPONSE_BODY_UNTIL_CLOSE) {
+          connection->close = true;
+          connection_done(epoll_fd, connection);
+        } else {
+          errors++;
+          connection_restart(epoll_fd, connection);
+        }
+        continue;
+      }
+      int r = connection_feed(connection, buf, (size_t)n);
+      if (r > 0) {
+        connection_done(epoll_fd, connection);
+      } else if (r < 0) {
+        errors++;
+        connection_restart(epoll_fd, connection);
+      }
+    }
+  }
+  double elapsed = (now_ns() - start) / 1e9;
+
+  for (int i = 0; i < connection_count; i++) close(connections[i].fd);
+  free(connections);
+  close(epoll_fd);
+
+  printf("%d connections, %.1f s: %zu responses, %.0f responses/s, %lu errors\n", connection_count, elapsed,
+         latency_count, latency_count / elapsed, errors);
+  printf("status 2xx %lu, 3xx %lu, 4xx %lu, 5xx %lu, other %lu\n", responses_by_class[2], responses_by_class[3],
+         responses_by_class[4], responses_by_class[5], responses_by_class[0] + responses_by_class[1]);
+  if (latency_count > 0) {
+    qsort(latencies, latency_count, sizeof(double), compare_latencies);
+    printf("latency p50 %.2f ms, p90 %.2f ms, p99 %.2f ms, p99.9 %.2f ms, max %.2f ms\n",
+           latencies[latency_count / 2] / 1e6, latencies[latency_count * 90 / 100] / 1e6,
+           latencies[latency_count * 99 / 100] / 1e6, latencies[latency_count * 999 / 1000] / 1e6,
+           latencies[latency_count - 1] / 1e6);
+  }
+}
+
+// Changes one series per metric and publishes a snapshot every second, as the collection cycle of the exporter does
+static void *updater(void *arg) {
+  prom_gauge_t **gauges = arg;
+  for (unsigned long cycle = 0; !atomic_load(&stop_updater); cycle++) {
+    for (size_t m = 0; gauges[m] != NULL; m++) {
+      char device[16];
+      snprintf(device, sizeof(device), "dev%lu", cycle % SERIES_PER_METRIC);
+      prom_gauge_set(gauges[m], (double)cycle, (const char *[]){device});
+    }
+    if (promhttp_publish_snapshot()) fprintf(stderr, "snapshot not published\n");
+    for (int i = 0; i < 10 && !atomic_load(&stop_updater); i++) usleep(100000);
+  }
+  return NULL;
+}
+
+static bool resolve_target(const char *host, const char *port) {
+  struct addrinfo hints = {.ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM};
+  struct addrinfo *result = NULL;
+  if (getaddrinfo(host, port, &hints, &result) != 0 || result == NULL) return false;
+  memcpy(&target, result->ai_addr, result->ai_addrlen);
+  target_len = result->ai_addrlen;
+  freeaddrinfo(result);
+  return true;
+}
+
+int main(int argc, char **argv) {
+  int connection_count = 500;
+  double seconds = 10;
+  size_t series = 10000;
+  unsigned short port = 18000;
+  bool render = false;
+  bool gzip = false;
+  char *external = NULL;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "c:d:s:p:rzt:")) != -1) {
+    switch (opt) {
+      case 'c':
+        connection_count = atoi(optarg);
+        break;
+      case 'd':
+        seconds = atof(optarg);
+        break;
+      case 's':
+        series = strtoul(optarg, NULL, 10);
+        break;
+      case 'p':
+        port = (unsigned short)atoi(optarg);
+        break;
+      case 'r':
+        render = true;
+        break;
+      case 'z':
+        gzip = true;
+        break;
+      case 't':
+        external = optarg;
+        break;
+      default:
+        fprintf(stderr, "usage: %s [-c connections] [-d seconds] [-s series] [-p port] [-r] [-z] [-t host:port]\n",
+                argv[0]);
+        return EXIT_FAILURE;
+    }
+  }
+  if (connection_count < 1) connection_count = 1;
+
+  char host[256] = "127.0.0.1";
+  char port_str[16];
+  snprintf(port_str, sizeof(port_str), "%hu", port);
+  if (external != NULL) {
+    char *colon = strrchr(external, ':');
+    if (colon == NULL || (size_t)(colon - external) >= sizeof(host)) {
+      fprintf(stderr, "the target must be host:port\n");
+      return EXIT_FAILURE;
+    }
+    memcpy(host, external, (size_t)(colon - external));
+    host[colon - external] = '\0';
+    snprintf(port_str, sizeof(port_str), "%s", colon + 1);
+  }
+  if (!resolve_target(host, port_str)) {
+    fprintf(stderr, "cannot resolve %s:%s\n", host, port_str);
+    return EXIT_FAILURE;
+  }
+  request_len = (size_t)snprintf(request, sizeof(request), "GET /metrics HTTP/1.1\r\nHost: %s\r\n%s\r\n", host,
+                                 gzip ? "Accept-Encoding: gzip\r\n" : "");
+
+  struct MHD_Daemon *daemon = NULL;
+  prom_gauge_t **gauges = NULL;
+  char(*names)[32] = NULL;
+  pthread_t updater_thread;
+  if (external == NULL) {
+    prom_collector_registry_default_init();
+    size_t metric_count = (series + SERIES_PER_METRIC - 1) / SERIES_PER_METRIC;
+    gauges = calloc(metric_count + 1, sizeof(prom_gauge_t *));
+    // Metrics keep the name they are given, it must outlive them
+    names = malloc(metric_count * sizeof(*names));
+    for (size_t m = 0; m < metric_count; m++) {
+      snprintf(names[m], sizeof(names[m]), "load_gauge_%zu", m);
+      gauges[m] = prom_collector_registry_must_register_metric(
+          prom_gauge_new(names[m], "load bench", 1, (const char *[]){"device"}));
+      for (size_t s = 0; s < SERIES_PER_METRIC && m * SERIES_PER_METRIC + s < series; s++) {
+        char device[16];
+        snprintf(device, sizeof(device), "dev%zu", s);
+        prom_gauge_set(gauges[m], (double)s, (const char *[]){device});
+      }
+    }
+    promhttp_set_active_collector_registry(NULL);
+    if (gzip && promhttp_set_compression(1, 0)) fprintf(stderr, "compression not enabled\n");
+
+    promhttp_daemon_config_t config = PROMHTTP_DEFAULT_DAEMON_CONFIG(port);
+    daemon = promhttp_start_daemon_with_config(&config, NULL, NULL);
+    if (daemon == NULL) {
+      fprintf(stderr, "cannot start the daemon on port %hu\n", port);
+      return EXIT_FAILURE;
+    }
+    // The first snapshot is there before the first request
+    if (!render && promhttp_publish_snapshot()) render = true;
+    if (!render && pthread_create(&updater_thread, NULL, updater, gauges) != 0) render = true;
+    printf("serving %zu series on port %hu, %s\n", series, port,
+           render ? "rendering every request" : "publishing a snapshot every second");
+  }
+
+  run_load(connection_count, seconds);
+
+  if (external == NULL) {
+    if (!render) {
+      atomic_store(&stop_updater, true);
+      pthread_join(updater_thread, NULL);
+    }
+    MHD_stop_daemon(daemon);
+    prom_collector_registry_destroy(PROM_COLLECTOR_REGISTRY_DEFAULT);
+    free(gauges);
+    free(names);
+  }
+  free(latencies);
+  return errors == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
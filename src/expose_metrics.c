@@ -1,15 +1,87 @@
 #include "expose_metrics.h"
 
-MemoryStats memory_stats = {0.0};
-CpuStats cpu_stats = {0.0, 0, 0};
-DiskStats disk_stats = {0.0, 0.0};
-NetStats net_stats = {0.0, 0.0};
+promhttp_daemon_config_t http_config = PROMHTTP_DEFAULT_DAEMON_CONFIG(HTTP_DEFAULT_PORT);
 
-pthread_mutex_t lock;
+unsigned int http_compression_level = PROMHTTP_DEFAULT_COMPRESSION_LEVEL;
+
+unsigned int http_compression_min_size = PROMHTTP_DEFAULT_COMPRESSION_MIN_SIZE;
+
+/** HTTP server exposing the metrics, NULL until started */
+static struct MHD_Daemon* http_daemon;
+
+/** Last CPU stats published by the collector */
+static SEQLOCKED(CpuStats) published_cpu_stats = {SEQLOCK_INIT, {0.0, 0, 0}};
+
+/** Last memory stats published by the collector */
+static SEQLOCKED(MemoryStats) published_memory_stats = {SEQLOCK_INIT, {0.0}};
+
+/** Last disk stats published by the collector */
+static SEQLOCKED(DiskStats) published_disk_stats = {SEQLOCK_INIT, {0.0, 0.0}};
+
+/** Last network stats published by the collector */
+static SEQLOCKED(NetStats) published_net_stats = {SEQLOCK_INIT, {0.0, 0.0}};
+
+CpuStats read_cpu_stats()
+{
+    CpuStats stats;
+    SEQLOCK_LOAD(&published_cpu_stats, stats);
+    return stats;
+}
+
+MemoryStats read_memory_stats()
+{
+    MemoryStats stats;
+    SEQLOCK_LOAD(&published_memory_stats, stats);
+    return stats;
+}
+
+DiskStats read_disk_stats()
+{
+    DiskStats stats;
+    SEQLOCK_LOAD(&published_disk_stats, stats);
+    return stats;
+}
+
+NetStats read_net_stats()
+{
+    NetStats stats;
+    SEQLOCK_LOAD(&published_net_stats, stats);
+    return stats;
+}
 
 /** CPU usage metric */
 static prom_gauge_t* cpu_usage_metric;
 
+/** Missed scheduler deadlines metric */
+static prom_counter_t* scheduler_missed_metric;
+
+/** Scheduler lateness metric */
+static prom_gauge_t* scheduler_lateness_metric;
+
+/** Per-core CPU usage metric */
+static prom_gauge_t* cpu_core_usage_metric;
+
+/** Per-core and per-mode CPU time metric */
+static prom_counter_t* cpu_time_metric;
+
+/** Double-buffered CPU time readings, owned by the CPU collector */
+static CpuSnapshot cpu_snapshot;
+
+/**
+ * @def CPU_CORE_SAMPLE_COUNT
+ * @brief Number of metric samples exported per core: usage, then the time of every CpuMode.
+ */
+#define CPU_CORE_SAMPLE_COUNT (1 + CPU_MODE_COUNT)
+
+/** Samples bound to every slot of the CPU snapshot, CPU_CORE_SAMPLE_COUNT per slot, NULL until bound */
+static prom_metric_sample_t** cpu_core_samples;
+
+/** Number of slots of cpu_core_samples */
+static size_t cpu_core_sample_slots;
+
+/** Ticks last exported to every sample of cpu_time_metric, CPU_MODE_COUNT per slot of cpu_core_samples */
+static unsigned long long* cpu_time_exported;
+
 /** Context switches metric */
 static prom_gauge_t* context_switches_metric;
 
@@ -25,126 +97,425 @@ static prom_gauge_t* disk_read_metric;
 /** Write operations per second metric */
 static prom_gauge_t* disk_write_metric;
 
+/** Per-device read operations per second metric */
+static prom_gauge_t* disk_device_read_metric;
+
+/** Per-device write operations per second metric */
+static prom_gauge_t* disk_device_write_metric;
+
+/** Per-device /proc/diskstats field metrics, indexed by DiskField, gauges or counters as their descriptors say */
+static prom_metric_t* disk_field_metrics[DISK_FIELD_COUNT];
+
+/**
+ * @brief Name, help, units and type of the metric of every /proc/diskstats field, indexed by DiskField.
+ *
+ * Every field but the I/Os in progress is cumulative and exported as a counter. Times are reported by the kernel in
+ * milliseconds and exported in seconds.
+ */
+static const struct
+{
+    const char* name;
+    const char* help;
+    double units;
+    bool counter;
+} disk_field_descriptors[DISK_FIELD_COUNT] = {
+    {"disk_reads_completed_total", "Number of reads completed per device", 1.0, true},
+    {"disk_reads_merged_total", "Number of adjacent reads merged per device", 1.0, true},
+    {"disk_read_sectors_total", "Number of sectors read per device", 1.0, true},
+    {"disk_read_time_seconds_total", "Seconds spent reading per device", 1000.0, true},
+    {"disk_writes_completed_total", "Number of writes completed per device", 1.0, true},
+    {"disk_writes_merged_total", "Number of adjacent writes merged per device", 1.0, true},
+    {"disk_written_sectors_total", "Number of sectors written per device", 1.0, true},
+    {"disk_write_time_seconds_total", "Seconds spent writing per device", 1000.0, true},
+    {"disk_io_now", "Number of I/Os in progress per device", 1.0, false},
+    {"disk_io_time_seconds_total", "Seconds spent doing I/Os per device", 1000.0, true},
+    {"disk_io_time_weighted_seconds_total", "Weighted seconds spent doing I/Os per device", 1000.0, true},
+    {"disk_discards_completed_total", "Number of discards completed per device", 1.0, true},
+    {"disk_discards_merged_total", "Number of adjacent discards merged per device", 1.0, true},
+    {"disk_discarded_sectors_total", "Number of sectors discarded per device", 1.0, true},
+    {"disk_discard_time_seconds_total", "Seconds spent discarding per device", 1000.0, true},
+    {"disk_flush_requests_completed_total", "Number of flush requests completed per device", 1.0, true},
+    {"disk_flush_time_seconds_total", "Seconds spent flushing per device", 1000.0, true},
+};
+
+/** Per-device disk state, owned by the disk collector */
+static DiskTable disk_table;
+
 /** Received bytes per second metric */
 static prom_gauge_t* net_rec_bytes_metric;
 
 /** Sent bytes per second metric */
 static prom_gauge_t* net_sen_bytes_metric;
 
-void update_cpu_gauge()
+/** Per-interface received bytes per second metric */
+static prom_gauge_t* net_interface_rec_bytes_metric;
+
+/** Per-interface sent bytes per second metric */
+static prom_gauge_t* net_interface_sen_bytes_metric;
+
+/** Per-interface /proc/net/dev field metrics, indexed by NetField */
+static prom_counter_t* net_field_metrics[NET_FIELD_COUNT];
+
+/** Name and help of the counter of every /proc/net/dev field, all of them cumulative, indexed by NetField */
+static const struct
 {
+    const char* name;
+    const char* help;
+} net_field_descriptors[NET_FIELD_COUNT] = {
+    {"net_receive_bytes_total", "Number of bytes received per interface"},
+    {"net_receive_packets_total", "Number of packets received per interface"},
+    {"net_receive_errs_total", "Number of receive errors per interface"},
+    {"net_receive_drop_total", "Number of received packets dropped per interface"},
+    {"net_receive_fifo_total", "Number of receive FIFO buffer errors per interface"},
+    {"net_receive_frame_total", "Number of receive framing errors per interface"},
+    {"net_receive_compressed_total", "Number of compressed packets received per interface"},
+    {"net_receive_multicast_total", "Number of multicast frames received per interface"},
+    {"net_transmit_bytes_total", "Number of bytes transmitted per interface"},
+    {"net_transmit_packets_total", "Number of packets transmitted per interface"},
+    {"net_transmit_errs_total", "Number of transmit errors per interface"},
+    {"net_transmit_drop_total", "Number of transmitted packets dropped per interface"},
+    {"net_transmit_fifo_total", "Number of transmit FIFO buffer errors per interface"},
+    {"net_transmit_colls_total", "Number of collisions detected per interface"},
+    {"net_transmit_carrier_total", "Number of carrier losses per interface"},
+    {"net_transmit_compressed_total", "Number of compressed packets transmitted per interface"},
+};
+
+/** Per-interface network state, owned by the network collector */
+static NetTable net_table;
+
+/**
+ * @brief Sets a labeled gauge through its bound sample, resolving the labels only the first time.
+ *
+ * @param sample Bound sample, NULL until the first call.
+ * @param gauge Gauge the sample belongs to.
+ * @param labels Label values of the sample, only used to bind it.
+ * @param value New value.
+ */
+static void set_bound_gauge(prom_metric_sample_t** sample, prom_gauge_t* gauge, const char** labels, double value)
+{
+    if (*sample == NULL)
+    {
+        *sample = prom_gauge_with_labels(gauge, labels);
+        if (*sample == NULL)
+        {
+            return;
+        }
+    }
+    prom_metric_sample_set(*sample, value);
+}
+
+/**
+ * @brief Advances a labeled counter through its bound sample so that it follows a cumulative kernel counter, resolving
+ * the labels only the first time.
+ *
+ * The counter grows by the increase since the last exported reading, taken as 0 when the sample is bound so that the
+ * first reading is exported as is. A reading below the last one means that the kernel counter was reset or wrapped:
+ * it is counted from 0 again, so the exported counter never goes down.
+ *
+ * @param sample Bound sample, NULL until the first call.
+ * @param counter Counter the sample belongs to.
+ * @param labels Label values of the sample, only used to bind it.
+ * @param exported Last reading exported to the sample, updated with the new one.
+ * @param reading New reading of the kernel counter.
+ * @param units Kernel units per unit of the counter, e.g. 1000 for milliseconds exported as seconds.
+ */
+static void advance_bound_counter(prom_metric_sample_t** sample, prom_counter_t* counter, const char** labels,
+                                  unsigned long long* exported, unsigned long long reading, double units)
+{
+    if (*sample == NULL)
+    {
+        *sample = prom_counter_with_labels(counter, labels);
+        if (*sample == NULL)
+        {
+            return;
+        }
+        *exported = 0;
+    }
+    // The difference of the converted readings rather than the converted difference: as long as the kernel counter is
+    // not reset the additions telescope, and the sample holds the converted reading instead of an accumulated error
+    double increase = reading >= *exported ? (double)reading / units - (double)*exported / units
+                                           : (double)reading / units;
+    *exported = reading;
+    if (increase > 0)
+    {
+        prom_metric_sample_add(*sample, increase);
+    }
+}
+
+void update_scheduler_metrics(const SchedulerTick* tick)
+{
+    if (tick->missed > 0)
+    {
+        prom_counter_add(scheduler_missed_metric, (double)tick->missed, NULL); // Count the missed deadlines
+    }
+    prom_gauge_set(scheduler_lateness_metric, tick->lateness, NULL); // Update the lateness of the last deadline
+}
+
+/**
+ * @brief Updates the per-core usage and per-mode time metrics from the CPU snapshot.
+ *
+ * Slot 0 of the snapshot is the aggregate line, already exported as cpu_usage_percentage, so only the cores are
+ * labeled. Offline cores keep their last exported values.
+ */
+static void update_cpu_core_gauges()
+{
+    static double ticks_per_second = 0;
+    if (ticks_per_second <= 0)
+    {
+        long clk_tck = sysconf(_SC_CLK_TCK);
+        ticks_per_second = clk_tck > 0 ? (double)clk_tck : 100.0;
+    }
+
+    // Cores only come and go with hotplug, so the bound samples only grow
+    if (cpu_core_sample_slots < cpu_snapshot.slots)
+    {
+        prom_metric_sample_t** grown =
+            realloc(cpu_core_samples, cpu_snapshot.slots * CPU_CORE_SAMPLE_COUNT * sizeof(prom_metric_sample_t*));
+        if (grown == NULL)
+        {
+            perror("Error growing the CPU samples");
+            return;
+        }
+        memset(grown + cpu_core_sample_slots * CPU_CORE_SAMPLE_COUNT, 0,
+               (cpu_snapshot.slots - cpu_core_sample_slots) * CPU_CORE_SAMPLE_COUNT * sizeof(prom_metric_sample_t*));
+        cpu_core_samples = grown;
+
+        // The exported ticks of a sample are only read once it is bound, no need to clear them
+        unsigned long long* exported =
+            realloc(cpu_time_exported, cpu_snapshot.slots * CPU_MODE_COUNT * sizeof(unsigned long long));
+        if (exported == NULL)
+        {
+            perror("Error growing the CPU samples");
+            return;
+        }
+        cpu_time_exported = exported;
+        cpu_core_sample_slots = cpu_snapshot.slots;
+    }
+
+    const CpuTimes* times = &cpu_snapshot.buffers[cpu_snapshot.current];
+    for (size_t slot = 1; slot < cpu_snapshot.slots; slot++)
+    {
+        if (!cpu_snapshot.online[slot])
+        {
+            continue;
+        }
+        prom_metric_sample_t** samples = &cpu_core_samples[slot * CPU_CORE_SAMPLE_COUNT];
+
+        // The label is only needed to bind the samples, once every sample is bound nothing is formatted
+        char cpu_label[SHORT_BUFFER_SIZE] = "";
+        for (int sample = 0; sample < CPU_CORE_SAMPLE_COUNT; sample++)
+        {
+            if (samples[sample] == NULL)
+            {
+                snprintf(cpu_label, sizeof(cpu_label), "%zu", slot - 1);
+                break;
+            }
+        }
+
+        const char* core_labels[] = {cpu_label};
+        set_bound_gauge(&samples[0], cpu_core_usage_metric, core_labels, cpu_snapshot.usage[slot]);
+
+        for (int mode = 0; mode < CPU_MODE_COUNT; mode++)
+        {
+            const char* mode_labels[] = {cpu_label, cpu_mode_names[mode]};
+            advance_bound_counter(&samples[1 + mode], cpu_time_metric, mode_labels,
+                                  &cpu_time_exported[slot * CPU_MODE_COUNT + mode], times->ticks[mode][slot],
+                                  ticks_per_second);
+        }
+    }
+}
+
+void update_cpu_gauge(const CollectionContext* context)
+{
+    (void)context; // /proc/stat counters are cumulative, no time needed
     if (!metrics_state.cpu)
     {
         return;
     }
-    pthread_mutex_lock(&lock);                                           // Lock the mutex
-    cpu_stats = get_cpu_stats(); // Get the CPU usage percentage, the number of running processes and context switches
+    CpuStats cpu_stats = get_cpu_stats(&cpu_snapshot); // Get the CPU usage percentage, the number of running
+                                                       // processes and context switches, outside any lock
     if (cpu_stats.cpu_usage >= 0 && cpu_stats.procs_running >= 0 && cpu_stats.ctxt >= 0)
     {
+        SEQLOCK_PUBLISH(&published_cpu_stats, cpu_stats);                   // Publish for the readers
         prom_gauge_set(cpu_usage_metric, cpu_stats.cpu_usage, NULL);         // Update the CPU usage
         prom_gauge_set(context_switches_metric, cpu_stats.ctxt, NULL);       // Update the number of context switches
         prom_gauge_set(procs_running_metric, cpu_stats.procs_running, NULL); // Update the number of running processes
+        update_cpu_core_gauges();                                            // Update the per-core metrics
     }
     else
     {
         fprintf(stderr, "Error obtaining CPU stats\n");
     }
-    pthread_mutex_unlock(&lock);                                         // Unlock the mutex
 }
 
-void update_memory_gauge()
+void update_memory_gauge(const CollectionContext* context)
 {
+    (void)context; // Memory usage is instantaneous, no time needed
     if (!metrics_state.memory)
     {
         return;
     }
-    pthread_mutex_lock(&lock);
-    memory_stats = get_memory_usage();
+    MemoryStats memory_stats = get_memory_usage();
     if (memory_stats.usage >= 0)
     {
+        SEQLOCK_PUBLISH(&published_memory_stats, memory_stats);
         prom_gauge_set(memory_usage_metric, memory_stats.usage, NULL);
     }
     else
     {
         fprintf(stderr, "Error al obtener el uso de memoria\n");
     }
-    pthread_mutex_unlock(&lock);
 }
 
-void update_disk_gauge()
+/**
+ * @brief Updates the per-device metrics from the disk table.
+ *
+ * Only devices that pass the disk filter are exported, and only the fields their kernel reports. Devices missing from
+ * the last reading have their samples removed and their state dropped, so that unplugged or detached devices do not
+ * keep exporting stale values.
+ */
+static void update_disk_device_gauges()
+{
+    for (size_t slot = 0; slot < disk_table.count; slot++)
+    {
+        DiskDevice* device = &disk_table.devices[slot];
+        const char* labels[] = {device->name};
+        if (!device->seen)
+        {
+            // Removing the samples frees them, only the bound ones were ever exported
+            if (device->samples[0] != NULL)
+            {
+                prom_metric_remove_sample(disk_device_read_metric, labels);
+            }
+            if (device->samples[1] != NULL)
+            {
+                prom_metric_remove_sample(disk_device_write_metric, labels);
+            }
+            for (int field = 0; field < DISK_FIELD_COUNT; field++)
+            {
+                if (device->samples[2 + field] != NULL)
+                {
+                    prom_metric_remove_sample(disk_field_metrics[field], labels);
+                }
+            }
+            memset(device->samples, 0, sizeof(device->samples));
+            continue;
+        }
+        if (!device->accepted || device->field_count == 0)
+        {
+            continue;
+        }
+        set_bound_gauge(&device->samples[0], disk_device_read_metric, labels, device->rps);
+        set_bound_gauge(&device->samples[1], disk_device_write_metric, labels, device->wps);
+        for (size_t field = 0; field < device->field_count; field++)
+        {
+            if (disk_field_descriptors[field].counter)
+            {
+                advance_bound_counter(&device->samples[2 + field], disk_field_metrics[field], labels,
+                                      &device->exported[field], device->fields[field],
+                                      disk_field_descriptors[field].units);
+            }
+            else
+            {
+                set_bound_gauge(&device->samples[2 + field], disk_field_metrics[field], labels,
+                                (double)device->fields[field] / disk_field_descriptors[field].units);
+            }
+        }
+    }
+    disk_table_prune(&disk_table);
+}
+
+void update_disk_gauge(const CollectionContext* context)
 {
     if (!metrics_state.disk)
     {
         return;
     }
-    pthread_mutex_lock(&lock);                               // Lock the mutex
-    disk_stats = get_disk_stats(); // Get the number of read and write operations per second
+    DiskStats disk_stats = get_disk_stats(&disk_table, context); // Get the number of read and write operations per
+                                                                 // second
     if (disk_stats.rps >= 0 && disk_stats.wps >= 0)
     {
+        SEQLOCK_PUBLISH(&published_disk_stats, disk_stats);      // Publish for the readers
         prom_gauge_set(disk_read_metric, disk_stats.rps, NULL);  // Update the number of read operations per second
         prom_gauge_set(disk_write_metric, disk_stats.wps, NULL); // Update the number of write operations per second
+        update_disk_device_gauges();                             // Update the per-device metrics
     }
     else
     {
         fprintf(stderr, "Error obtaining disk stats\n");
     }
-    pthread_mutex_unlock(&lock);                             // Unlock the mutex
 }
 
-void update_net_gauge()
+/**
+ * @brief Updates the per-interface metrics from the network table.
+ *
+ * Interfaces missing from the last reading have their samples removed and their state dropped, so that container
+ * interfaces coming and going do not accumulate.
+ */
+static void update_net_interface_gauges()
+{
+    for (size_t slot = 0; slot < net_table.count; slot++)
+    {
+        NetInterface* interface = &net_table.interfaces[slot];
+        const char* labels[] = {interface->name};
+        if (!interface->seen)
+        {
+            // Removing the samples frees them, drop the bound handles along with them
+            prom_metric_remove_sample(net_interface_rec_bytes_metric, labels);
+            prom_metric_remove_sample(net_interface_sen_bytes_metric, labels);
+            for (int field = 0; field < NET_FIELD_COUNT; field++)
+            {
+                prom_metric_remove_sample(net_field_metrics[field], labels);
+            }
+            memset(interface->samples, 0, sizeof(interface->samples));
+            continue;
+        }
+        set_bound_gauge(&interface->samples[0], net_interface_rec_bytes_metric, labels, interface->rx_bytesps);
+        set_bound_gauge(&interface->samples[1], net_interface_sen_bytes_metric, labels, interface->tx_bytesps);
+        for (int field = 0; field < NET_FIELD_COUNT; field++)
+        {
+            advance_bound_counter(&interface->samples[2 + field], net_field_metrics[field], labels,
+                                  &interface->exported[field], interface->fields[field], 1.0);
+        }
+    }
+    net_table_prune(&net_table);
+}
+
+void update_net_gauge(const CollectionContext* context)
 {
     if (!metrics_state.network)
     {
         return;
     }
-    pthread_mutex_lock(&lock); // Lock the mutex
-    net_stats = get_net_stats(); // Get the number of received and sent bytes per second
+    NetStats net_stats = get_net_stats(&net_table, context); // Get the number of received and sent bytes per second
     if (net_stats.rec_bytesps >= 0 && net_stats.sen_bytesps >= 0)
     {
+        SEQLOCK_PUBLISH(&published_net_stats, net_stats); // Publish for the readers
         prom_gauge_set(net_rec_bytes_metric, net_stats.rec_bytesps,
                        NULL); // Update the number of received bytes per second
         prom_gauge_set(net_sen_bytes_metric, net_stats.sen_bytesps, NULL); // Update the number of sent bytes per second
+        update_net_interface_gauges(); // Update the per-interface metrics
     }
     else
     {
         fprintf(stderr, "Error obtaining network stats\n");
     }
-    pthread_mutex_unlock(&lock);                                       // Unlock the mutex
 }
 
-void* expose_metrics(void* arg)
+int expose_metrics()
 {
-    (void)arg; // Argumento no utilizado
-    // Aseguramos que el manejador HTTP esté adjunto al registro por defecto
-    promhttp_set_active_collector_registry(NULL);
-    // Iniciamos el servidor HTTP en el puerto 8000
-    struct MHD_Daemon* daemon = promhttp_start_daemon(MHD_USE_SELECT_INTERNALLY, 8000, NULL, NULL);
-    if (daemon == NULL)
-    {
-        fprintf(stderr, "Error al iniciar el servidor HTTP\n");
-        return NULL;
-    }
-
-    // Mantenemos el servidor en ejecución
-    while (1)
+    // El servidor atiende las conexiones desde sus propios hilos
+    http_daemon = promhttp_start_daemon_with_config(&http_config, NULL, NULL);
+    if (http_daemon == NULL)
     {
-        sleep(1);
+        fprintf(stderr, "Error al iniciar el servidor HTTP en el puerto %hu\n", http_config.port);
+        return -1;
     }
-
-    // Nunca debería llegar aquí
-    MHD_stop_daemon(daemon);
-    return NULL;
+    return 0;
 }
 
 void init_metrics()
 {
-    // Inicializamos el mutex
-    if (pthread_mutex_init(&lock, NULL) != 0)
-    {
-        fprintf(stderr, "Error al inicializar el mutex\n");
-        return;
-    }
-
     // Inicializamos el registro de coleccionistas de Prometheus
     if (prom_collector_registry_default_init() != 0)
     {
@@ -152,6 +523,29 @@ void init_metrics()
         return;
     }
 
+    // Aseguramos que el manejador HTTP esté adjunto al registro por defecto, antes de publicar o servir métricas
+    promhttp_set_active_collector_registry(NULL);
+    // Comprimir /metrics para los clientes que lo acepten, con el nivel configurado
+    if (promhttp_set_compression((int)http_compression_level, http_compression_min_size) != 0)
+    {
+        fprintf(stderr, "Error al habilitar la compresión de /metrics con nivel %u\n", http_compression_level);
+    }
+
+    // Creates the self-metrics of the scheduler in a volatile collector of their own: the lateness changes with every
+    // tick and would otherwise change the ETag of /metrics on every collection
+    scheduler_missed_metric =
+        prom_counter_new("scheduler_missed_deadlines", "Number of sampling deadlines missed", 0, NULL);
+    scheduler_lateness_metric = prom_gauge_new("scheduler_lateness_seconds",
+                                               "Seconds between the last sampling deadline and the wake up", 0, NULL);
+    prom_collector_t* scheduler_collector = prom_collector_new("scheduler");
+    if (scheduler_collector == NULL || prom_collector_add_metric(scheduler_collector, scheduler_missed_metric) != 0 ||
+        prom_collector_add_metric(scheduler_collector, scheduler_lateness_metric) != 0 ||
+        prom_collector_set_volatile(scheduler_collector, true) != 0 ||
+        prom_collector_registry_register_collector(PROM_COLLECTOR_REGISTRY_DEFAULT, scheduler_collector) != 0)
+    {
+        fprintf(stderr, "Error al registrar las métricas del planificador\n");
+    }
+
     if (metrics_state.memory)
     {
         // Creamos la métrica para el uso de memoria
@@ -168,6 +562,23 @@ void init_metrics()
         // Creates and registers the metric for disk write operations
         disk_write_metric = prom_collector_registry_must_register_metric(
             prom_gauge_new("disk_write_operations", "Number of writing operations per second", 0, NULL));
+
+        // Creates and registers the per-device metrics
+        disk_device_read_metric = prom_collector_registry_must_register_metric(
+            prom_gauge_new("disk_device_read_operations", "Number of reading operations per second per device", 1,
+                           (const char*[]){"device"}));
+        disk_device_write_metric = prom_collector_registry_must_register_metric(
+            prom_gauge_new("disk_device_write_operations", "Number of writing operations per second per device", 1,
+                           (const char*[]){"device"}));
+        for (int field = 0; field < DISK_FIELD_COUNT; field++)
+        {
+            const char* name = disk_field_descriptors[field].name;
+            const char* help = disk_field_descriptors[field].help;
+            disk_field_metrics[field] = prom_collector_registry_must_register_metric(
+                disk_field_descriptors[field].counter ? prom_counter_new(name, help, 1, (const char*[]){"device"})
+                                                      : prom_gauge_new(name, help, 1, (const char*[]){"device"}));
+        }
+        disk_table_init(&disk_table);
     }
 
     if (metrics_state.cpu)
@@ -176,6 +587,13 @@ void init_metrics()
         cpu_usage_metric = prom_collector_registry_must_register_metric(
             prom_gauge_new("cpu_usage_percentage", "Percentage of CPU usage", 0, NULL));
 
+        // Creates and registers the per-core metrics
+        cpu_core_usage_metric = prom_collector_registry_must_register_metric(prom_gauge_new(
+            "cpu_core_usage_percentage", "Percentage of CPU usage per core", 1, (const char*[]){"cpu"}));
+        cpu_time_metric = prom_collector_registry_must_register_metric(prom_counter_new(
+            "cpu_seconds_total", "Seconds spent by each core in each mode", 2, (const char*[]){"cpu", "mode"}));
+        cpu_snapshot_init(&cpu_snapshot);
+
         // Creates and registers the metric for context switches
         context_switches_metric = prom_collector_registry_must_register_metric(
             prom_gauge_new("context_switches", "Number of context switches", 0, NULL));
@@ -194,10 +612,44 @@ void init_metrics()
         // Creates and registers the metric for sent bytes per second
         net_sen_bytes_metric = prom_collector_registry_must_register_metric(
             prom_gauge_new("net_sent_bytes", "Number of sent bytes per second", 0, NULL));
+
+        // Creates and registers the per-interface metrics
+        net_interface_rec_bytes_metric = prom_collector_registry_must_register_metric(
+            prom_gauge_new("net_interface_received_bytes", "Number of received bytes per second per interface", 1,
+                           (const char*[]){"interface"}));
+        net_interface_sen_bytes_metric = prom_collector_registry_must_register_metric(
+            prom_gauge_new("net_interface_sent_bytes", "Number of sent bytes per second per interface", 1,
+                           (const char*[]){"interface"}));
+        for (int field = 0; field < NET_FIELD_COUNT; field++)
+        {
+            net_field_metrics[field] = prom_collector_registry_must_register_metric(prom_counter_new(
+                net_field_descriptors[field].name, net_field_descriptors[field].help, 1, (const char*[]){"interface"}));
+        }
+        net_table_init(&net_table);
     }
 }
 
-void destroy_mutex()
+void publish_metrics()
 {
-    pthread_mutex_destroy(&lock);
+    if (promhttp_publish_snapshot() != 0)
+    {
+        fprintf(stderr, "Error al publicar las métricas\n");
+    }
+}
+
+void destroy_metrics()
+{
+    if (http_daemon != NULL)
+    {
+        MHD_stop_daemon(http_daemon); // No request is served past this point
+        http_daemon = NULL;
+    }
+    cpu_snapshot_destroy(&cpu_snapshot);
+    free(cpu_core_samples);
+    cpu_core_samples = NULL;
+    free(cpu_time_exported);
+    cpu_time_exported = NULL;
+    cpu_core_sample_slots = 0;
+    disk_table_destroy(&disk_table);
+    net_table_destroy(&net_table);
 }
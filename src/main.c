@@ -4,6 +4,7 @@
  */
 
 #include "expose_metrics.h"
+#include "timer_wheel.h"
 #include <cjson/cJSON.h>
 #include <fcntl.h>
 #include <signal.h>
@@ -19,13 +20,51 @@ volatile sig_atomic_t write_fifo_flag = 0;
 void signal_handler(int signo);
 void write_active_metrics_to_fifo();
 void load_config(const char* filename);
+void load_disk_filter_patterns(cJSON* patterns, char (*out)[SHORT_BUFFER_SIZE], size_t* count);
+void load_http_config(const cJSON* http);
+int parse_interval(const cJSON* item, unsigned long long* interval_ns);
+unsigned long long gcd(unsigned long long a, unsigned long long b);
 char* abs_path(const char* path);
 
+/**
+ * @struct Collector
+ * @brief A metric collector run periodically by the main loop.
+ */
+typedef struct
+{
+    const char* name;                                 /**< Name of the collector in config.json. */
+    void (*update)(const CollectionContext* context); /**< Collects and publishes the metrics. */
+    const bool* enabled;                              /**< Whether the collector is enabled. */
+    bool* due;                                        /**< Set while the collector is due in the current cycle. */
+    unsigned long long interval_ns;                   /**< Own sampling interval, 0 to use the default one. */
+    TimerWheelEntry entry;                            /**< Schedule of the collector. */
+} Collector;
+
+/**
+ * @brief Collectors due in the current cycle, whose /proc files are read ahead as one batch.
+ */
+static MetricsState due_state;
 
 /**
- * @brief Time to sleep between metric updates.
+ * @brief Collectors known to the main loop.
  */
-int SLEEP_TIME = 1;
+Collector collectors[] = {
+    {"cpu", update_cpu_gauge, &metrics_state.cpu, &due_state.cpu, 0},
+    {"memory", update_memory_gauge, &metrics_state.memory, &due_state.memory, 0},
+    {"disk", update_disk_gauge, &metrics_state.disk, &due_state.disk, 0},
+    {"network", update_net_gauge, &metrics_state.network, &due_state.network, 0},
+};
+
+/**
+ * @def COLLECTOR_COUNT
+ * @brief Number of collectors known to the main loop.
+ */
+#define COLLECTOR_COUNT (sizeof(collectors) / sizeof(collectors[0]))
+
+/**
+ * @brief Default time between metric updates, in nanoseconds.
+ */
+unsigned long long sampling_interval_ns = NANOSECONDS_PER_SECOND;
 
 /**
  * \brief Main function of the application.
@@ -38,6 +77,7 @@ int main(int argc, char* argv[])
     char* absolute_path = abs_path(JSON_PATH);
     load_config(absolute_path);
     free(absolute_path);
+    open_proc_files(); // Open the /proc files of the enabled metrics once
 
     if (access(FIFO_PATH, F_OK) == -1) {
         if (mkfifo(FIFO_PATH, 0666) == -1) {
@@ -57,33 +97,99 @@ int main(int argc, char* argv[])
         return EXIT_FAILURE;
     }
 
-    // Creamos un hilo para exponer las métricas vía HTTP
-    init_metrics(); // Initialize mutex and metrics
+    init_metrics(); // Initialize metrics
 
-    pthread_t tid;
-    if (pthread_create(&tid, NULL, expose_metrics, NULL) != 0) // Successfull thread creation returns 0
+    // Exponemos las métricas vía HTTP, el servidor corre en sus propios hilos
+    if (expose_metrics() != 0)
     {
-        fprintf(stderr, "Error al crear el hilo del servidor HTTP\n");
         unlink(FIFO_PATH); // Limpiar la FIFO en caso de error
         return EXIT_FAILURE;
     }
 
-    // Bucle principal para actualizar las métricas cada segundo
+    // The scheduler ticks at the greatest common divisor of the intervals, so every interval is a whole number of ticks
+    unsigned long long tick_ns = 0;
+    for (size_t i = 0; i < COLLECTOR_COUNT; i++)
+    {
+        if (collectors[i].interval_ns == 0)
+        {
+            collectors[i].interval_ns = sampling_interval_ns;
+        }
+        if (*collectors[i].enabled)
+        {
+            tick_ns = gcd(tick_ns, collectors[i].interval_ns);
+        }
+    }
+    if (tick_ns == 0)
+    {
+        tick_ns = sampling_interval_ns; // No collector enabled, only the FIFO is served
+    }
+
+    Scheduler scheduler;
+    if (scheduler_init(&scheduler, tick_ns) != 0)
+    {
+        fprintf(stderr, "Error al iniciar el planificador\n");
+        unlink(FIFO_PATH);
+        return EXIT_FAILURE;
+    }
+
+    // Every enabled collector runs on the first tick and then once per interval
+    TimerWheel wheel;
+    timer_wheel_init(&wheel);
+    for (size_t i = 0; i < COLLECTOR_COUNT; i++)
+    {
+        if (*collectors[i].enabled)
+        {
+            timer_wheel_add(&wheel, &collectors[i].entry, collectors[i].interval_ns / tick_ns, 1, &collectors[i]);
+        }
+    }
+
+    // Bucle principal para actualizar las métricas en cada deadline del planificador
+    CollectionContext context;
+    SchedulerTick tick;
     while (true)
     {
-        update_cpu_gauge();
-        update_memory_gauge();
-        update_disk_gauge();
-        update_net_gauge();
+        int r = scheduler_wait(&scheduler, &tick);
+        if (r < 0)
+        {
+            break;
+        }
+
+        // r == 1: woken up by SIGUSR1, only the FIFO has to be served
+        if (r == 0)
+        {
+            update_scheduler_metrics(&tick);
+
+            // Collectors due on the same tick run as one batch sharing a single clock snapshot
+            TimerWheelEntry* due = timer_wheel_advance(&wheel, tick.missed + 1);
+            if (due != NULL && collection_context_begin(&context) == 0)
+            {
+                due_state = (MetricsState){false, false, false, false};
+                for (TimerWheelEntry* entry = due; entry != NULL; entry = entry->due_next)
+                {
+                    *((Collector*)entry->data)->due = true;
+                }
+                prefetch_proc_files(&due_state);
+
+                for (TimerWheelEntry* entry = due; entry != NULL; entry = entry->due_next)
+                {
+                    ((Collector*)entry->data)->update(&context);
+                }
+
+                // /metrics serves what is rendered here until collectors run again, ticks with nothing due leave
+                // the snapshot as it is instead of rendering and compressing the same data again
+                publish_metrics();
+            }
+        }
 
         if (write_fifo_flag) {
             write_active_metrics_to_fifo();
             write_fifo_flag = 0;
         }
-
-        sleep(SLEEP_TIME);
     }
 
+    scheduler_destroy(&scheduler);
+    destroy_metrics();
+    close_proc_files();
     unlink(FIFO_PATH); // Eliminar la FIFO al salir
     return EXIT_SUCCESS;
 }
@@ -115,11 +221,38 @@ void load_config(const char* filename)
         return;
     }
 
-    // Leer el intervalo de muestreo
+    // Leer el intervalo de muestreo: uno para todos, o un objeto con uno por colector y "default" para el resto
     cJSON* interval = cJSON_GetObjectItem(config, "sampling_interval");
-    if (cJSON_IsNumber(interval))
+    if (cJSON_IsObject(interval))
     {
-        SLEEP_TIME = interval->valueint;
+        cJSON* item = NULL;
+        cJSON_ArrayForEach(item, interval)
+        {
+            unsigned long long* target = NULL;
+            if (strcmp(item->string, "default") == 0)
+            {
+                target = &sampling_interval_ns;
+            }
+            for (size_t i = 0; i < COLLECTOR_COUNT && target == NULL; i++)
+            {
+                if (strcmp(item->string, collectors[i].name) == 0)
+                {
+                    target = &collectors[i].interval_ns;
+                }
+            }
+            if (target == NULL)
+            {
+                fprintf(stderr, "sampling_interval: colector desconocido \"%s\"\n", item->string);
+            }
+            else if (parse_interval(item, target) != 0)
+            {
+                fprintf(stderr, "sampling_interval inválido para \"%s\", se usa el valor por defecto\n", item->string);
+            }
+        }
+    }
+    else if (interval != NULL && parse_interval(interval, &sampling_interval_ns) != 0)
+    {
+        fprintf(stderr, "sampling_interval inválido, se usa el valor por defecto\n");
     }
 
     // Leer las métricas habilitadas
@@ -157,9 +290,165 @@ void load_config(const char* filename)
         }
     }
 
+    // Leer el filtro de discos
+    cJSON* filter = cJSON_GetObjectItem(config, "disk_filter");
+    if (cJSON_IsObject(filter))
+    {
+        cJSON* partitions = cJSON_GetObjectItem(filter, "partitions");
+        if (cJSON_IsBool(partitions))
+        {
+            disk_filter.partitions = cJSON_IsTrue(partitions);
+        }
+        load_disk_filter_patterns(cJSON_GetObjectItem(filter, "include"), disk_filter.include,
+                                  &disk_filter.include_count);
+        load_disk_filter_patterns(cJSON_GetObjectItem(filter, "exclude"), disk_filter.exclude,
+                                  &disk_filter.exclude_count);
+    }
+
+    // Leer la configuración del servidor HTTP
+    load_http_config(cJSON_GetObjectItem(config, "http"));
+
     cJSON_Delete(config);
 }
 
+/**
+ * @brief Reads an array of device name prefixes of the disk filter.
+ *
+ * Leaves the patterns untouched if the item is not an array. Extra patterns and patterns longer than a device name
+ * are ignored.
+ *
+ * @param patterns JSON array of strings.
+ * @param out Array receiving the patterns.
+ * @param count Set to the number of patterns read.
+ */
+void load_disk_filter_patterns(cJSON* patterns, char (*out)[SHORT_BUFFER_SIZE], size_t* count)
+{
+    if (!cJSON_IsArray(patterns))
+    {
+        return;
+    }
+
+    *count = 0;
+    cJSON* pattern = NULL;
+    cJSON_ArrayForEach(pattern, patterns)
+    {
+        if (cJSON_IsString(pattern) && *count < DISK_FILTER_MAX_PATTERNS &&
+            strlen(pattern->valuestring) < SHORT_BUFFER_SIZE)
+        {
+            strcpy(out[*count], pattern->valuestring);
+            (*count)++;
+        }
+    }
+}
+
+/**
+ * @brief Reads the serving configuration of the HTTP server into http_config.
+ *
+ * Leaves the configuration untouched if the item is not an object. Missing settings keep their defaults, invalid ones
+ * are reported and ignored.
+ *
+ * @param http JSON object with the settings.
+ */
+void load_http_config(const cJSON* http)
+{
+    if (!cJSON_IsObject(http))
+    {
+        return;
+    }
+
+    cJSON* epoll = cJSON_GetObjectItem(http, "epoll");
+    if (cJSON_IsBool(epoll))
+    {
+        http_config.epoll = cJSON_IsTrue(epoll);
+    }
+
+    unsigned int port = http_config.port;
+    const struct
+    {
+        const char* name;
+        unsigned int* value;
+        double min;
+        double max;
+    } settings[] = {
+        {"port", &port, 1, 65535},
+        {"thread_pool_size", &http_config.thread_pool_size, 0, 1024},
+        {"connection_limit", &http_config.connection_limit, 0, 1000000},
+        {"per_ip_connection_limit", &http_config.per_ip_connection_limit, 0, 1000000},
+        {"connection_timeout", &http_config.connection_timeout, 0, 86400},
+        {"listen_backlog", &http_config.listen_backlog, 0, 1000000},
+        {"compression_level", &http_compression_level, 0, PROMHTTP_MAX_COMPRESSION_LEVEL},
+        {"compression_min_size", &http_compression_min_size, 0, PROMHTTP_STREAM_BLOCK_SIZE},
+    };
+    for (size_t i = 0; i < sizeof(settings) / sizeof(settings[0]); i++)
+    {
+        cJSON* item = cJSON_GetObjectItem(http, settings[i].name);
+        if (item == NULL)
+        {
+            continue;
+        }
+        if (cJSON_IsNumber(item) && item->valuedouble >= settings[i].min && item->valuedouble <= settings[i].max &&
+            item->valuedouble == (unsigned int)item->valuedouble)
+        {
+            *settings[i].value = (unsigned int)item->valuedouble;
+        }
+        else
+        {
+            fprintf(stderr, "http.%s inválido, se usa el valor por defecto\n", settings[i].name);
+        }
+    }
+    http_config.port = (unsigned short)port;
+}
+
+/**
+ * @brief Reads a sampling interval from the configuration.
+ *
+ * @param item Number of seconds, or a duration string like "250ms".
+ * @param interval_ns Set to the interval in nanoseconds, rounded to a multiple of SCHEDULER_MIN_INTERVAL_NS, on
+ * success.
+ * @return 0 on success, -1 if the item is not a valid interval.
+ */
+int parse_interval(const cJSON* item, unsigned long long* interval_ns)
+{
+    unsigned long long ns;
+    if (cJSON_IsNumber(item) && item->valuedouble > 0 && item->valuedouble < 1e9)
+    {
+        ns = (unsigned long long)(item->valuedouble * NANOSECONDS_PER_SECOND + 0.5);
+    }
+    else if (!cJSON_IsString(item) || scheduler_parse_duration(item->valuestring, &ns) != 0)
+    {
+        return -1;
+    }
+
+    if (ns == 0)
+    {
+        return -1;
+    }
+
+    // Whole scheduler ticks keep the common tick of the collectors from collapsing, e.g. 250ms and 333ms would
+    // otherwise wake the loop every millisecond. Shorter intervals are sampled as often as the scheduler allows.
+    ns = (ns + SCHEDULER_MIN_INTERVAL_NS / 2) / SCHEDULER_MIN_INTERVAL_NS * SCHEDULER_MIN_INTERVAL_NS;
+    *interval_ns = ns > 0 ? ns : SCHEDULER_MIN_INTERVAL_NS;
+    return 0;
+}
+
+/**
+ * @brief Greatest common divisor, gcd(0, b) is b.
+ *
+ * @param a First number.
+ * @param b Second number.
+ * @return The greatest common divisor of a and b.
+ */
+unsigned long long gcd(unsigned long long a, unsigned long long b)
+{
+    while (b != 0)
+    {
+        unsigned long long r = a % b;
+        a = b;
+        b = r;
+    }
+    return a;
+}
+
 void signal_handler(int signo) {
     write_fifo_flag = 1;
 }
@@ -169,6 +458,12 @@ void write_active_metrics_to_fifo()
     char buffer[BUFFER_SIZE];
     int offset = 0;
 
+    // Consistent copies of the last published stats, the collector is never blocked by this
+    CpuStats cpu_stats = read_cpu_stats();
+    MemoryStats memory_stats = read_memory_stats();
+    DiskStats disk_stats = read_disk_stats();
+    NetStats net_stats = read_net_stats();
+
     // Verificar qué métricas están activas y agregar al buffer
     if (metrics_state.cpu)
     {
@@ -1,37 +1,116 @@
 #include "metrics.h"
+#include "proc_parse.h"
 
 MetricsState metrics_state = {true, true, true, true};
 
+DiskFilter disk_filter = {false, 0, 2, {{0}}, {"loop", "ram"}};
+
+/** Persistent handle to /proc/meminfo */
+static ProcFile meminfo_file = PROC_FILE_INIT(PROC_MEMINFO_PATH);
+
+/** Persistent handle to /proc/stat */
+static ProcFile stat_file = PROC_FILE_INIT(PROC_STAT_PATH);
+
+/** Persistent handle to /proc/diskstats */
+static ProcFile diskstats_file = PROC_FILE_INIT(PROC_DISKSTATS_PATH);
+
+/** Persistent handle to /proc/net/dev */
+static ProcFile net_dev_file = PROC_FILE_INIT(PROC_NET_DEV_PATH);
+
+void open_proc_files()
+{
+    // A file that fails to open here is opened again on its first read
+    if (metrics_state.memory)
+    {
+        procfs_open(&meminfo_file);
+    }
+    if (metrics_state.cpu)
+    {
+        procfs_open(&stat_file);
+    }
+    if (metrics_state.disk)
+    {
+        procfs_open(&diskstats_file);
+    }
+    if (metrics_state.network)
+    {
+        procfs_open(&net_dev_file);
+    }
+}
+
+void prefetch_proc_files(const MetricsState* due)
+{
+    ProcFile* files[PROCFS_BATCH_MAX];
+    size_t count = 0;
+    if (due->memory)
+    {
+        files[count++] = &meminfo_file;
+    }
+    if (due->cpu)
+    {
+        files[count++] = &stat_file;
+    }
+    if (due->disk)
+    {
+        files[count++] = &diskstats_file;
+    }
+    if (due->network)
+    {
+        files[count++] = &net_dev_file;
+    }
+    if (count > 0)
+    {
+        procfs_prefetch(files, count);
+    }
+}
+
+void close_proc_files()
+{
+    procfs_prefetch_shutdown();
+    procfs_close(&meminfo_file);
+    procfs_close(&stat_file);
+    procfs_close(&diskstats_file);
+    procfs_close(&net_dev_file);
+}
+
+int collection_context_begin(CollectionContext* context)
+{
+    struct timespec now;
+    if (clock_gettime(CLOCK_MONOTONIC, &now) != 0)
+    {
+        perror("Error reading the monotonic clock");
+        return -1;
+    }
+    context->now_ns = (unsigned long long)now.tv_sec * NANOSECONDS_PER_SECOND + (unsigned long long)now.tv_nsec;
+    return 0;
+}
+
 MemoryStats get_memory_usage()
 {
-    FILE* fp;
-    char buffer[BUFFER_SIZE];
+    ProcView view;
     unsigned long long total_mem = 0, free_mem = 0;
     MemoryStats stats = {-1.0}; // Initialize to -1.0 in case of error
 
-    // Abrir el archivo /proc/meminfo
-    fp = fopen("/proc/meminfo", "r");
-    if (fp == NULL)
+    // Releer /proc/meminfo
+    if (procfs_read(&meminfo_file, &view) != 0)
     {
-        perror("Error al abrir /proc/meminfo");
         return stats;
     }
 
     // Leer los valores de memoria total y disponible
-    while (fgets(buffer, sizeof(buffer), fp) != NULL)
+    for (const char* line = view.data; line != NULL; line = procfs_next_line(line, view.end))
     {
-        if (sscanf(buffer, "MemTotal: %llu kB", &total_mem) == 1)
+        const char* value;
+        if (PARSE_KEY(line, view.end, "MemTotal:", &value) && parse_u64(&value, view.end, &total_mem))
         {
             continue; // MemTotal encontrado
         }
-        if (sscanf(buffer, "MemAvailable: %llu kB", &free_mem) == 1)
+        if (PARSE_KEY(line, view.end, "MemAvailable:", &value) && parse_u64(&value, view.end, &free_mem))
         {
             break; // MemAvailable encontrado, podemos dejar de leer
         }
     }
 
-    fclose(fp);
-
     // Verificar si se encontraron ambos valores
     if (total_mem == 0 || free_mem == 0)
     {
@@ -46,196 +125,787 @@ MemoryStats get_memory_usage()
     return stats;
 }
 
-CpuStats get_cpu_stats()
+const char* const cpu_mode_names[CPU_MODE_COUNT] = {"user", "nice",    "system", "idle",
+                                                     "iowait", "irq", "softirq", "steal"};
+
+void cpu_snapshot_init(CpuSnapshot* snapshot)
+{
+    memset(snapshot, 0, sizeof(*snapshot));
+}
+
+void cpu_snapshot_destroy(CpuSnapshot* snapshot)
+{
+    for (int b = 0; b < 2; b++)
+    {
+        for (int m = 0; m < CPU_MODE_COUNT; m++)
+        {
+            free(snapshot->buffers[b].ticks[m]);
+        }
+    }
+    free(snapshot->online);
+    free(snapshot->total_delta);
+    free(snapshot->busy_delta);
+    free(snapshot->usage);
+    cpu_snapshot_init(snapshot);
+}
+
+/**
+ * @brief Grows one array of the snapshot, zeroing the new slots.
+ *
+ * @param array Array to grow, replaced on success.
+ * @param old_count Number of slots currently allocated.
+ * @param new_count Number of slots to allocate.
+ * @param size Size of one slot.
+ * @return 0 on success, -1 on error.
+ */
+static int grow_array(void** array, size_t old_count, size_t new_count, size_t size)
+{
+    void* grown = realloc(*array, new_count * size);
+    if (grown == NULL)
+    {
+        return -1;
+    }
+    memset((char*)grown + old_count * size, 0, (new_count - old_count) * size);
+    *array = grown;
+    return 0;
+}
+
+/**
+ * @brief Makes room in every array of the snapshot for the given number of slots.
+ *
+ * @param snapshot Target snapshot.
+ * @param slots Number of slots needed.
+ * @return 0 on success, -1 on error.
+ */
+static int cpu_snapshot_reserve(CpuSnapshot* snapshot, size_t slots)
+{
+    if (slots <= snapshot->capacity)
+    {
+        return 0;
+    }
+    size_t capacity = snapshot->capacity ? snapshot->capacity : 16;
+    while (capacity < slots)
+    {
+        capacity *= 2;
+    }
+
+    for (int b = 0; b < 2; b++)
+    {
+        for (int m = 0; m < CPU_MODE_COUNT; m++)
+        {
+            if (grow_array((void**)&snapshot->buffers[b].ticks[m], snapshot->capacity, capacity,
+                           sizeof(unsigned long long)) != 0)
+            {
+                return -1;
+            }
+        }
+    }
+    if (grow_array((void**)&snapshot->online, snapshot->capacity, capacity, sizeof(bool)) != 0 ||
+        grow_array((void**)&snapshot->total_delta, snapshot->capacity, capacity, sizeof(unsigned long long)) != 0 ||
+        grow_array((void**)&snapshot->busy_delta, snapshot->capacity, capacity, sizeof(unsigned long long)) != 0 ||
+        grow_array((void**)&snapshot->usage, snapshot->capacity, capacity, sizeof(double)) != 0)
+    {
+        return -1;
+    }
+    snapshot->capacity = capacity;
+    return 0;
+}
+
+/**
+ * @brief Accumulates the ticks elapsed in one mode into the per-slot totals.
+ *
+ * Plain loops over restrict-qualified packed arrays so the compiler can vectorize them. Counters that went backwards
+ * (iowait is known to) count as zero.
+ *
+ * @param current Ticks of the mode in the most recent reading.
+ * @param previous Ticks of the mode in the previous reading.
+ * @param total Per-slot elapsed ticks, accumulated.
+ * @param busy Per-slot non-idle ticks, accumulated unless the mode is idle time.
+ * @param slots Number of slots.
+ * @param idle_mode Whether the mode counts as idle time.
+ */
+static void cpu_mode_delta(const unsigned long long* restrict current, const unsigned long long* restrict previous,
+                           unsigned long long* restrict total, unsigned long long* restrict busy, size_t slots,
+                           bool idle_mode)
+{
+    if (idle_mode)
+    {
+        for (size_t i = 0; i < slots; i++)
+        {
+            total[i] += current[i] > previous[i] ? current[i] - previous[i] : 0;
+        }
+    }
+    else
+    {
+        for (size_t i = 0; i < slots; i++)
+        {
+            unsigned long long delta = current[i] > previous[i] ? current[i] - previous[i] : 0;
+            total[i] += delta;
+            busy[i] += delta;
+        }
+    }
+}
+
+/**
+ * @brief Computes the usage percentage of every slot from the accumulated deltas.
+ *
+ * @param total Per-slot elapsed ticks.
+ * @param busy Per-slot non-idle ticks.
+ * @param usage Per-slot usage percentage, 0 for slots where no time elapsed.
+ * @param slots Number of slots.
+ */
+static void cpu_usage_ratio(const unsigned long long* restrict total, const unsigned long long* restrict busy,
+                            double* restrict usage, size_t slots)
+{
+    for (size_t i = 0; i < slots; i++)
+    {
+        double t = (double)total[i];
+        double b = (double)busy[i];
+        usage[i] = t > 0.0 ? b / t * 100.0 : 0.0;
+    }
+}
+
+CpuStats get_cpu_stats(CpuSnapshot* snapshot)
 {
-    static unsigned long long prev_user = 0, prev_nice = 0, prev_system = 0, prev_idle = 0, prev_iowait = 0,
-                              prev_irq = 0, prev_softirq = 0, prev_steal = 0;
-    unsigned long long user, nice, system, idle, iowait, irq, softirq, steal;
-    unsigned long long totald, idled;
     CpuStats stats = {-1.0, -1, -1}; // Initialize to -1.0, -1, -1 in case of error
 
-    // Abrir el archivo /proc/stat
-    FILE* fp = fopen("/proc/stat", "r");
-    if (fp == NULL)
+    // Releer /proc/stat
+    ProcView view;
+    if (procfs_read(&stat_file, &view) != 0)
     {
-        perror("Error al abrir /proc/stat");
         return stats;
     }
 
-    char buffer[BUFFER_SIZE * 4];
-    if (fgets(buffer, sizeof(buffer), fp) == NULL)
+    // The new reading goes to the spare buffer, which starts as a copy of the current one so that CPUs missing
+    // from this reading (offline) show no elapsed time
+    int previous = snapshot->current;
+    int next = 1 - previous;
+    if (snapshot->slots > 0)
     {
-        perror("Error al leer /proc/stat");
-        fclose(fp);
-        return stats;
+        for (int m = 0; m < CPU_MODE_COUNT; m++)
+        {
+            memcpy(snapshot->buffers[next].ticks[m], snapshot->buffers[previous].ticks[m],
+                   snapshot->slots * sizeof(unsigned long long));
+        }
+        memset(snapshot->online, 0, snapshot->slots * sizeof(bool));
     }
 
-    // Analizar los valores de tiempo de CPU
-    int ret = sscanf(buffer, "cpu  %llu %llu %llu %llu %llu %llu %llu %llu", &user, &nice, &system, &idle, &iowait,
-                     &irq, &softirq, &steal);
-    if (ret < 8)
+    // Analizar los valores de tiempo de CPU: "cpu" first, then one "cpuN" line per online core
+    const char* line = view.data;
+    bool aggregate_found = false;
+    for (; line != NULL; line = procfs_next_line(line, view.end))
+    {
+        const char* cursor;
+        unsigned long long cpu_number;
+        size_t slot;
+        if (!PARSE_KEY(line, view.end, "cpu", &cursor))
+        {
+            break; // End of the CPU lines
+        }
+        if (*cursor == ' ')
+        {
+            slot = 0;
+            aggregate_found = true;
+        }
+        else if (parse_u64(&cursor, view.end, &cpu_number))
+        {
+            slot = (size_t)cpu_number + 1;
+        }
+        else
+        {
+            continue;
+        }
+
+        if (slot >= snapshot->slots)
+        {
+            if (cpu_snapshot_reserve(snapshot, slot + 1) != 0)
+            {
+                perror("Error growing the CPU snapshot");
+                return stats;
+            }
+            snapshot->slots = slot + 1;
+        }
+
+        unsigned long long times[CPU_MODE_COUNT];
+        if (parse_u64_list(&cursor, view.end, times, CPU_MODE_COUNT) < CPU_MODE_COUNT)
+        {
+            continue;
+        }
+        for (int m = 0; m < CPU_MODE_COUNT; m++)
+        {
+            snapshot->buffers[next].ticks[m][slot] = times[m];
+        }
+        snapshot->online[slot] = true;
+    }
+    if (!aggregate_found)
     {
         fprintf(stderr, "Error al parsear /proc/stat\n");
         return stats;
     }
 
     // Loop through the file to find the context switches and running processes
-    while (fgets(buffer, sizeof(buffer), fp) != NULL)
+    for (; line != NULL; line = procfs_next_line(line, view.end))
     {
-        if (sscanf(buffer, "ctxt %llu", &stats.ctxt) == 1)
+        const char* value;
+        unsigned long long procs_running;
+        if (PARSE_KEY(line, view.end, "ctxt ", &value) && parse_u64(&value, view.end, &stats.ctxt))
         {
             continue; // context switches found
         }
-        if (sscanf(buffer, "procs_running %d", &stats.procs_running) == 1)
+        if (PARSE_KEY(line, view.end, "procs_running ", &value) && parse_u64(&value, view.end, &procs_running))
         {
+            stats.procs_running = (int)procs_running;
             break; // Procs running found, we can stop reading
         }
     }
-    fclose(fp); // Close the file
 
-    // Calcular las diferencias entre las lecturas actuales y anteriores
-    unsigned long long prev_idle_total = prev_idle + prev_iowait;
-    unsigned long long idle_total = idle + iowait;
-
-    unsigned long long prev_non_idle = prev_user + prev_nice + prev_system + prev_irq + prev_softirq + prev_steal;
-    unsigned long long non_idle = user + nice + system + irq + softirq + steal;
-
-    unsigned long long prev_total = prev_idle_total + prev_non_idle;
-    unsigned long long total = idle_total + non_idle;
+    // Calcular las diferencias entre las lecturas actuales y anteriores, modo por modo
+    size_t slots = snapshot->slots;
+    memset(snapshot->total_delta, 0, slots * sizeof(unsigned long long));
+    memset(snapshot->busy_delta, 0, slots * sizeof(unsigned long long));
+    for (int m = 0; m < CPU_MODE_COUNT; m++)
+    {
+        cpu_mode_delta(snapshot->buffers[next].ticks[m], snapshot->buffers[previous].ticks[m], snapshot->total_delta,
+                       snapshot->busy_delta, slots, m == CPU_MODE_IDLE || m == CPU_MODE_IOWAIT);
+    }
+    cpu_usage_ratio(snapshot->total_delta, snapshot->busy_delta, snapshot->usage, slots);
 
-    totald = total - prev_total;
-    idled = idle_total - prev_idle_total;
+    // La lectura nueva pasa a ser la actual
+    snapshot->current = next;
 
-    if (totald == 0)
+    if (snapshot->total_delta[0] == 0)
     {
         fprintf(stderr, "Totald es cero, no se puede calcular el uso de CPU!\n");
         return stats;
     }
 
     // Calcular el porcentaje de uso de CPU
-    stats.cpu_usage = ((double)(totald - idled) / totald) * 100.0;
-
-    // Actualizar los valores anteriores para la siguiente lectura
-    prev_user = user;
-    prev_nice = nice;
-    prev_system = system;
-    prev_idle = idle;
-    prev_iowait = iowait;
-    prev_irq = irq;
-    prev_softirq = softirq;
-    prev_steal = steal;
+    stats.cpu_usage = snapshot->usage[0];
 
     return stats; // Return the struct with the CPU usage percentage, the number of running processes and context
-                      // switches
+                  // switches
 }
 
-DiskStats get_disk_stats()
+void disk_table_init(DiskTable* table)
 {
-    FILE *fp, *fp_uptime;                  // File pointers
-    char buffer[BUFFER_SIZE];              // Buffer to read the file
-    char device_name[SHORT_BUFFER_SIZE];   // To store the device name
+    memset(table, 0, sizeof(*table));
+}
+
+void disk_table_destroy(DiskTable* table)
+{
+    free(table->devices);
+    free(table->index);
+    disk_table_init(table);
+}
+
+/**
+ * @brief Hashes a device number into a bucket of the index.
+ *
+ * @param major Major device number.
+ * @param minor Minor device number.
+ * @param index_size Number of buckets, a power of two.
+ * @return Bucket of the device.
+ */
+static size_t disk_hash(unsigned int major, unsigned int minor, size_t index_size)
+{
+    unsigned long long key = ((unsigned long long)major << 32) | minor;
+    key *= 0x9E3779B97F4A7C15ULL; // Fibonacci hashing, the high bits are the best mixed
+    return (size_t)(key >> 32) & (index_size - 1);
+}
+
+/**
+ * @brief Rebuilds the index with the given number of buckets.
+ *
+ * @param table Target table.
+ * @param index_size New number of buckets, a power of two.
+ * @return 0 on success, -1 on error.
+ */
+static int disk_table_rehash(DiskTable* table, size_t index_size)
+{
+    unsigned int* index = calloc(index_size, sizeof(unsigned int));
+    if (index == NULL)
+    {
+        return -1;
+    }
+    for (size_t slot = 0; slot < table->count; slot++)
+    {
+        size_t bucket = disk_hash(table->devices[slot].major, table->devices[slot].minor, index_size);
+        while (index[bucket] != 0)
+        {
+            bucket = (bucket + 1) & (index_size - 1);
+        }
+        index[bucket] = (unsigned int)slot + 1;
+    }
+    free(table->index);
+    table->index = index;
+    table->index_size = index_size;
+    return 0;
+}
+
+/**
+ * @brief Checks whether the device name starts with one of the patterns.
+ *
+ * @param name Device name.
+ * @param patterns Prefixes to match.
+ * @param count Number of patterns.
+ * @return true if one of the patterns matches.
+ */
+static bool disk_name_matches(const char* name, const char (*patterns)[SHORT_BUFFER_SIZE], size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        if (strncmp(name, patterns[i], strlen(patterns[i])) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Checks in sysfs whether the block device is a partition.
+ *
+ * @param name Device name as shown in /proc/diskstats.
+ * @return true if the device is a partition, false if it is a whole disk or sysfs is not available.
+ */
+static bool disk_is_partition(const char* name)
+{
+    // sysfs spells the slashes of names like "cciss/c0d0" as '!'
+    char sysfs_name[SHORT_BUFFER_SIZE];
+    size_t i;
+    for (i = 0; name[i] != '\0' && i < sizeof(sysfs_name) - 1; i++)
+    {
+        sysfs_name[i] = name[i] == '/' ? '!' : name[i];
+    }
+    sysfs_name[i] = '\0';
+
+    char path[BUFFER_SIZE];
+    snprintf(path, sizeof(path), "/sys/class/block/%s/partition", sysfs_name);
+    return access(path, F_OK) == 0;
+}
+
+/**
+ * @brief Finds the slot of a device, creating it on first sight.
+ *
+ * Partition detection and filtering are done once, when the slot is created.
+ *
+ * @param table Target table.
+ * @param major Major device number.
+ * @param minor Minor device number.
+ * @param name Device name token.
+ * @return The device, or NULL on allocation failure.
+ */
+static DiskDevice* disk_table_lookup(DiskTable* table, unsigned int major, unsigned int minor, const ProcToken* name)
+{
+    if (table->index_size > 0)
+    {
+        size_t bucket = disk_hash(major, minor, table->index_size);
+        while (table->index[bucket] != 0)
+        {
+            DiskDevice* device = &table->devices[table->index[bucket] - 1];
+            if (device->major == major && device->minor == minor)
+            {
+                return device;
+            }
+            bucket = (bucket + 1) & (table->index_size - 1);
+        }
+    }
+
+    // New device, keep the index at most half full
+    if (table->count == table->capacity)
+    {
+        size_t capacity = table->capacity ? table->capacity * 2 : 32;
+        DiskDevice* devices = realloc(table->devices, capacity * sizeof(DiskDevice));
+        if (devices == NULL)
+        {
+            return NULL;
+        }
+        table->devices = devices;
+        table->capacity = capacity;
+    }
+    if ((table->count + 1) * 2 > table->index_size &&
+        disk_table_rehash(table, table->index_size ? table->index_size * 2 : 64) != 0)
+    {
+        return NULL;
+    }
+
+    DiskDevice* device = &table->devices[table->count];
+    memset(device, 0, sizeof(*device));
+    device->major = major;
+    device->minor = minor;
+    size_t len = name->len < sizeof(device->name) - 1 ? name->len : sizeof(device->name) - 1;
+    memcpy(device->name, name->start, len);
+    device->name[len] = '\0';
+    device->partition = disk_is_partition(device->name);
+    device->accepted = (disk_filter.partitions || !device->partition) &&
+                       (disk_filter.include_count == 0 ||
+                        disk_name_matches(device->name, disk_filter.include, disk_filter.include_count)) &&
+                       !disk_name_matches(device->name, disk_filter.exclude, disk_filter.exclude_count);
+
+    size_t bucket = disk_hash(major, minor, table->index_size);
+    while (table->index[bucket] != 0)
+    {
+        bucket = (bucket + 1) & (table->index_size - 1);
+    }
+    table->count++;
+    table->index[bucket] = (unsigned int)table->count;
+    return device;
+}
+
+void disk_table_prune(DiskTable* table)
+{
+    // Compact the surviving devices in place, keeping their order
+    size_t count = 0;
+    for (size_t slot = 0; slot < table->count; slot++)
+    {
+        if (table->devices[slot].seen)
+        {
+            if (count != slot)
+            {
+                table->devices[count] = table->devices[slot];
+            }
+            count++;
+        }
+    }
+    if (count == table->count)
+    {
+        return;
+    }
+    table->count = count;
+
+    // Slots moved, rebuild the index in place
+    memset(table->index, 0, table->index_size * sizeof(unsigned int));
+    for (size_t slot = 0; slot < table->count; slot++)
+    {
+        size_t bucket = disk_hash(table->devices[slot].major, table->devices[slot].minor, table->index_size);
+        while (table->index[bucket] != 0)
+        {
+            bucket = (bucket + 1) & (table->index_size - 1);
+        }
+        table->index[bucket] = (unsigned int)slot + 1;
+    }
+}
+
+DiskStats get_disk_stats(DiskTable* table, const CollectionContext* context)
+{
+    ProcView view;                         // Contents of /proc/diskstats
     static DiskStats stats = {-1.0, -1.0}; // Initialize to -1.0, -1.0 in case of error
-    static double prev_time = 0;
-    static unsigned long long prev_reads_completed = 0, prev_writes_completed = 0;
-    double time, time_diff;
-    unsigned long long reads_completed, writes_completed;
+    double time_diff;
 
-    // Opens the /proc/diskstats file, and checks if succeeded
-    fp = fopen("/proc/diskstats", "r");
-    if (fp == NULL)
+    // Re-reads the /proc/diskstats file, and checks if succeeded
+    if (procfs_read(&diskstats_file, &view) != 0)
     {
-        perror("Error opening /proc/diskstats");
         return stats;
     }
-    // Open the /proc/uptime file, and checks if succeeded
-    fp_uptime = fopen("/proc/uptime", "r");
-    if (fp_uptime == NULL)
+
+    // Clculates the time difference from the clock snapshot of the cycle
+    time_diff = table->prev_ns ? (double)(context->now_ns - table->prev_ns) / NANOSECONDS_PER_SECOND : 0.0;
+    table->prev_ns = context->now_ns; // Updates the previous time
+
+    for (size_t slot = 0; slot < table->count; slot++)
     {
-        perror("Error opening /proc/uptime");
-        return stats;
+        table->devices[slot].seen = false;
+    }
+
+    // Parse every device row once
+    double rps = 0, wps = 0;
+    for (const char* line = view.data; line != NULL; line = procfs_next_line(line, view.end))
+    {
+        // major minor name reads_completed reads_merged sectors_read time_reading writes_completed ...
+        const char* cursor = line;
+        unsigned long long ids[2];
+        ProcToken name;
+        if (parse_u64_list(&cursor, view.end, ids, 2) != 2 || !parse_token(&cursor, view.end, &name))
+        {
+            continue;
+        }
+        DiskDevice* device = disk_table_lookup(table, (unsigned int)ids[0], (unsigned int)ids[1], &name);
+        if (device == NULL)
+        {
+            fprintf(stderr, "Error tracking disk device %.*s\n", (int)name.len, name.start);
+            continue;
+        }
+        device->seen = true; // Still present, even if filtered out
+        if (!device->accepted)
+        {
+            continue; // Filtered out, skip the rest of the row
+        }
+
+        size_t field_count = parse_u64_list(&cursor, view.end, device->fields, DISK_FIELD_COUNT);
+        if (field_count <= DISK_FIELD_WRITES_COMPLETED)
+        {
+            continue;
+        }
+        bool first_reading = device->field_count == 0;
+        device->field_count = field_count;
+
+        // Calculates the number of read and write operations per second
+        unsigned long long reads = device->fields[DISK_FIELD_READS_COMPLETED];
+        unsigned long long writes = device->fields[DISK_FIELD_WRITES_COMPLETED];
+        if (!first_reading && time_diff > 0)
+        {
+            device->rps = reads >= device->prev_reads_completed
+                              ? (double)(reads - device->prev_reads_completed) / time_diff
+                              : 0.0;
+            device->wps = writes >= device->prev_writes_completed
+                              ? (double)(writes - device->prev_writes_completed) / time_diff
+                              : 0.0;
+        }
+        device->prev_reads_completed = reads;
+        device->prev_writes_completed = writes;
+        rps += device->rps;
+        wps += device->wps;
+    }
+
+    stats.rps = rps;
+    stats.wps = wps;
+
+    return stats; // Return the struct with the number of read and write operations per second
+}
+
+void net_table_init(NetTable* table)
+{
+    memset(table, 0, sizeof(*table));
+}
+
+void net_table_destroy(NetTable* table)
+{
+    free(table->interfaces);
+    free(table->index);
+    net_table_init(table);
+}
+
+/**
+ * @brief Hashes an interface name with FNV-1a.
+ *
+ * @param name Name token.
+ * @return Hash of the name.
+ */
+static unsigned int net_hash(const ProcToken* name)
+{
+    unsigned int hash = 2166136261u;
+    for (size_t i = 0; i < name->len; i++)
+    {
+        hash ^= (unsigned char)name->start[i];
+        hash *= 16777619u;
     }
+    return hash;
+}
 
-    // Reads the time from /proc/uptime
-    fscanf(fp_uptime, "%lf", &time);
-    fclose(fp_uptime); // Close the uptime file
+/**
+ * @brief Checks whether an interface has the given name.
+ *
+ * @param interface Interface to check.
+ * @param name Name token.
+ * @param hash Hash of the name.
+ * @return true if the names are equal.
+ */
+static bool net_name_equals(const NetInterface* interface, const ProcToken* name, unsigned int hash)
+{
+    return interface->hash == hash && strncmp(interface->name, name->start, name->len) == 0 &&
+           interface->name[name->len] == '\0';
+}
 
-    // Clculates the time difference
-    time_diff = time - prev_time;
-    prev_time = time; // Updates the previous time
+/**
+ * @brief Rebuilds the index with the given number of buckets.
+ *
+ * @param table Target table.
+ * @param index_size New number of buckets, a power of two.
+ * @return 0 on success, -1 on error.
+ */
+static int net_table_rehash(NetTable* table, size_t index_size)
+{
+    unsigned int* index = calloc(index_size, sizeof(unsigned int));
+    if (index == NULL)
+    {
+        return -1;
+    }
+    for (size_t slot = 0; slot < table->count; slot++)
+    {
+        size_t bucket = table->interfaces[slot].hash & (index_size - 1);
+        while (index[bucket] != 0)
+        {
+            bucket = (bucket + 1) & (index_size - 1);
+        }
+        index[bucket] = (unsigned int)slot + 1;
+    }
+    free(table->index);
+    table->index = index;
+    table->index_size = index_size;
+    return 0;
+}
 
-    // Loop through the file to find the device
-    while (fgets(buffer, sizeof(buffer), fp) != NULL)
+/**
+ * @brief Finds the slot of an interface, creating it on first sight.
+ *
+ * Rows of /proc/net/dev keep their order between readings, so the slot at the position of the row is checked before
+ * the index.
+ *
+ * @param table Target table.
+ * @param name Interface name token.
+ * @param row Position of the row among the interface rows.
+ * @return The interface, or NULL on allocation failure or if the name does not fit.
+ */
+static NetInterface* net_table_lookup(NetTable* table, const ProcToken* name, size_t row)
+{
+    unsigned int hash = net_hash(name);
+    if (row < table->count && net_name_equals(&table->interfaces[row], name, hash))
+    {
+        return &table->interfaces[row];
+    }
+    if (table->index_size > 0)
     {
-        if (sscanf(buffer, "%*u %*u %s %llu %*u %*u %*u %llu", device_name, &reads_completed, &writes_completed) == 3)
+        size_t bucket = hash & (table->index_size - 1);
+        while (table->index[bucket] != 0)
         {
-            if (strcmp(device_name, "nvme0n1") == 0)
+            NetInterface* interface = &table->interfaces[table->index[bucket] - 1];
+            if (net_name_equals(interface, name, hash))
             {
-                break; // Device found, no need to keep reading
+                return interface;
             }
+            bucket = (bucket + 1) & (table->index_size - 1);
+        }
+    }
+
+    // New interface, keep the index at most half full
+    if (name->len >= SHORT_BUFFER_SIZE)
+    {
+        return NULL;
+    }
+    if (table->count == table->capacity)
+    {
+        size_t capacity = table->capacity ? table->capacity * 2 : 16;
+        NetInterface* interfaces = realloc(table->interfaces, capacity * sizeof(NetInterface));
+        if (interfaces == NULL)
+        {
+            return NULL;
         }
+        table->interfaces = interfaces;
+        table->capacity = capacity;
+    }
+    if ((table->count + 1) * 2 > table->index_size &&
+        net_table_rehash(table, table->index_size ? table->index_size * 2 : 32) != 0)
+    {
+        return NULL;
     }
-    fclose(fp); // Close the diskstats file
 
-    // Calculates the number of read and write operations per second
-    stats.rps = (double)(reads_completed - prev_reads_completed) / time_diff;
-    stats.wps = (double)(writes_completed - prev_writes_completed) / time_diff;
-    prev_reads_completed = reads_completed;
-    prev_writes_completed = writes_completed;
+    NetInterface* interface = &table->interfaces[table->count];
+    memset(interface, 0, sizeof(*interface));
+    memcpy(interface->name, name->start, name->len);
+    interface->name[name->len] = '\0';
+    interface->hash = hash;
 
-    return stats; // Return the struct with the number of read and write operations per second
+    size_t bucket = hash & (table->index_size - 1);
+    while (table->index[bucket] != 0)
+    {
+        bucket = (bucket + 1) & (table->index_size - 1);
+    }
+    table->count++;
+    table->index[bucket] = (unsigned int)table->count;
+    return interface;
 }
 
-NetStats get_net_stats()
+void net_table_prune(NetTable* table)
 {
-    FILE *fp, *fp_uptime;                 // File pointers
-    char buffer[BUFFER_SIZE];             // Buffer to read the file
-    static NetStats stats = {-1.0, -1.0}; // Initialize to -1.0, -1.0 in case of error
-    static double prev_time = 0, time, time_diff;
-    static unsigned long long prev_rec_bytes = 0, prev_sen_bytes = 0;
-    unsigned long long rec_bytes, sen_bytes, diff_rec_bytes, diff_sen_bytes;
+    // Compact the surviving interfaces in place, keeping their order
+    size_t count = 0;
+    for (size_t slot = 0; slot < table->count; slot++)
+    {
+        if (table->interfaces[slot].seen)
+        {
+            if (count != slot)
+            {
+                table->interfaces[count] = table->interfaces[slot];
+            }
+            count++;
+        }
+    }
+    if (count == table->count)
+    {
+        return;
+    }
+    table->count = count;
 
-    // We open the /proc/net/dev file, and check if we succeeded
-    fp = fopen("/proc/net/dev", "r");
-    if (fp == NULL)
+    // Slots moved, rebuild the index in place
+    memset(table->index, 0, table->index_size * sizeof(unsigned int));
+    for (size_t slot = 0; slot < table->count; slot++)
     {
-        perror("Error opening /proc/net/dev");
-        return stats;
+        size_t bucket = table->interfaces[slot].hash & (table->index_size - 1);
+        while (table->index[bucket] != 0)
+        {
+            bucket = (bucket + 1) & (table->index_size - 1);
+        }
+        table->index[bucket] = (unsigned int)slot + 1;
     }
-    // We open the /proc/uptime file, and check if we succeeded
-    fp_uptime = fopen("/proc/uptime", "r");
-    if (fp_uptime == NULL)
+}
+
+NetStats get_net_stats(NetTable* table, const CollectionContext* context)
+{
+    ProcView view;                        // Contents of /proc/net/dev
+    static NetStats stats = {-1.0, -1.0}; // Initialize to -1.0, -1.0 in case of error
+    double time_diff;
+
+    // We re-read the /proc/net/dev file, and check if we succeeded
+    if (procfs_read(&net_dev_file, &view) != 0)
     {
-        perror("Error opening /proc/uptime");
         return stats;
     }
 
-    // We read the time from /proc/uptime
-    fscanf(fp_uptime, "%lf", &time);
-    fclose(fp_uptime); // Close the uptime file
+    // We calculate the time difference from the clock snapshot of the cycle
+    time_diff = table->prev_ns ? (double)(context->now_ns - table->prev_ns) / NANOSECONDS_PER_SECOND : 0.0;
+    table->prev_ns = context->now_ns; // Update the previous time
 
-    // We calculate the time difference
-    time_diff = time - prev_time;
-    prev_time = time; // Update the previous time
+    for (size_t slot = 0; slot < table->count; slot++)
+    {
+        table->interfaces[slot].seen = false;
+    }
 
-    // Loop through the file to find the interface
-    while (fgets(buffer, sizeof(buffer), fp) != NULL)
+    // Parse every interface row once, the two header lines have no colon
+    double rec_bytesps = 0, sen_bytesps = 0;
+    size_t row = 0;
+    for (const char* line = view.data; line != NULL; line = procfs_next_line(line, view.end))
     {
-        if (sscanf(buffer, "  wlo1: %llu %*u %*u %*u %*u %*u %*u %*u %llu", &rec_bytes, &sen_bytes) == 2)
+        // The name is followed by a colon that may be glued to the first counter
+        const char* cursor = line;
+        ProcToken name;
+        unsigned long long fields[NET_FIELD_COUNT];
+        if (!parse_token_until(&cursor, view.end, ':', &name) ||
+            parse_u64_list(&cursor, view.end, fields, NET_FIELD_COUNT) != NET_FIELD_COUNT)
         {
-            break; // Interface found, no need to keep reading
+            continue;
         }
-    }
-    fclose(fp); // Close the net/dev file
+        NetInterface* interface = net_table_lookup(table, &name, row++);
+        if (interface == NULL)
+        {
+            fprintf(stderr, "Error tracking network interface %.*s\n", (int)name.len, name.start);
+            continue;
+        }
+        memcpy(interface->fields, fields, sizeof(fields));
+        interface->seen = true;
+
+        // We calculate the number of bytes sent and received per second
+        unsigned long long rec_bytes = fields[NET_FIELD_RX_BYTES];
+        unsigned long long sen_bytes = fields[NET_FIELD_TX_BYTES];
+        if (interface->has_reading && time_diff > 0)
+        {
+            interface->rx_bytesps =
+                rec_bytes >= interface->prev_rx_bytes ? (double)(rec_bytes - interface->prev_rx_bytes) / time_diff : 0.0;
+            interface->tx_bytesps =
+                sen_bytes >= interface->prev_tx_bytes ? (double)(sen_bytes - interface->prev_tx_bytes) / time_diff : 0.0;
+        }
+        interface->prev_rx_bytes = rec_bytes;
+        interface->prev_tx_bytes = sen_bytes;
+        interface->has_reading = true;
 
-    // We calculate the difference in bytes sent and received
-    diff_rec_bytes = rec_bytes - prev_rec_bytes;
-    prev_rec_bytes = rec_bytes;
-    diff_sen_bytes = sen_bytes - prev_sen_bytes;
-    prev_sen_bytes = sen_bytes;
+        if (strcmp(interface->name, "lo") != 0)
+        {
+            rec_bytesps += interface->rx_bytesps;
+            sen_bytesps += interface->tx_bytesps;
+        }
+    }
 
-    // We calculate the number of kilobytes sent and received per second
-    stats.rec_bytesps = (double)diff_rec_bytes / time_diff;
-    stats.sen_bytesps = (double)diff_sen_bytes / time_diff;
+    stats.rec_bytesps = rec_bytesps;
+    stats.sen_bytesps = sen_bytesps;
 
     return stats;
 }
@@ -0,0 +1,105 @@
+#include "proc_parse.h"
+#include <limits.h>
+#include <string.h>
+
+/**
+ * @brief Checks whether the character ends a token.
+ *
+ * @param c Character to check.
+ * @return true for blanks and line terminators.
+ */
+static inline bool is_separator(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\0';
+}
+
+bool parse_key(const char* line, const char* end, const char* key, size_t key_len, const char** rest)
+{
+    if ((size_t)(end - line) < key_len || memcmp(line, key, key_len) != 0)
+    {
+        return false;
+    }
+    *rest = line + key_len;
+    return true;
+}
+
+const char* parse_skip_blanks(const char* p, const char* end)
+{
+    while (p < end && (*p == ' ' || *p == '\t'))
+    {
+        p++;
+    }
+    return p;
+}
+
+bool parse_u64(const char** cursor, const char* end, unsigned long long* out)
+{
+    const char* p = parse_skip_blanks(*cursor, end);
+    const char* start = p;
+    unsigned long long value = 0;
+
+    // Plain digit loop, /proc counters never carry a sign, a base prefix or a thousands separator
+    while (p < end && (unsigned char)(*p - '0') < 10)
+    {
+        unsigned long long digit = (unsigned long long)(*p - '0');
+        if (value > (ULLONG_MAX - digit) / 10)
+        {
+            return false; // Does not fit, rather than a wrapped value
+        }
+        value = value * 10 + digit;
+        p++;
+    }
+    if (p == start)
+    {
+        return false;
+    }
+    *out = value;
+    *cursor = p;
+    return true;
+}
+
+size_t parse_u64_list(const char** cursor, const char* end, unsigned long long* out, size_t count)
+{
+    size_t parsed = 0;
+    while (parsed < count && parse_u64(cursor, end, &out[parsed]))
+    {
+        parsed++;
+    }
+    return parsed;
+}
+
+bool parse_token(const char** cursor, const char* end, ProcToken* token)
+{
+    const char* p = parse_skip_blanks(*cursor, end);
+    const char* start = p;
+    while (p < end && !is_separator(*p))
+    {
+        p++;
+    }
+    if (p == start)
+    {
+        return false;
+    }
+    token->start = start;
+    token->len = (size_t)(p - start);
+    *cursor = p;
+    return true;
+}
+
+bool parse_token_until(const char** cursor, const char* end, char delim, ProcToken* token)
+{
+    const char* start = parse_skip_blanks(*cursor, end);
+    const char* p = start;
+    while (p < end && *p != delim && *p != '\n')
+    {
+        p++;
+    }
+    if (p >= end || *p != delim)
+    {
+        return false;
+    }
+    token->start = start;
+    token->len = (size_t)(p - start);
+    *cursor = p + 1;
+    return true;
+}
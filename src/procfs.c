@@ -0,0 +1,477 @@
+#include "procfs.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef PROCFS_IO_URING
+#include <linux/io_uring.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+
+/**
+ * @brief (Re)opens the file descriptor of the handle, closing the previous one if any.
+ *
+ * @param file Target handle.
+ * @return 0 on success, -1 on error.
+ */
+static int procfs_reopen(ProcFile* file)
+{
+    if (file->fd >= 0)
+    {
+        close(file->fd);
+    }
+    file->fd = open(file->path, O_RDONLY | O_CLOEXEC);
+    if (file->fd < 0)
+    {
+        fprintf(stderr, "Error opening %s: %s\n", file->path, strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Grows the buffer of the handle to the given capacity.
+ *
+ * @param file Target handle.
+ * @param capacity New capacity in bytes.
+ * @return 0 on success, -1 on error.
+ */
+static int procfs_grow(ProcFile* file, size_t capacity)
+{
+    char* buf = realloc(file->buf, capacity);
+    if (buf == NULL)
+    {
+        perror("Error growing /proc buffer");
+        return -1;
+    }
+    file->buf = buf;
+    file->capacity = capacity;
+    return 0;
+}
+
+int procfs_open(ProcFile* file)
+{
+    if (file->buf == NULL && procfs_grow(file, PROCFS_INITIAL_BUFFER_SIZE) != 0)
+    {
+        return -1;
+    }
+    return procfs_reopen(file);
+}
+
+int procfs_read(ProcFile* file, ProcView* view)
+{
+    if (file->prefetched)
+    {
+        file->prefetched = false;
+        view->data = file->buf;
+        view->end = file->buf + file->len;
+        return 0;
+    }
+
+    if (file->buf == NULL || file->fd < 0)
+    {
+        if (procfs_open(file) != 0)
+        {
+            return -1;
+        }
+    }
+
+    int reopened = 0;
+    while (1)
+    {
+        // Leave room for the terminating NUL
+        ssize_t n = pread(file->fd, file->buf, file->capacity - 1, 0);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            if ((errno == ESTALE || errno == ENOENT) && !reopened)
+            {
+                reopened = 1;
+                if (procfs_reopen(file) != 0)
+                {
+                    return -1;
+                }
+                continue;
+            }
+            fprintf(stderr, "Error reading %s: %s\n", file->path, strerror(errno));
+            return -1;
+        }
+
+        // A read that gets too close to the end of the buffer may have been cut short, read it again with more room
+        if ((size_t)n + PROCFS_READ_SLACK >= file->capacity - 1)
+        {
+            if (procfs_grow(file, file->capacity * 2) != 0)
+            {
+                return -1;
+            }
+            continue;
+        }
+
+        file->len = (size_t)n;
+        file->buf[file->len] = '\0';
+        view->data = file->buf;
+        view->end = file->buf + file->len;
+        return 0;
+    }
+}
+
+void procfs_close(ProcFile* file)
+{
+    file->prefetched = false;
+    file->buf_index = -1;
+    if (file->fd >= 0)
+    {
+        close(file->fd);
+        file->fd = -1;
+    }
+    free(file->buf);
+    file->buf = NULL;
+    file->capacity = 0;
+    file->len = 0;
+}
+
+const char* procfs_next_line(const char* line, const char* end)
+{
+    const char* newline = memchr(line, '\n', end - line);
+    if (newline == NULL || newline + 1 >= end)
+    {
+        return NULL;
+    }
+    return newline + 1;
+}
+
+#ifdef PROCFS_IO_URING
+
+/**
+ * @struct ProcRing
+ * @brief io_uring instance shared by every prefetch batch, with its rings mapped in memory.
+ */
+typedef struct
+{
+    int fd;                                  /**< io_uring file descriptor, -1 before setup. */
+    bool unavailable;                        /**< Set when setup failed, batches are skipped from then on. */
+    unsigned* sq_tail;                       /**< Submission queue tail, written by us. */
+    unsigned* sq_mask;                       /**< Submission queue index mask. */
+    unsigned* sq_array;                      /**< Submission queue index array. */
+    struct io_uring_sqe* sqes;               /**< Submission queue entries. */
+    unsigned* cq_head;                       /**< Completion queue head, written by us. */
+    unsigned* cq_tail;                       /**< Completion queue tail, written by the kernel. */
+    unsigned* cq_mask;                       /**< Completion queue index mask. */
+    struct io_uring_cqe* cqes;               /**< Completion queue entries. */
+    void* sq_ring;                           /**< Mapping of the submission ring. */
+    size_t sq_ring_size;                     /**< Size of the submission ring mapping. */
+    void* cq_ring;                           /**< Mapping of the completion ring, may alias sq_ring. */
+    size_t cq_ring_size;                     /**< Size of the completion ring mapping. */
+    size_t sqes_size;                        /**< Size of the submission entries mapping. */
+    struct iovec buffers[PROCFS_BATCH_MAX];  /**< Buffers registered with the kernel. */
+    unsigned buffer_count;                   /**< Number of registered buffers. */
+} ProcRing;
+
+static ProcRing ring = {.fd = -1};
+
+/**
+ * @brief Unmaps the rings and closes the io_uring instance.
+ */
+static void procfs_ring_teardown()
+{
+    if (ring.sqes != NULL)
+    {
+        munmap(ring.sqes, ring.sqes_size);
+    }
+    if (ring.cq_ring != NULL && ring.cq_ring != ring.sq_ring)
+    {
+        munmap(ring.cq_ring, ring.cq_ring_size);
+    }
+    if (ring.sq_ring != NULL)
+    {
+        munmap(ring.sq_ring, ring.sq_ring_size);
+    }
+    if (ring.fd >= 0)
+    {
+        close(ring.fd);
+    }
+    bool unavailable = ring.unavailable;
+    memset(&ring, 0, sizeof(ring));
+    ring.fd = -1;
+    ring.unavailable = unavailable;
+}
+
+/**
+ * @brief Creates the io_uring instance and maps its rings, on first use.
+ *
+ * @return 0 on success, -1 if io_uring is not usable (e.g. old kernel or blocked by seccomp).
+ */
+static int procfs_ring_setup()
+{
+    if (ring.fd >= 0)
+    {
+        return 0;
+    }
+    if (ring.unavailable)
+    {
+        return -1;
+    }
+
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ring.fd = (int)syscall(__NR_io_uring_setup, PROCFS_BATCH_MAX, &params);
+    if (ring.fd < 0)
+    {
+        fprintf(stderr, "io_uring not available, reading /proc synchronously: %s\n", strerror(errno));
+        ring.unavailable = true;
+        return -1;
+    }
+
+    ring.sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring.cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        if (ring.cq_ring_size > ring.sq_ring_size)
+        {
+            ring.sq_ring_size = ring.cq_ring_size;
+        }
+        ring.cq_ring_size = ring.sq_ring_size;
+    }
+    ring.sq_ring = mmap(NULL, ring.sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring.fd,
+                        IORING_OFF_SQ_RING);
+    if (ring.sq_ring == MAP_FAILED)
+    {
+        ring.sq_ring = NULL;
+        goto fail;
+    }
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        ring.cq_ring = ring.sq_ring;
+    }
+    else
+    {
+        ring.cq_ring = mmap(NULL, ring.cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring.fd,
+                            IORING_OFF_CQ_RING);
+        if (ring.cq_ring == MAP_FAILED)
+        {
+            ring.cq_ring = NULL;
+            goto fail;
+        }
+    }
+    ring.sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring.sqes =
+        mmap(NULL, ring.sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring.fd, IORING_OFF_SQES);
+    if (ring.sqes == MAP_FAILED)
+    {
+        ring.sqes = NULL;
+        goto fail;
+    }
+
+    char* sq = ring.sq_ring;
+    char* cq = ring.cq_ring;
+    ring.sq_tail = (unsigned*)(sq + params.sq_off.tail);
+    ring.sq_mask = (unsigned*)(sq + params.sq_off.ring_mask);
+    ring.sq_array = (unsigned*)(sq + params.sq_off.array);
+    ring.cq_head = (unsigned*)(cq + params.cq_off.head);
+    ring.cq_tail = (unsigned*)(cq + params.cq_off.tail);
+    ring.cq_mask = (unsigned*)(cq + params.cq_off.ring_mask);
+    ring.cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+    return 0;
+
+fail:
+    perror("Error mapping the io_uring rings");
+    ring.unavailable = true;
+    procfs_ring_teardown();
+    return -1;
+}
+
+/**
+ * @brief Makes sure the buffer of every file is registered, re-registering the whole set if one changed.
+ *
+ * Buffers only change when a file is opened or its buffer grows, so this is a no-op in steady state.
+ *
+ * @param files Handles of the batch.
+ * @param count Number of handles.
+ * @return 0 on success, -1 if the buffers could not be registered.
+ */
+static int procfs_ring_register(ProcFile* const* files, size_t count)
+{
+    bool changed = false;
+    for (size_t i = 0; i < count; i++)
+    {
+        ProcFile* file = files[i];
+        int index = file->buf_index;
+        if (index >= 0 && (unsigned)index < ring.buffer_count && ring.buffers[index].iov_base == file->buf &&
+            ring.buffers[index].iov_len == file->capacity)
+        {
+            continue;
+        }
+        if (index < 0 || (unsigned)index >= ring.buffer_count)
+        {
+            if (ring.buffer_count == PROCFS_BATCH_MAX)
+            {
+                return -1;
+            }
+            index = (int)ring.buffer_count++;
+        }
+        ring.buffers[index].iov_base = file->buf;
+        ring.buffers[index].iov_len = file->capacity;
+        file->buf_index = index;
+        changed = true;
+    }
+    if (!changed)
+    {
+        return 0;
+    }
+
+    syscall(__NR_io_uring_register, ring.fd, IORING_UNREGISTER_BUFFERS, NULL, 0);
+    if (syscall(__NR_io_uring_register, ring.fd, IORING_REGISTER_BUFFERS, ring.buffers, ring.buffer_count) != 0)
+    {
+        fprintf(stderr, "Error registering io_uring buffers, reading /proc synchronously: %s\n", strerror(errno));
+        ring.unavailable = true;
+        procfs_ring_teardown();
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Stores the result of a completed read in its handle.
+ *
+ * @param file Handle of the read.
+ * @param result Bytes read, or a negative errno.
+ */
+static void procfs_complete(ProcFile* file, int result)
+{
+    // Errors and reads that may have been cut short are retried by the synchronous path
+    if (result < 0 || (size_t)result + PROCFS_READ_SLACK >= file->capacity - 1)
+    {
+        return;
+    }
+    file->len = (size_t)result;
+    file->buf[file->len] = '\0';
+    file->prefetched = true;
+}
+
+/**
+ * @brief Gives up the buffer of a file whose read may still be in flight.
+ *
+ * Once io_uring_enter fails, nothing tells when the reads still in flight complete, and the kernel may write into
+ * their buffers until then. Such a buffer is never reused nor freed: the next procfs_read of the file allocates a new
+ * one. io_uring is disabled for good after such a failure, so this happens at most once per file.
+ *
+ * @param file Handle of the read.
+ */
+static void procfs_abandon_buffer(ProcFile* file)
+{
+    file->buf = NULL;
+    file->capacity = 0;
+    file->len = 0;
+    file->prefetched = false;
+    file->buf_index = -1;
+}
+
+void procfs_prefetch(ProcFile* const* files, size_t count)
+{
+    ProcFile* batch[PROCFS_BATCH_MAX];
+    size_t batch_count = 0;
+    for (size_t i = 0; i < count && batch_count < PROCFS_BATCH_MAX; i++)
+    {
+        // Closed files are opened by the synchronous path, which reports the errors
+        if (files[i]->fd >= 0 && files[i]->buf != NULL && !files[i]->prefetched)
+        {
+            batch[batch_count++] = files[i];
+        }
+    }
+    if (batch_count == 0 || procfs_ring_setup() != 0 || procfs_ring_register(batch, batch_count) != 0)
+    {
+        return;
+    }
+
+    // One fixed-buffer read per file, all submitted with a single io_uring_enter
+    unsigned tail = *ring.sq_tail;
+    for (size_t i = 0; i < batch_count; i++)
+    {
+        unsigned index = tail & *ring.sq_mask;
+        struct io_uring_sqe* sqe = &ring.sqes[index];
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = IORING_OP_READ_FIXED;
+        sqe->fd = batch[i]->fd;
+        sqe->addr = (unsigned long long)(uintptr_t)batch[i]->buf;
+        sqe->len = (unsigned)(batch[i]->capacity - 1); // Leave room for the terminating NUL
+        sqe->off = 0;
+        sqe->buf_index = (unsigned short)batch[i]->buf_index;
+        sqe->user_data = i;
+        ring.sq_array[index] = index;
+        tail++;
+    }
+    __atomic_store_n(ring.sq_tail, tail, __ATOMIC_RELEASE);
+
+    // Handle the completions as they arrive
+    bool done[PROCFS_BATCH_MAX] = {false};
+    size_t submitted = batch_count;
+    size_t completed = 0;
+    while (completed < batch_count)
+    {
+        int r = (int)syscall(__NR_io_uring_enter, ring.fd, (unsigned)submitted, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+        if (r < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            // The completed reads stay valid, the buffers of the others may still be written by the kernel
+            fprintf(stderr, "Error waiting for io_uring completions, reading /proc synchronously: %s\n",
+                    strerror(errno));
+            ring.unavailable = true;
+            procfs_ring_teardown();
+            for (size_t i = 0; i < batch_count; i++)
+            {
+                if (!done[i])
+                {
+                    procfs_abandon_buffer(batch[i]);
+                }
+            }
+            return;
+        }
+        submitted -= (size_t)r < submitted ? (size_t)r : submitted;
+
+        unsigned head = *ring.cq_head;
+        unsigned cq_tail = __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE);
+        for (; head != cq_tail; head++)
+        {
+            struct io_uring_cqe* cqe = &ring.cqes[head & *ring.cq_mask];
+            if (cqe->user_data < batch_count)
+            {
+                done[cqe->user_data] = true;
+                procfs_complete(batch[cqe->user_data], cqe->res);
+            }
+            completed++;
+        }
+        __atomic_store_n(ring.cq_head, head, __ATOMIC_RELEASE);
+    }
+}
+
+void procfs_prefetch_shutdown()
+{
+    procfs_ring_teardown();
+}
+
+#else
+
+void procfs_prefetch(ProcFile* const* files, size_t count)
+{
+    // Without io_uring there is nothing to batch, every file is read by its own procfs_read
+    (void)files;
+    (void)count;
+}
+
+void procfs_prefetch_shutdown()
+{
+}
+
+#endif // PROCFS_IO_URING
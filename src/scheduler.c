@@ -0,0 +1,189 @@
+#include "scheduler.h"
+#include <errno.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+/**
+ * @def SCHEDULER_NS_PER_SECOND
+ * @brief Number of nanoseconds in a second.
+ */
+#define SCHEDULER_NS_PER_SECOND 1000000000ULL
+
+/**
+ * @brief Converts a time in nanoseconds to a timespec.
+ *
+ * @param ns Time in nanoseconds.
+ * @return The same time as a timespec.
+ */
+static struct timespec to_timespec(unsigned long long ns)
+{
+    struct timespec ts;
+    ts.tv_sec = (time_t)(ns / SCHEDULER_NS_PER_SECOND);
+    ts.tv_nsec = (long)(ns % SCHEDULER_NS_PER_SECOND);
+    return ts;
+}
+
+/**
+ * @brief Reads CLOCK_MONOTONIC in nanoseconds.
+ *
+ * @param now_ns Filled with the current time on success.
+ * @return 0 on success, -1 on error.
+ */
+static int monotonic_now(unsigned long long* now_ns)
+{
+    struct timespec now;
+    if (clock_gettime(CLOCK_MONOTONIC, &now) != 0)
+    {
+        return -1;
+    }
+    *now_ns = (unsigned long long)now.tv_sec * SCHEDULER_NS_PER_SECOND + (unsigned long long)now.tv_nsec;
+    return 0;
+}
+
+int scheduler_parse_duration(const char* text, unsigned long long* duration_ns)
+{
+    if (text == NULL)
+    {
+        return -1;
+    }
+
+    // strtod would accept a sign, hexadecimal and "inf", only plain decimals are durations
+    const char* p = text;
+    if (!(*p >= '0' && *p <= '9') && *p != '.')
+    {
+        return -1;
+    }
+    char* unit;
+    errno = 0;
+    double value = strtod(p, &unit);
+    if (errno != 0 || unit == p)
+    {
+        return -1;
+    }
+
+    double scale;
+    if (*unit == '\0' || strcmp(unit, "s") == 0)
+    {
+        scale = 1e9;
+    }
+    else if (strcmp(unit, "ms") == 0)
+    {
+        scale = 1e6;
+    }
+    else if (strcmp(unit, "us") == 0)
+    {
+        scale = 1e3;
+    }
+    else if (strcmp(unit, "ns") == 0)
+    {
+        scale = 1.0;
+    }
+    else if (strcmp(unit, "m") == 0)
+    {
+        scale = 60e9;
+    }
+    else
+    {
+        return -1;
+    }
+
+    double ns = value * scale;
+    if (!isfinite(ns) || ns >= (double)UINT64_MAX)
+    {
+        return -1;
+    }
+    *duration_ns = (unsigned long long)(ns + 0.5);
+    return 0;
+}
+
+int scheduler_init(Scheduler* scheduler, unsigned long long interval_ns)
+{
+    scheduler->fd = -1;
+    if (interval_ns < SCHEDULER_MIN_INTERVAL_NS)
+    {
+        fprintf(stderr, "Sampling interval too short, minimum is %llu ns\n", SCHEDULER_MIN_INTERVAL_NS);
+        return -1;
+    }
+
+    unsigned long long now_ns;
+    if (monotonic_now(&now_ns) != 0)
+    {
+        perror("Error reading the monotonic clock");
+        return -1;
+    }
+
+    scheduler->fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if (scheduler->fd < 0)
+    {
+        perror("Error creating the scheduler timer");
+        return -1;
+    }
+
+    // Absolute first deadline and a period: the kernel keeps the deadlines on the grid start + k * interval
+    struct itimerspec spec;
+    spec.it_value = to_timespec(now_ns);
+    spec.it_interval = to_timespec(interval_ns);
+    if (timerfd_settime(scheduler->fd, TFD_TIMER_ABSTIME, &spec, NULL) != 0)
+    {
+        perror("Error arming the scheduler timer");
+        close(scheduler->fd);
+        scheduler->fd = -1;
+        return -1;
+    }
+
+    scheduler->interval_ns = interval_ns;
+    // The first deadline is reached after one expiration
+    scheduler->deadline_ns = now_ns - interval_ns;
+    return 0;
+}
+
+int scheduler_wait(Scheduler* scheduler, SchedulerTick* tick)
+{
+    // The timerfd counts the deadlines reached since the last read
+    uint64_t expirations;
+    ssize_t n = read(scheduler->fd, &expirations, sizeof(expirations));
+    if (n < 0)
+    {
+        if (errno == EINTR)
+        {
+            return 1;
+        }
+        perror("Error waiting for the scheduler timer");
+        return -1;
+    }
+    if (n != sizeof(expirations) || expirations == 0)
+    {
+        return 1;
+    }
+
+    unsigned long long now_ns;
+    if (monotonic_now(&now_ns) != 0)
+    {
+        perror("Error reading the monotonic clock");
+        return -1;
+    }
+
+    // Only the last deadline is run, the ones before it were missed
+    scheduler->deadline_ns += expirations * scheduler->interval_ns;
+    tick->deadline_ns = scheduler->deadline_ns;
+    tick->missed = expirations - 1;
+    tick->lateness = now_ns > scheduler->deadline_ns
+                         ? (double)(now_ns - scheduler->deadline_ns) / (double)SCHEDULER_NS_PER_SECOND
+                         : 0.0;
+    return 0;
+}
+
+void scheduler_destroy(Scheduler* scheduler)
+{
+    if (scheduler->fd >= 0)
+    {
+        close(scheduler->fd);
+        scheduler->fd = -1;
+    }
+}
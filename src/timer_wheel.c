@@ -0,0 +1,152 @@
+#include "timer_wheel.h"
+#include <string.h>
+
+/**
+ * @def TIMER_WHEEL_MASK
+ * @brief Mask of the slot index within a level.
+ */
+#define TIMER_WHEEL_MASK (TIMER_WHEEL_SLOTS - 1)
+
+/**
+ * @brief Places an entry in the slot matching its expiry.
+ *
+ * @param wheel Target wheel.
+ * @param entry Entry to place, its expiry must not be in the past.
+ */
+static void timer_wheel_place(TimerWheel* wheel, TimerWheelEntry* entry)
+{
+    unsigned long long delta = entry->expires - wheel->current;
+    int level = 0;
+    while (level < TIMER_WHEEL_LEVELS - 1 && delta >= (1ULL << (TIMER_WHEEL_BITS * (level + 1))))
+    {
+        level++;
+    }
+
+    // Expiries beyond the top level wait in its farthest slot and are placed again when it is cascaded
+    unsigned long long expires = entry->expires;
+    unsigned long long top_span = 1ULL << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS);
+    if (delta >= top_span)
+    {
+        expires = wheel->current + top_span - 1;
+    }
+
+    size_t slot = (size_t)(expires >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK;
+    entry->next = wheel->slots[level][slot];
+    wheel->slots[level][slot] = entry;
+}
+
+/**
+ * @brief Moves the entries of the current slot of a level down to the lower levels.
+ *
+ * @param wheel Target wheel.
+ * @param level Level to cascade, at least 1.
+ */
+static void timer_wheel_cascade(TimerWheel* wheel, int level)
+{
+    size_t slot = (size_t)(wheel->current >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK;
+    TimerWheelEntry* entry = wheel->slots[level][slot];
+    wheel->slots[level][slot] = NULL;
+    while (entry != NULL)
+    {
+        TimerWheelEntry* next = entry->next;
+        timer_wheel_place(wheel, entry);
+        entry = next;
+    }
+}
+
+/**
+ * @brief Finds the next tick at which advancing the wheel finds entries.
+ *
+ * A tick only has work to do if its slot of level 0 holds entries, or if it cascades a slot of a higher level that
+ * holds entries. Level n is only cascaded on the multiples of its slot width and visits all its slots within
+ * TIMER_WHEEL_SLOTS of them, so scanning that many slots per level finds the next such tick.
+ *
+ * @param wheel Target wheel.
+ * @param limit Last tick of interest.
+ * @return First tick in (current, limit] with work to do, or limit if there is none.
+ */
+static unsigned long long timer_wheel_next_event(const TimerWheel* wheel, unsigned long long limit)
+{
+    unsigned long long next = limit;
+    for (int level = 0; level < TIMER_WHEEL_LEVELS; level++)
+    {
+        int shift = TIMER_WHEEL_BITS * level;
+        unsigned long long tick = ((wheel->current >> shift) + 1) << shift;
+        for (int step = 0; step < TIMER_WHEEL_SLOTS && tick < next; step++, tick += 1ULL << shift)
+        {
+            if (wheel->slots[level][(size_t)(tick >> shift) & TIMER_WHEEL_MASK] != NULL)
+            {
+                next = tick;
+                break;
+            }
+        }
+    }
+    return next;
+}
+
+void timer_wheel_init(TimerWheel* wheel)
+{
+    memset(wheel, 0, sizeof(*wheel));
+}
+
+void timer_wheel_add(TimerWheel* wheel, TimerWheelEntry* entry, unsigned long long period, unsigned long long delay,
+                     void* data)
+{
+    entry->period = period ? period : 1;
+    entry->expires = wheel->current + (delay ? delay : 1);
+    entry->data = data;
+    entry->due_next = NULL;
+    timer_wheel_place(wheel, entry);
+}
+
+TimerWheelEntry* timer_wheel_advance(TimerWheel* wheel, unsigned long long ticks)
+{
+    unsigned long long target = wheel->current + ticks;
+    TimerWheelEntry* due = NULL;
+    TimerWheelEntry** due_tail = &due;
+
+    while (wheel->current < target)
+    {
+        // Ticks that only find empty slots are skipped at once, a long stall costs its occupied slots, not its ticks
+        wheel->current = timer_wheel_next_event(wheel, target);
+
+        // Each level wraps when all the levels below it wrap
+        for (int level = 1; level < TIMER_WHEEL_LEVELS; level++)
+        {
+            if ((wheel->current & ((1ULL << (TIMER_WHEEL_BITS * level)) - 1)) != 0)
+            {
+                break;
+            }
+            timer_wheel_cascade(wheel, level);
+        }
+
+        size_t slot = (size_t)wheel->current & TIMER_WHEEL_MASK;
+        TimerWheelEntry* entry = wheel->slots[0][slot];
+        wheel->slots[0][slot] = NULL;
+        while (entry != NULL)
+        {
+            TimerWheelEntry* next = entry->next;
+            if (entry->expires > wheel->current)
+            {
+                // Parked in the top level, not due yet
+                timer_wheel_place(wheel, entry);
+            }
+            else
+            {
+                *due_tail = entry;
+                due_tail = &entry->due_next;
+            }
+            entry = next;
+        }
+    }
+    *due_tail = NULL;
+
+    // Reschedule after the whole advance so that an entry is never due twice in one call
+    for (TimerWheelEntry* entry = due; entry != NULL; entry = entry->due_next)
+    {
+        unsigned long long periods = (target - entry->expires) / entry->period + 1;
+        entry->expires += periods * entry->period;
+        timer_wheel_place(wheel, entry);
+    }
+    return due;
+}
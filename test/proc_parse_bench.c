@@ -0,0 +1,295 @@
+/**
+ * @file proc_parse_bench.c
+ * @brief Compares the /proc parsers with the sscanf path they replaced, on in-memory copies of /proc/stat and
+ * /proc/meminfo.
+ *
+ * Only the parsing is timed: both paths walk the same buffer line by line, so reading the files is left out. The
+ * sscanf path copies each line first, as fgets did, so that sscanf does not scan the rest of the buffer. Besides
+ * the files of this host, /proc/stat is synthesized for 128 cores to show the cost on large hosts. The sscanf path
+ * parses every "cpuN" line with the same format the aggregate line used to be parsed with.
+ *
+ * Uso: proc_parse_bench [iterations]
+ */
+
+#include "proc_parse.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/** Number of CPU time fields parsed per line, user to steal */
+#define CPU_FIELDS 8
+
+/** Cores of the synthesized /proc/stat */
+#define SYNTHETIC_CORES 128
+
+/** Size of the buffers holding the files */
+#define FILE_BUFFER_SIZE (64 * 1024)
+
+/** Size of the line buffer of the sscanf path, as in the collectors it replaced */
+#define LINE_BUFFER_SIZE 1024
+
+/** Defeats dead code elimination of the parsed values */
+static volatile unsigned long long sink;
+
+/**
+ * @brief Returns the monotonic time in nanoseconds.
+ */
+static double now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+/**
+ * @brief Reads a whole file into the buffer.
+ *
+ * @param path Path of the file.
+ * @param buffer Target buffer of FILE_BUFFER_SIZE bytes.
+ * @return Number of bytes read, 0 on error.
+ */
+static size_t read_file(const char* path, char* buffer)
+{
+    FILE* fp = fopen(path, "r");
+    if (fp == NULL)
+    {
+        perror(path);
+        return 0;
+    }
+    size_t len = fread(buffer, 1, FILE_BUFFER_SIZE - 1, fp);
+    fclose(fp);
+    buffer[len] = '\0';
+    return len;
+}
+
+/**
+ * @brief Writes a /proc/stat with SYNTHETIC_CORES cores into the buffer.
+ *
+ * @param buffer Target buffer of FILE_BUFFER_SIZE bytes.
+ * @return Length of the text.
+ */
+static size_t synthesize_stat(char* buffer)
+{
+    size_t len = (size_t)snprintf(buffer, FILE_BUFFER_SIZE,
+                                  "cpu  93842118 2071 21357623 1763359212 391857 0 1392114 0 0 0\n");
+    for (int cpu = 0; cpu < SYNTHETIC_CORES; cpu++)
+    {
+        len += (size_t)snprintf(buffer + len, FILE_BUFFER_SIZE - len,
+                                "cpu%d 733141 16 166856 13776243 3061 0 10875 0 0 0\n", cpu);
+    }
+    len += (size_t)snprintf(buffer + len, FILE_BUFFER_SIZE - len,
+                            "intr 9876543210 0 9 0 0 0 0 0 0 0 0 0 0 0 0 0 0\nctxt 31852147742\n"
+                            "btime 1728000000\nprocesses 4201337\nprocs_running 3\nprocs_blocked 0\n"
+                            "softirq 1234567890 0 1 2 3 4 5 6 7 8 9\n");
+    return len;
+}
+
+/**
+ * @brief Returns the start of the next line, or NULL after the last one.
+ */
+static const char* next_line(const char* line, const char* end)
+{
+    const char* newline = memchr(line, '\n', (size_t)(end - line));
+    return newline != NULL && newline + 1 < end ? newline + 1 : NULL;
+}
+
+/**
+ * @brief Copies a line into a buffer the way fgets did for the sscanf path, so that sscanf only scans that line.
+ *
+ * @param line Start of the line.
+ * @param end One past the last byte of the view.
+ * @param buffer Target buffer.
+ * @param size Size of the buffer.
+ * @return buffer.
+ */
+static const char* copy_line(const char* line, const char* end, char* buffer, size_t size)
+{
+    const char* newline = memchr(line, '\n', (size_t)(end - line));
+    size_t len = (size_t)((newline != NULL ? newline + 1 : end) - line);
+    if (len > size - 1)
+    {
+        len = size - 1;
+    }
+    memcpy(buffer, line, len);
+    buffer[len] = '\0';
+    return buffer;
+}
+
+/**
+ * @brief Parses /proc/stat with sscanf: every "cpu" line, then ctxt and procs_running.
+ */
+static void stat_sscanf(const char* data, const char* end)
+{
+    unsigned long long t[CPU_FIELDS];
+    unsigned long long ctxt = 0;
+    int procs_running = 0;
+    unsigned long long total = 0;
+    char buffer[LINE_BUFFER_SIZE];
+    for (const char* next = data; next != NULL; next = next_line(next, end))
+    {
+        const char* line = copy_line(next, end, buffer, sizeof(buffer));
+        // A blank in the format also matches no blank, so "cpu  %llu" would accept "cpu0" shifted by one field
+        int cpu;
+        if (line[3] == ' ' ? sscanf(line, "cpu  %llu %llu %llu %llu %llu %llu %llu %llu", &t[0], &t[1], &t[2], &t[3],
+                                    &t[4], &t[5], &t[6], &t[7]) == CPU_FIELDS
+                           : sscanf(line, "cpu%d %llu %llu %llu %llu %llu %llu %llu %llu", &cpu, &t[0], &t[1], &t[2],
+                                    &t[3], &t[4], &t[5], &t[6], &t[7]) == CPU_FIELDS + 1)
+        {
+            total += t[0] + t[7];
+            continue;
+        }
+        if (sscanf(line, "ctxt %llu", &ctxt) == 1)
+        {
+            continue;
+        }
+        if (sscanf(line, "procs_running %d", &procs_running) == 1)
+        {
+            break;
+        }
+    }
+    sink = total + ctxt + (unsigned long long)procs_running;
+}
+
+/**
+ * @brief Parses /proc/stat with the parsers, the same way get_cpu_stats does.
+ */
+static void stat_parser(const char* data, const char* end)
+{
+    unsigned long long t[CPU_FIELDS];
+    unsigned long long ctxt = 0;
+    unsigned long long procs_running = 0;
+    unsigned long long total = 0;
+    const char* line = data;
+    for (; line != NULL; line = next_line(line, end))
+    {
+        const char* cursor;
+        unsigned long long cpu;
+        if (!PARSE_KEY(line, end, "cpu", &cursor))
+        {
+            break;
+        }
+        if (*cursor != ' ' && !parse_u64(&cursor, end, &cpu))
+        {
+            continue;
+        }
+        if (parse_u64_list(&cursor, end, t, CPU_FIELDS) == CPU_FIELDS)
+        {
+            total += t[0] + t[7];
+        }
+    }
+    for (; line != NULL; line = next_line(line, end))
+    {
+        const char* value;
+        if (PARSE_KEY(line, end, "ctxt ", &value) && parse_u64(&value, end, &ctxt))
+        {
+            continue;
+        }
+        if (PARSE_KEY(line, end, "procs_running ", &value) && parse_u64(&value, end, &procs_running))
+        {
+            break;
+        }
+    }
+    sink = total + ctxt + procs_running;
+}
+
+/**
+ * @brief Parses /proc/meminfo with sscanf, two formats per line as get_memory_usage did.
+ */
+static void meminfo_sscanf(const char* data, const char* end)
+{
+    unsigned long long total_mem = 0, free_mem = 0;
+    char buffer[LINE_BUFFER_SIZE];
+    for (const char* next = data; next != NULL; next = next_line(next, end))
+    {
+        const char* line = copy_line(next, end, buffer, sizeof(buffer));
+        if (sscanf(line, "MemTotal: %llu kB", &total_mem) == 1)
+        {
+            continue;
+        }
+        if (sscanf(line, "MemAvailable: %llu kB", &free_mem) == 1)
+        {
+            break;
+        }
+    }
+    sink = total_mem + free_mem;
+}
+
+/**
+ * @brief Parses /proc/meminfo with the parsers, the same way get_memory_usage does.
+ */
+static void meminfo_parser(const char* data, const char* end)
+{
+    unsigned long long total_mem = 0, free_mem = 0;
+    for (const char* line = data; line != NULL; line = next_line(line, end))
+    {
+        const char* value;
+        if (PARSE_KEY(line, end, "MemTotal:", &value) && parse_u64(&value, end, &total_mem))
+        {
+            continue;
+        }
+        if (PARSE_KEY(line, end, "MemAvailable:", &value) && parse_u64(&value, end, &free_mem))
+        {
+            break;
+        }
+    }
+    sink = total_mem + free_mem;
+}
+
+/**
+ * @brief Times both paths over a buffer and prints the nanoseconds per pass, warning if they parse different values.
+ *
+ * @param name Name of the input.
+ * @param data Contents of the file.
+ * @param len Length of the contents.
+ * @param with_sscanf sscanf path.
+ * @param with_parser Parser path.
+ * @param iterations Passes per path.
+ */
+static void compare(const char* name, const char* data, size_t len, void (*with_sscanf)(const char*, const char*),
+                    void (*with_parser)(const char*, const char*), long iterations)
+{
+    const char* end = data + len;
+    double start = now_ns();
+    for (long i = 0; i < iterations; i++)
+    {
+        with_sscanf(data, end);
+    }
+    double sscanf_ns = (now_ns() - start) / (double)iterations;
+    unsigned long long sscanf_result = sink;
+
+    start = now_ns();
+    for (long i = 0; i < iterations; i++)
+    {
+        with_parser(data, end);
+    }
+    double parser_ns = (now_ns() - start) / (double)iterations;
+    if (sink != sscanf_result)
+    {
+        fprintf(stderr, "%s: the paths disagree (%llu != %llu)\n", name, sink, sscanf_result);
+    }
+
+    printf("%-24s %6zu bytes  sscanf %10.0f ns  parser %8.0f ns  x%.1f\n", name, len, sscanf_ns, parser_ns,
+           sscanf_ns / parser_ns);
+}
+
+int main(int argc, char* argv[])
+{
+    long iterations = argc > 1 ? atol(argv[1]) : 20000;
+    static char stat[FILE_BUFFER_SIZE];
+    static char synthetic[FILE_BUFFER_SIZE];
+    static char meminfo[FILE_BUFFER_SIZE];
+
+    size_t stat_len = read_file("/proc/stat", stat);
+    size_t meminfo_len = read_file("/proc/meminfo", meminfo);
+    if (stat_len == 0 || meminfo_len == 0)
+    {
+        return EXIT_FAILURE;
+    }
+    size_t synthetic_len = synthesize_stat(synthetic);
+
+    compare("/proc/stat", stat, stat_len, stat_sscanf, stat_parser, iterations);
+    compare("/proc/stat, 128 cores", synthetic, synthetic_len, stat_sscanf, stat_parser, iterations);
+    compare("/proc/meminfo", meminfo, meminfo_len, meminfo_sscanf, meminfo_parser, iterations);
+    return EXIT_SUCCESS;
+}
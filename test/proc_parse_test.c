@@ -0,0 +1,173 @@
+/**
+ * @file proc_parse_test.c
+ * @brief Unit tests of the /proc parsers: numbers at the edges of 64 bits, empty tokens and missing keys.
+ */
+
+#include "proc_parse.h"
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Number of failed checks */
+static int failures = 0;
+
+/**
+ * @brief Records the result of a check.
+ *
+ * @param name Name of the check.
+ * @param passed Whether it passed.
+ */
+static void check(const char* name, bool passed)
+{
+    if (!passed)
+    {
+        fprintf(stderr, "FAIL %s\n", name);
+        failures++;
+    }
+    else
+    {
+        printf("ok %s\n", name);
+    }
+}
+
+/**
+ * @brief Parses a number out of a string, the whole string being the view, and checks the outcome of parse_u64.
+ *
+ * @param name Name of the check.
+ * @param text Text to parse.
+ * @param parsed Expected result; on failure the output and the cursor must be left untouched.
+ * @param expected Expected value when parsed.
+ * @param consumed Expected number of characters the cursor advances when parsed.
+ */
+static void check_u64(const char* name, const char* text, bool parsed, unsigned long long expected, size_t consumed)
+{
+    const unsigned long long untouched = 7;
+    unsigned long long value = untouched;
+    const char* cursor = text;
+    if (parse_u64(&cursor, text + strlen(text), &value) != parsed)
+    {
+        check(name, false);
+        return;
+    }
+    check(name, parsed ? value == expected && cursor == text + consumed : value == untouched && cursor == text);
+}
+
+/**
+ * @brief Checks parse_u64.
+ */
+static void test_parse_u64()
+{
+    check_u64("u64 plain", "12345", true, 12345, 5);
+    check_u64("u64 leading blanks", " \t 42 kB", true, 42, 5);
+    check_u64("u64 zero", "0", true, 0, 1);
+    check_u64("u64 leading zeros", "000123", true, 123, 6);
+    check_u64("u64 glued to the next token", "17kB", true, 17, 2);
+    check_u64("u64 max", "18446744073709551615", true, ULLONG_MAX, 20);
+    check_u64("u64 max with leading zeros", "0018446744073709551615", true, ULLONG_MAX, 22);
+
+    check_u64("u64 overflow by one", "18446744073709551616", false, 0, 0);
+    check_u64("u64 overflow by a digit", "184467440737095516150", false, 0, 0);
+    check_u64("u64 overflow twenty nines", "99999999999999999999", false, 0, 0);
+    check_u64("u64 empty", "", false, 0, 0);
+    check_u64("u64 blanks only", "   ", false, 0, 0);
+    check_u64("u64 no digits", "kB", false, 0, 0);
+    check_u64("u64 sign", "-1", false, 0, 0);
+    check_u64("u64 newline", "\n12", false, 0, 0);
+
+    // The view ends before the string does
+    unsigned long long value = 0;
+    const char* text = "123456";
+    const char* cursor = text;
+    bool parsed = parse_u64(&cursor, text + 3, &value);
+    check("u64 stops at the end of the view", parsed && value == 123 && cursor == text + 3);
+}
+
+/**
+ * @brief Checks parse_u64_list.
+ */
+static void test_parse_u64_list()
+{
+    unsigned long long values[4] = {0};
+    const char* text = " 1 2\t3 x 4";
+    const char* cursor = text;
+    check("u64 list stops at a non-number", parse_u64_list(&cursor, text + strlen(text), values, 4) == 3 &&
+                                                 values[0] == 1 && values[1] == 2 && values[2] == 3 &&
+                                                 cursor == text + 6);
+
+    text = "5 6 7";
+    cursor = text;
+    check("u64 list stops at count", parse_u64_list(&cursor, text + strlen(text), values, 2) == 2 && values[1] == 6);
+
+    text = "";
+    cursor = text;
+    check("u64 list empty", parse_u64_list(&cursor, text, values, 4) == 0 && cursor == text);
+}
+
+/**
+ * @brief Checks parse_key and PARSE_KEY.
+ */
+static void test_parse_key()
+{
+    const char* line = "MemTotal:       16330464 kB\nMemFree: 1 kB\n";
+    const char* end = line + strlen(line);
+    const char* rest = NULL;
+
+    check("key found", PARSE_KEY(line, end, "MemTotal:", &rest) && rest == line + 9);
+    rest = NULL;
+    check("key missing", !PARSE_KEY(line, end, "MemAvailable:", &rest) && rest == NULL);
+    check("key not at the line start", !PARSE_KEY(line + 1, end, "MemTotal:", &rest) && rest == NULL);
+    check("key on a later line", !PARSE_KEY(line, end, "MemFree:", &rest) && rest == NULL);
+    check("key matching a prefix", PARSE_KEY(line, end, "Mem", &rest) && rest == line + 3);
+    check("key case sensitive", !PARSE_KEY(line, end, "memtotal:", &rest));
+
+    // The view ends inside the key
+    rest = NULL;
+    check("key cut by the view", !PARSE_KEY(line, line + 5, "MemTotal:", &rest) && rest == NULL);
+    check("key on an empty view", !PARSE_KEY(line, line, "MemTotal:", &rest) && rest == NULL);
+    check("empty key", parse_key(line, end, "", 0, &rest) && rest == line);
+}
+
+/**
+ * @brief Checks parse_token and parse_token_until.
+ */
+static void test_parse_token()
+{
+    ProcToken token = {NULL, 0};
+    const char* text = "  sda1 rest";
+    const char* cursor = text;
+    check("token", parse_token(&cursor, text + strlen(text), &token) && token.start == text + 2 && token.len == 4 &&
+                       cursor == text + 6);
+
+    text = " \t\nnext";
+    cursor = text;
+    check("token empty before the newline", !parse_token(&cursor, text + strlen(text), &token) && cursor == text);
+
+    text = "";
+    cursor = text;
+    check("token empty view", !parse_token(&cursor, text, &token) && cursor == text);
+
+    text = "  eth0:123 456";
+    cursor = text;
+    check("token until", parse_token_until(&cursor, text + strlen(text), ':', &token) && token.len == 4 &&
+                             memcmp(token.start, "eth0", 4) == 0 && cursor == text + 7);
+
+    text = "eth0 123\nlo:1";
+    cursor = text;
+    check("token until missing on the line", !parse_token_until(&cursor, text + strlen(text), ':', &token) &&
+                                                 cursor == text);
+
+    text = ":1";
+    cursor = text;
+    check("token until empty", parse_token_until(&cursor, text + strlen(text), ':', &token) && token.len == 0 &&
+                                   cursor == text + 1);
+}
+
+int main()
+{
+    test_parse_u64();
+    test_parse_u64_list();
+    test_parse_key();
+    test_parse_token();
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,259 @@
+/**
+ * @file procfs_bench.c
+ * @brief Measures the syscalls and the latency of reading the /proc files of a full collection cycle.
+ *
+ * Three ways of reading /proc/stat, /proc/meminfo, /proc/diskstats and /proc/net/dev are compared:
+ * - fopen, fgets and fclose on every cycle, as the collectors did before the persistent handles;
+ * - procfs_read on persistent handles, one pread per file;
+ * - procfs_prefetch then procfs_read, one io_uring batch per cycle, only when built with PROCFS_IO_URING
+ *   (cmake -DMONITORING_IO_URING=ON).
+ *
+ * Syscalls are counted through the raw_syscalls:sys_enter tracepoint with perf_event_open, which needs tracefs mounted
+ * and enough privileges; without them only the latency is reported.
+ *
+ * Uso: procfs_bench [cycles]
+ */
+
+#include "procfs.h"
+#include <linux/perf_event.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+/** Number of files read per cycle */
+#define CYCLE_FILES 4
+
+/** Paths of the files of a cycle */
+static const char* const cycle_paths[CYCLE_FILES] = {"/proc/stat", "/proc/meminfo", "/proc/diskstats",
+                                                     "/proc/net/dev"};
+
+/** Locations of the id of the raw_syscalls:sys_enter tracepoint, depending on where tracefs is mounted */
+static const char* const tracepoint_ids[] = {"/sys/kernel/tracing/events/raw_syscalls/sys_enter/id",
+                                             "/sys/kernel/debug/tracing/events/raw_syscalls/sys_enter/id"};
+
+/** Persistent handles of the cycle */
+static ProcFile cycle_files[CYCLE_FILES];
+
+/** Defeats dead code elimination of the reads */
+static volatile size_t sink;
+
+/**
+ * @brief Returns the monotonic time in nanoseconds.
+ */
+static double now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+/**
+ * @brief Reads the cycle with stdio, opening and closing every file.
+ */
+static void cycle_stdio()
+{
+    char line[1024];
+    for (int i = 0; i < CYCLE_FILES; i++)
+    {
+        FILE* fp = fopen(cycle_paths[i], "r");
+        if (fp == NULL)
+        {
+            continue;
+        }
+        while (fgets(line, sizeof(line), fp) != NULL)
+        {
+            sink += (size_t)line[0];
+        }
+        fclose(fp);
+    }
+}
+
+/**
+ * @brief Reads the cycle through the persistent handles, one pread per file.
+ */
+static void cycle_pread()
+{
+    ProcView view;
+    for (int i = 0; i < CYCLE_FILES; i++)
+    {
+        if (procfs_read(&cycle_files[i], &view) == 0)
+        {
+            sink += (size_t)(view.end - view.data);
+        }
+    }
+}
+
+#ifdef PROCFS_IO_URING
+/**
+ * @brief Reads the cycle as one io_uring batch, then through the persistent handles.
+ */
+static void cycle_io_uring()
+{
+    ProcFile* files[CYCLE_FILES];
+    for (int i = 0; i < CYCLE_FILES; i++)
+    {
+        files[i] = &cycle_files[i];
+    }
+    procfs_prefetch(files, CYCLE_FILES);
+    cycle_pread();
+}
+#endif
+
+/**
+ * @brief Opens a counter of the syscalls entered by this thread.
+ *
+ * @return File descriptor of the counter, -1 if the tracepoint is not usable here.
+ */
+static int open_syscall_counter()
+{
+    for (size_t i = 0; i < sizeof(tracepoint_ids) / sizeof(tracepoint_ids[0]); i++)
+    {
+        FILE* fp = fopen(tracepoint_ids[i], "r");
+        if (fp == NULL)
+        {
+            continue;
+        }
+        unsigned long long id;
+        int found = fscanf(fp, "%llu", &id) == 1;
+        fclose(fp);
+        if (!found)
+        {
+            continue;
+        }
+
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_TRACEPOINT;
+        attr.size = sizeof(attr);
+        attr.config = id;
+        attr.disabled = 1;
+        return (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+    return -1;
+}
+
+/**
+ * @brief Counts the syscalls of a number of cycles.
+ *
+ * @param counter Counter from open_syscall_counter.
+ * @param cycle Reads one cycle.
+ * @param cycles Number of cycles.
+ * @return Syscalls per cycle, -1 if they could not be counted.
+ */
+static double count_syscalls(int counter, void (*cycle)(), int cycles)
+{
+    if (counter < 0)
+    {
+        return -1;
+    }
+    ioctl(counter, PERF_EVENT_IOC_RESET, 0);
+    ioctl(counter, PERF_EVENT_IOC_ENABLE, 0);
+    for (int i = 0; i < cycles; i++)
+    {
+        cycle();
+    }
+    ioctl(counter, PERF_EVENT_IOC_DISABLE, 0);
+    unsigned long long count;
+    if (read(counter, &count, sizeof(count)) != sizeof(count))
+    {
+        return -1;
+    }
+    // The disabling ioctl is entered while the counter is still on
+    return (double)(count - 1) / cycles;
+}
+
+/**
+ * @brief Compares two latencies, for qsort.
+ */
+static int compare_latencies(const void* a, const void* b)
+{
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Runs and reports one way of reading the cycle.
+ *
+ * @param name Name of the way.
+ * @param cycle Reads one cycle.
+ * @param cycles Number of timed cycles.
+ * @param counter Syscall counter, -1 if unavailable.
+ * @param latencies Scratch array of cycles entries.
+ */
+static void run(const char* name, void (*cycle)(), int cycles, int counter, double* latencies)
+{
+    // Warm up: grows the buffers and sets up io_uring
+    for (int i = 0; i < 100; i++)
+    {
+        cycle();
+    }
+    double syscalls = count_syscalls(counter, cycle, 1000);
+
+    double total = 0;
+    for (int i = 0; i < cycles; i++)
+    {
+        double start = now_ns();
+        cycle();
+        latencies[i] = now_ns() - start;
+        total += latencies[i];
+    }
+    qsort(latencies, (size_t)cycles, sizeof(double), compare_latencies);
+
+    char syscall_text[32] = "n/a";
+    if (syscalls >= 0)
+    {
+        snprintf(syscall_text, sizeof(syscall_text), "%.1f", syscalls);
+    }
+    printf("%-18s syscalls/cycle %6s   mean %8.1f us   p50 %8.1f us   p99 %8.1f us\n", name, syscall_text,
+           total / cycles / 1e3, latencies[cycles / 2] / 1e3, latencies[cycles * 99 / 100] / 1e3);
+}
+
+int main(int argc, char* argv[])
+{
+    int cycles = argc > 1 ? atoi(argv[1]) : 20000;
+    if (cycles < 100)
+    {
+        cycles = 100;
+    }
+    double* latencies = malloc((size_t)cycles * sizeof(double));
+    if (latencies == NULL)
+    {
+        perror("Error allocating the latencies");
+        return EXIT_FAILURE;
+    }
+    for (int i = 0; i < CYCLE_FILES; i++)
+    {
+        cycle_files[i] = (ProcFile)PROC_FILE_INIT(cycle_paths[i]);
+        if (procfs_open(&cycle_files[i]) != 0)
+        {
+            return EXIT_FAILURE;
+        }
+    }
+
+    int counter = open_syscall_counter();
+    if (counter < 0)
+    {
+        fprintf(stderr, "raw_syscalls:sys_enter not available, syscalls are not counted\n");
+    }
+
+    run("fopen/fgets", cycle_stdio, cycles, counter, latencies);
+    run("pread", cycle_pread, cycles, counter, latencies);
+#ifdef PROCFS_IO_URING
+    run("io_uring batch", cycle_io_uring, cycles, counter, latencies);
+#else
+    printf("%-18s not built, configure with -DMONITORING_IO_URING=ON\n", "io_uring batch");
+#endif
+
+    procfs_prefetch_shutdown();
+    for (int i = 0; i < CYCLE_FILES; i++)
+    {
+        procfs_close(&cycle_files[i]);
+    }
+    free(latencies);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,115 @@
+/**
+ * @file timer_wheel_test.c
+ * @brief Checks the schedule of the timer wheel against a brute-force model.
+ *
+ * Entries with short periods and with periods beyond the reach of the top level are advanced through 2M steps of one
+ * tick, with short and long stalls mixed in. After every step the due entries must be exactly those the model expects:
+ * every entry whose next run fell within the step, once, however many of its periods elapsed.
+ */
+
+#include "timer_wheel.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+/** Number of entries with periods within the wheel */
+#define SHORT_ENTRIES 30
+
+/** Number of entries with periods up to beyond the top level */
+#define LONG_ENTRIES 10
+
+/** Total number of entries */
+#define ENTRIES (SHORT_ENTRIES + LONG_ENTRIES)
+
+/** Number of advances */
+#define STEPS 2000000
+
+/** Advances between long stalls */
+#define LONG_STALL_EVERY 100000
+
+/** Length of a long stall, longer than the reach of three levels */
+#define LONG_STALL_TICKS 3000000ULL
+
+/** xorshift64 state, a fixed seed keeps the schedule reproducible */
+static unsigned long long random_state = 88172645463325252ULL;
+
+/**
+ * @brief Returns the next pseudo-random number.
+ */
+static unsigned long long next_random()
+{
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 7;
+    random_state ^= random_state << 17;
+    return random_state;
+}
+
+int main()
+{
+    static TimerWheel wheel;
+    static TimerWheelEntry entries[ENTRIES];
+    unsigned long long periods[ENTRIES];
+    unsigned long long expected_next[ENTRIES];
+
+    timer_wheel_init(&wheel);
+    unsigned long long top_span = 1ULL << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS);
+    for (int i = 0; i < ENTRIES; i++)
+    {
+        periods[i] = i < SHORT_ENTRIES ? 1 + next_random() % 300 : 1 + next_random() % (top_span + top_span / 4);
+        unsigned long long delay = 1 + next_random() % 500;
+        timer_wheel_add(&wheel, &entries[i], periods[i], delay, &entries[i]);
+        expected_next[i] = delay;
+    }
+
+    unsigned long long current = 0;
+    long runs = 0;
+    for (long step = 0; step < STEPS; step++)
+    {
+        unsigned long long ticks = 1;
+        if (step % LONG_STALL_EVERY == 0)
+        {
+            ticks = LONG_STALL_TICKS;
+        }
+        else if (next_random() % 50 == 0)
+        {
+            ticks = 1 + next_random() % 200;
+        }
+        unsigned long long target = current + ticks;
+
+        // Brute-force model: due once if the next run is within the step, then moved past the target
+        int expected[ENTRIES] = {0};
+        for (int i = 0; i < ENTRIES; i++)
+        {
+            if (expected_next[i] <= target)
+            {
+                expected[i] = 1;
+                expected_next[i] += ((target - expected_next[i]) / periods[i] + 1) * periods[i];
+            }
+        }
+
+        int got[ENTRIES] = {0};
+        for (TimerWheelEntry* entry = timer_wheel_advance(&wheel, ticks); entry != NULL; entry = entry->due_next)
+        {
+            got[(TimerWheelEntry*)entry->data - entries]++;
+            runs++;
+        }
+
+        for (int i = 0; i < ENTRIES; i++)
+        {
+            if (got[i] != expected[i])
+            {
+                fprintf(stderr, "FAIL step %ld, tick %llu: entry %d (period %llu) due %d times, expected %d\n", step,
+                        target, i, periods[i], got[i], expected[i]);
+                return EXIT_FAILURE;
+            }
+        }
+        if (wheel.current != target)
+        {
+            fprintf(stderr, "FAIL step %ld: wheel at tick %llu, expected %llu\n", step, wheel.current, target);
+            return EXIT_FAILURE;
+        }
+        current = target;
+    }
+
+    printf("ok %d entries, %d steps, %ld runs, %llu ticks\n", ENTRIES, STEPS, runs, current);
+    return EXIT_SUCCESS;
+}